@@ -1458,6 +1458,15 @@ application::application(application_info info) :
 			config_path = files_dir_path;
 			cache_path = files_dir_path;
 		}
+
+		// Files in internal storage cannot be retrieved, use the external
+		// files directory (Android/data/<package>/files) when it is available
+		data_path = cache_path;
+		if (auto external_dir = ctx.call<jni::object<"java/io/File">>("getExternalFilesDir", jni::string_t(nullptr)))
+		{
+			if (auto external_dir_path = external_dir.call<jni::string>("getAbsolutePath"))
+				data_path = external_dir_path;
+		}
 	}
 
 	app_info.native_app->userData = this;
@@ -1508,12 +1517,14 @@ application::application(application_info info) :
 	wifi = std::make_shared<wifi_lock>();
 	config_path = xdg_config_home() / "wivrn";
 	cache_path = xdg_cache_home() / "wivrn";
+	data_path = xdg_data_home() / "wivrn";
 #endif
 
 	std::filesystem::create_directories(config_path);
 	std::filesystem::create_directories(cache_path);
 	spdlog::debug("Config path: {}", config_path.native());
 	spdlog::debug("Cache path: {}", cache_path.native());
+	spdlog::debug("Data path: {}", data_path.native());
 
 	try
 	{
@@ -137,6 +137,8 @@ class application : public singleton<application>
 	std::atomic<bool> exit_requested = false;
 	std::filesystem::path config_path;
 	std::filesystem::path cache_path;
+	// Files meant to be retrieved by the user, such as session recordings
+	std::filesystem::path data_path;
 
 	std::shared_ptr<wifi_lock> wifi;
 
@@ -377,6 +379,11 @@ public:
 		return instance().cache_path;
 	}
 
+	static const std::filesystem::path & get_data_path()
+	{
+		return instance().data_path;
+	}
+
 	static std::chrono::nanoseconds get_cpu_time()
 	{
 		return instance().last_scene_cpu_time;
@@ -181,6 +181,9 @@ configuration::configuration(xr::system & system)
 		if (auto val = root["enable_stream_gui"]; val.is_bool())
 			enable_stream_gui = val.get_bool();
 
+		if (auto val = root["record_session"]; val.is_bool())
+			record_session = val.get_bool();
+
 		if (auto val = root["openxr_post_processing"]; val.is_object())
 			parse_openxr_post_processing_options(val.get_object());
 
@@ -300,6 +303,7 @@ void configuration::save()
 	json << ",\"fb_lower_body\":" << std::boolalpha << fb_lower_body;
 	json << ",\"fb_hip\":" << std::boolalpha << fb_hip;
 	json << ",\"enable_stream_gui\":" << std::boolalpha << enable_stream_gui;
+	json << ",\"record_session\":" << std::boolalpha << record_session;
 	for (auto & [key, value]: features)
 		json << "," << key << ":" << std::boolalpha << value;
 	json << ",\"virtual_keyboard_layout\":" << json_string(virtual_keyboard_layout);
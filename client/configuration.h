@@ -58,6 +58,9 @@ public:
 
 	bool enable_stream_gui = true;
 
+	// Record the packets exchanged with the server, to replay them with wivrn-headless
+	bool record_session = false;
+
 	// XR_FB_composition_layer_settings extension flags
 	struct openxr_post_processing_settings
 	{
@@ -67,8 +67,10 @@ public:
 	virtual ~decoder();
 	virtual void push_data(std::span<std::span<const uint8_t>> data, uint64_t frame_index, bool partial) = 0;
 
+	// the decoder resets feedback.sent_to_decoder if the frame is discarded,
+	// so that the server sends a new reference frame
 	virtual void frame_completed(
-	        const from_headset::feedback & feedback,
+	        from_headset::feedback & feedback,
 	        const to_headset::video_stream_data_shard::view_info_t & view_info) = 0;
 
 	virtual vk::Sampler sampler() = 0;
@@ -21,6 +21,11 @@
 #include "application.h"
 #include "scenes/stream.h"
 
+#include <algorithm>
+#include <cstring>
+#include <lz4.h>
+#include <thread>
+
 namespace
 {
 struct raw_blit_handle : public wivrn::decoder::blit_handle
@@ -112,12 +117,12 @@ raw_decoder::raw_decoder(
 	        .width = description.width,
 	        .height = description.height,
 	};
-	vk::DeviceSize buffer_size = description.width * description.height;
+	input_size = description.width * description.height;
 	vk::Format format{};
 	switch (description.channels)
 	{
 		case to_headset::video_stream_description::channels_t::colour:
-			buffer_size += (description.width * description.height) / 2;
+			input_size += (description.width * description.height) / 2;
 			format = vk::Format::eG8B8R82Plane420Unorm;
 			break;
 		case to_headset::video_stream_description::channels_t::alpha:
@@ -129,7 +134,7 @@ raw_decoder::raw_decoder(
 		i = buffer_allocation(
 		        device,
 		        {
-		                .size = buffer_size,
+		                .size = input_size,
 		                .usage = vk::BufferUsageFlagBits::eTransferSrc,
 		        },
 		        {
@@ -138,7 +143,6 @@ raw_decoder::raw_decoder(
 		        },
 		        "raw stream buffer");
 	}
-	input_pos = (uint8_t *)input[0].map();
 
 	for (auto & item: image_pool)
 	{
@@ -190,28 +194,176 @@ raw_decoder::raw_decoder(
 	}
 }
 
+// Statistics are logged with this period
+static const auto report_period = std::chrono::seconds(10);
+
+bool raw_decoder::begin_chunk()
+{
+	const auto & h = chunk_header;
+	if (uint64_t(h.offset) + h.size > input_size)
+	{
+		spdlog::warn("Raw chunk out of bounds: offset {}, size {}", h.offset, h.size);
+		return false;
+	}
+	switch (h.compression)
+	{
+		case raw_chunk_header::compression_t::none:
+			if (h.compressed_size != h.size)
+				return false;
+			break;
+		case raw_chunk_header::compression_t::lz4:
+			if (h.compressed_size > uint32_t(LZ4_compressBound(h.size)))
+				return false;
+			break;
+		default:
+			spdlog::warn("Unsupported raw chunk compression {}", int(h.compression));
+			return false;
+	}
+	if (h.flags & raw_chunk_header::delta and reference_frame != h.reference_frame)
+	{
+		spdlog::info("Reference frame {} for raw frame {} is not available", h.reference_frame, current_frame);
+		return false;
+	}
+
+	chunk_direct = h.compression == raw_chunk_header::compression_t::none and not(h.flags & raw_chunk_header::delta);
+	if (not chunk_direct)
+		chunk_data.resize(h.compressed_size);
+	frame_covered += h.size;
+	frame_bytes += sizeof(raw_chunk_header) + h.compressed_size;
+	return true;
+}
+
+void raw_decoder::end_chunk()
+{
+	if (chunk_direct)
+		return;
+
+	if (not pool)
+		pool = std::make_unique<utils::task_pool>("raw_decoder", std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u));
+
+	auto output = (uint8_t *)input[0].map();
+	auto reference = (const uint8_t *)input[1].map();
+	pool->push([this, h = chunk_header, data = std::move(chunk_data), output, reference]() {
+		uint8_t * dst = output + h.offset;
+		if (h.compression == raw_chunk_header::compression_t::lz4)
+		{
+			if (LZ4_decompress_safe((const char *)data.data(), (char *)dst, h.compressed_size, h.size) != int(h.size))
+			{
+				decompress_failed = true;
+				return;
+			}
+		}
+		else
+			memcpy(dst, data.data(), h.size);
+
+		if (h.flags & raw_chunk_header::delta)
+		{
+			const uint8_t * ref = reference + h.offset;
+			for (size_t i = 0; i < h.size; ++i)
+				dst[i] ^= ref[i];
+		}
+	});
+	chunk_data = {};
+}
+
+void raw_decoder::wait_chunks()
+{
+	if (pool)
+		pool->wait();
+}
+
 void raw_decoder::push_data(std::span<std::span<const uint8_t>> data, uint64_t frame_index, bool partial)
 {
 	if (frame_index != current_frame)
 	{
-		input_pos = (uint8_t *)input[0].map();
+		// Chunks of an incomplete frame may still be decompressing
+		wait_chunks();
 		current_frame = frame_index;
+		header_received = 0;
+		chunk_received = 0;
+		frame_covered = 0;
+		frame_bytes = 0;
+		frame_valid = true;
+		decompress_failed = false;
 	}
-	for (const auto & item: data)
+
+	auto output = (uint8_t *)input[0].map();
+	for (auto item: data)
 	{
-		memcpy(input_pos, item.data(), item.size_bytes());
-		input_pos += item.size();
+		while (frame_valid)
+		{
+			if (header_received == sizeof(raw_chunk_header) and chunk_received == chunk_header.compressed_size)
+			{
+				end_chunk();
+				header_received = 0;
+				chunk_received = 0;
+			}
+			if (item.empty())
+				break;
+
+			if (header_received < sizeof(raw_chunk_header))
+			{
+				size_t n = std::min(item.size(), sizeof(raw_chunk_header) - header_received);
+				memcpy((uint8_t *)&chunk_header + header_received, item.data(), n);
+				header_received += n;
+				item = item.subspan(n);
+				if (header_received == sizeof(raw_chunk_header))
+					frame_valid = begin_chunk();
+				continue;
+			}
+
+			size_t n = std::min<size_t>(item.size(), chunk_header.compressed_size - chunk_received);
+			if (chunk_direct)
+				memcpy(output + chunk_header.offset + chunk_received, item.data(), n);
+			else
+				memcpy(chunk_data.data() + chunk_received, item.data(), n);
+			chunk_received += n;
+			item = item.subspan(n);
+		}
 	}
 }
 
+void raw_decoder::report(std::chrono::nanoseconds wait)
+{
+	++stats.frames;
+	stats.in_bytes += frame_bytes;
+	stats.out_bytes += input_size;
+	stats.total_wait += wait;
+	stats.max_wait = std::max(stats.max_wait, wait);
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - stats.begin < report_period)
+		return;
+
+	spdlog::info("Raw stream: compression ratio {:.2f}, decompression wait {:.2f}ms per frame (max {:.2f}ms)",
+	             double(stats.out_bytes) / std::max<uint64_t>(stats.in_bytes, 1),
+	             std::chrono::duration<double, std::milli>(stats.total_wait).count() / stats.frames,
+	             std::chrono::duration<double, std::milli>(stats.max_wait).count());
+	stats = {};
+	stats.begin = now;
+}
+
 void raw_decoder::frame_completed(
-        const from_headset::feedback & feedback,
+        from_headset::feedback & feedback,
         const to_headset::video_stream_data_shard::view_info_t & view_info)
 {
+	auto wait_begin = std::chrono::steady_clock::now();
+	wait_chunks();
+	auto wait = std::chrono::steady_clock::now() - wait_begin;
+
+	if (not frame_valid or decompress_failed or header_received != 0 or frame_covered != input_size)
+	{
+		spdlog::warn("Incomplete raw frame {}, discard frame", current_frame);
+		feedback.sent_to_decoder = 0;
+		return;
+	}
+
 	auto item = get_free();
 	if (not item)
 	{
 		spdlog::warn("No image available in pool, discard frame");
+		// Following frames may use this one as reference
+		feedback.sent_to_decoder = 0;
 		return;
 	}
 
@@ -333,7 +485,9 @@ void raw_decoder::frame_completed(
 		scene->push_blit_handle(accumulator, std::move(handle));
 
 	std::swap(input[0], input[1]);
-	input_pos = (uint8_t *)input[0].map();
+	reference_frame = current_frame;
+
+	report(wait);
 }
 
 raw_decoder::image * raw_decoder::get_free()
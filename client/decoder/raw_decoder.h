@@ -20,9 +20,15 @@
 
 #include "decoder.h"
 
+#include "raw_chunk.h"
+#include "utils/task_pool.h"
 #include "vk/allocation.h"
 
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
 
 namespace wivrn
 {
@@ -54,10 +60,37 @@ private:
 	shard_accumulator * accumulator;
 
 	uint64_t current_frame = 0;
+	// input[0] receives the current frame, input[1] holds the previous one
 	std::array<buffer_allocation, 2> input;
-	uint8_t * input_pos;
-	from_headset::feedback feedback;
-	to_headset::video_stream_data_shard::view_info_t view_info;
+	vk::DeviceSize input_size;
+	// frame in input[1], reference for delta chunks
+	std::optional<uint64_t> reference_frame;
+
+	// chunk being received
+	raw_chunk_header chunk_header;
+	size_t header_received = 0;
+	size_t chunk_received = 0;
+	// uncompressed chunks are written directly to input[0]
+	bool chunk_direct;
+	std::vector<uint8_t> chunk_data;
+	// bytes of input[0] written by chunks of the current frame
+	size_t frame_covered = 0;
+	bool frame_valid = true;
+	std::atomic_bool decompress_failed = false;
+
+	// created on the first compressed chunk
+	std::unique_ptr<utils::task_pool> pool;
+
+	struct
+	{
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		uint64_t frames = 0;
+		uint64_t in_bytes = 0;
+		uint64_t out_bytes = 0;
+		std::chrono::nanoseconds total_wait{};
+		std::chrono::nanoseconds max_wait{};
+	} stats;
+	uint64_t frame_bytes = 0;
 
 public:
 	raw_decoder(vk::raii::Device & device,
@@ -71,7 +104,7 @@ public:
 	void push_data(std::span<std::span<const uint8_t>> data, uint64_t frame_index, bool partial) override;
 
 	void frame_completed(
-	        const wivrn::from_headset::feedback & feedback,
+	        wivrn::from_headset::feedback & feedback,
 	        const wivrn::to_headset::video_stream_data_shard::view_info_t & view_info) override;
 
 	vk::Sampler sampler() override
@@ -91,6 +124,10 @@ public:
 
 private:
 	image * get_free();
+	bool begin_chunk();
+	void end_chunk();
+	void wait_chunks();
+	void report(std::chrono::nanoseconds wait);
 };
 
 } // namespace wivrn
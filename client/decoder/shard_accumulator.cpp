@@ -20,6 +20,7 @@
 #include "shard_accumulator.h"
 #include "scenes/stream.h" // IWYU pragma: keep
 #include "spdlog/spdlog.h"
+#include "utils/tracing.h"
 #include "xr/instance.h"
 
 namespace wivrn
@@ -159,6 +160,46 @@ void shard_accumulator::push_shard(video_stream_data_shard && shard)
 	}
 }
 
+void shard_accumulator::push_repeat(video_stream_repeat && repeat)
+{
+	assert(current.frame_index() + 1 == next.frame_index());
+
+	if (repeat.frame_idx < current.frame_index())
+	{
+		spdlog::info("Drop repeat for old frame {} (current {})", repeat.frame_idx, current.frame_index());
+		return;
+	}
+	else if (repeat.frame_idx == next.frame_index())
+	{
+		debug_why_not_sent(current);
+		send_feedback(current.feedback);
+		advance();
+	}
+	else if (repeat.frame_idx > next.frame_index())
+	{
+		send_feedback(current.feedback);
+		send_feedback(next.feedback);
+		current.reset(repeat.frame_idx);
+		next.reset(repeat.frame_idx + 1);
+	}
+
+	auto & feedback = current.feedback;
+	feedback.received_first_packet = instance.now();
+	feedback.received_last_packet = feedback.received_first_packet;
+	feedback.sent_to_decoder = feedback.received_first_packet;
+	feedback.encode_begin = repeat.timing_info.encode_begin;
+	feedback.encode_end = repeat.timing_info.encode_end;
+	feedback.send_begin = repeat.timing_info.send_begin;
+	feedback.send_end = repeat.timing_info.send_end;
+
+	if (auto scene = weak_scene.lock())
+		scene->push_repeat(this, repeat.source_frame_idx, feedback, repeat.view_info);
+
+	send_feedback(feedback);
+
+	advance();
+}
+
 void shard_accumulator::try_submit_frame(std::optional<uint16_t> shard_idx)
 {
 	if (shard_idx)
@@ -199,6 +240,9 @@ void shard_accumulator::try_submit_frame(uint16_t shard_idx)
 	current.feedback.send_begin = timing_info.send_begin;
 	current.feedback.send_end = timing_info.send_end;
 
+	if (current.feedback.received_first_packet)
+		WIVRN_TRACE_STREAM_SLICE("receive", current.feedback.stream_index, current.feedback.received_first_packet, current.feedback.received_last_packet, tracing::flow::step, tracing::frame_id(current.feedback.stream_index, current.feedback.frame_index));
+
 	if (not data_shards.front()->view_info)
 	{
 		spdlog::warn("first shard has no view_info");
@@ -95,6 +95,7 @@ public:
 	}
 
 	void push_shard(wivrn::to_headset::video_stream_data_shard &&);
+	void push_repeat(wivrn::to_headset::video_stream_repeat &&);
 
 	auto & desc() const
 	{
@@ -0,0 +1,216 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cpu_decoder.h"
+
+#include "raw_chunk.h"
+
+#include <algorithm>
+#include <cstring>
+#include <lz4.h>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace wivrn::headless
+{
+namespace
+{
+class ffmpeg_decoder : public cpu_decoder
+{
+	std::unique_ptr<AVCodecContext, void (*)(AVCodecContext *)> codec;
+	std::unique_ptr<AVFrame, void (*)(AVFrame *)> frame;
+	std::vector<uint8_t> packet;
+
+	static AVCodecID codec_id(video_codec codec)
+	{
+		switch (codec)
+		{
+			case video_codec::h264:
+				return AV_CODEC_ID_H264;
+			case video_codec::h265:
+				return AV_CODEC_ID_HEVC;
+			case video_codec::av1:
+				return AV_CODEC_ID_AV1;
+			case video_codec::raw:
+				break;
+		}
+		throw std::invalid_argument("codec is not supported by ffmpeg");
+	}
+
+public:
+	ffmpeg_decoder(const to_headset::video_stream_description::item & description) :
+	        codec(nullptr, [](AVCodecContext * ctx) { avcodec_free_context(&ctx); }),
+	        frame(av_frame_alloc(), [](AVFrame * frame) { av_frame_free(&frame); })
+	{
+		auto avcodec = avcodec_find_decoder(codec_id(description.codec));
+		if (avcodec == nullptr)
+			throw std::runtime_error{"avcodec_find_decoder failed"};
+
+		codec.reset(avcodec_alloc_context3(avcodec));
+		codec->flags |= AV_CODEC_FLAG_LOW_DELAY;
+		// Frame threading adds one frame of latency per thread
+		codec->thread_type = FF_THREAD_SLICE;
+		codec->thread_count = 0;
+
+		if (avcodec_open2(codec.get(), avcodec, nullptr) < 0)
+			throw std::runtime_error{"avcodec_open2 failed"};
+		spdlog::info("Using ffmpeg decoder {}", avcodec->name);
+	}
+
+	bool decode(std::span<const std::span<const uint8_t>> payload, uint64_t frame_index) override
+	{
+		packet.clear();
+		for (const auto & d: payload)
+			packet.insert(packet.end(), d.begin(), d.end());
+		size_t size = packet.size();
+		packet.resize(size + AV_INPUT_BUFFER_PADDING_SIZE);
+
+		AVPacket pkt{};
+		pkt.pts = frame_index;
+		pkt.dts = AV_NOPTS_VALUE;
+		pkt.data = packet.data();
+		pkt.size = size;
+		pkt.pos = -1;
+
+		if (avcodec_send_packet(codec.get(), &pkt) < 0)
+		{
+			spdlog::warn("avcodec_send_packet failed for frame {}", frame_index);
+			return false;
+		}
+
+		bool decoded = false;
+		while (avcodec_receive_frame(codec.get(), frame.get()) == 0)
+		{
+			decoded = true;
+			av_frame_unref(frame.get());
+		}
+		return decoded;
+	}
+};
+
+// Same format as raw_decoder, decompressed in a plain buffer
+class raw_decoder : public cpu_decoder
+{
+	std::vector<uint8_t> output;
+	std::vector<uint8_t> reference;
+	std::optional<uint64_t> reference_frame;
+	std::vector<uint8_t> chunk;
+
+public:
+	raw_decoder(const to_headset::video_stream_description::item & description)
+	{
+		size_t size = description.width * description.height;
+		if (description.channels == to_headset::video_stream_description::channels_t::colour)
+			size += size / 2;
+		output.resize(size);
+		reference.resize(size);
+	}
+
+	bool decode(std::span<const std::span<const uint8_t>> payload, uint64_t frame_index) override
+	{
+		size_t covered = 0;
+		raw_chunk_header h;
+		size_t header_received = 0;
+		size_t chunk_received = 0;
+
+		auto end_chunk = [&]() {
+			if (h.compression == raw_chunk_header::compression_t::lz4)
+			{
+				if (LZ4_decompress_safe((const char *)chunk.data(), (char *)output.data() + h.offset, h.compressed_size, h.size) != int(h.size))
+					return false;
+			}
+			else
+				memcpy(output.data() + h.offset, chunk.data(), h.size);
+
+			if (h.flags & raw_chunk_header::delta)
+			{
+				if (reference_frame != h.reference_frame)
+					return false;
+				for (size_t i = h.offset; i < h.offset + h.size; ++i)
+					output[i] ^= reference[i];
+			}
+			covered += h.size;
+			return true;
+		};
+
+		for (auto item: payload)
+		{
+			while (not item.empty())
+			{
+				if (header_received < sizeof(h))
+				{
+					size_t n = std::min(item.size(), sizeof(h) - header_received);
+					memcpy((uint8_t *)&h + header_received, item.data(), n);
+					header_received += n;
+					item = item.subspan(n);
+					if (header_received < sizeof(h))
+						continue;
+
+					if (h.compression > raw_chunk_header::compression_t::lz4 or
+					    uint64_t(h.offset) + h.size > output.size() or
+					    h.compressed_size > uint32_t(LZ4_compressBound(h.size)) or
+					    (h.compression == raw_chunk_header::compression_t::none and h.compressed_size != h.size))
+					{
+						spdlog::warn("Invalid raw chunk in frame {}", frame_index);
+						return false;
+					}
+					chunk.resize(h.compressed_size);
+				}
+
+				size_t n = std::min<size_t>(item.size(), h.compressed_size - chunk_received);
+				memcpy(chunk.data() + chunk_received, item.data(), n);
+				chunk_received += n;
+				item = item.subspan(n);
+
+				if (chunk_received == h.compressed_size)
+				{
+					if (not end_chunk())
+					{
+						spdlog::info("Failed to decompress raw frame {}", frame_index);
+						return false;
+					}
+					header_received = 0;
+					chunk_received = 0;
+				}
+			}
+		}
+
+		if (header_received != 0 or covered != output.size())
+			return false;
+
+		std::swap(output, reference);
+		reference_frame = frame_index;
+		return true;
+	}
+};
+} // namespace
+
+std::unique_ptr<cpu_decoder> cpu_decoder::make(const to_headset::video_stream_description::item & description)
+{
+	if (description.codec == video_codec::raw)
+		return std::make_unique<raw_decoder>(description);
+	return std::make_unique<ffmpeg_decoder>(description);
+}
+} // namespace wivrn::headless
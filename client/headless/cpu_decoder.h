@@ -0,0 +1,40 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_packets.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace wivrn::headless
+{
+// Decodes complete frames in system memory, the output is discarded
+class cpu_decoder
+{
+public:
+	virtual ~cpu_decoder() = default;
+
+	// Returns true if a picture was produced
+	virtual bool decode(std::span<const std::span<const uint8_t>> payload, uint64_t frame_index) = 0;
+
+	static std::unique_ptr<cpu_decoder> make(const to_headset::video_stream_description::item & description);
+};
+} // namespace wivrn::headless
@@ -0,0 +1,604 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "headless_client.h"
+
+#include "utils/named_thread.h"
+#include "utils/tracing.h"
+#include "wivrn_serialization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+#include <numbers>
+#include <spdlog/spdlog.h>
+
+using namespace std::chrono_literals;
+
+namespace wivrn::headless
+{
+namespace
+{
+// Typical field of view of a standalone headset, right eye is mirrored
+const XrFovf left_fov{
+        .angleLeft = -0.942,
+        .angleRight = 0.698,
+        .angleUp = 0.768,
+        .angleDown = -0.960,
+};
+const XrFovf right_fov{
+        .angleLeft = -0.698,
+        .angleRight = 0.942,
+        .angleUp = 0.768,
+        .angleDown = -0.960,
+};
+const float ipd = 0.063;
+
+XrQuaternionf to_xr(const glm::quat & q)
+{
+	return {q.x, q.y, q.z, q.w};
+}
+
+XrVector3f to_xr(const glm::vec3 & v)
+{
+	return {v.x, v.y, v.z};
+}
+
+// Head looking left and right, nodding and swaying with different periods
+from_headset::tracking::pose head_pose(XrTime t, float amplitude)
+{
+	const float s = t * 1e-9;
+	const float w_yaw = 2 * std::numbers::pi / 4;
+	const float w_pitch = 2 * std::numbers::pi / 3;
+	const float w_sway = 2 * std::numbers::pi / 5;
+
+	float yaw = amplitude * std::sin(w_yaw * s);
+	float yaw_rate = amplitude * w_yaw * std::cos(w_yaw * s);
+	float pitch = 0.3 * amplitude * std::sin(w_pitch * s);
+	float pitch_rate = 0.3 * amplitude * w_pitch * std::cos(w_pitch * s);
+
+	glm::quat q_yaw = glm::angleAxis(yaw, glm::vec3{0, 1, 0});
+	glm::quat q_pitch = glm::angleAxis(pitch, glm::vec3{1, 0, 0});
+
+	return {
+	        .pose = {
+	                .orientation = to_xr(q_yaw * q_pitch),
+	                .position = {0.05f * std::sin(w_sway * s), 1.6, 0},
+	        },
+	        .linear_velocity = {0.05f * w_sway * std::cos(w_sway * s), 0, 0},
+	        .angular_velocity = to_xr(glm::vec3{0, yaw_rate, 0} + q_yaw * glm::vec3{pitch_rate, 0, 0}),
+	        .device = device_id::HEAD,
+	        .flags = from_headset::tracking::orientation_valid |
+	                 from_headset::tracking::position_valid |
+	                 from_headset::tracking::linear_velocity_valid |
+	                 from_headset::tracking::angular_velocity_valid |
+	                 from_headset::tracking::orientation_tracked |
+	                 from_headset::tracking::position_tracked,
+	};
+}
+
+double ms(XrDuration d)
+{
+	return d * 1e-6;
+}
+} // namespace
+
+XrTime headless_client::now()
+{
+	// Same clock as XrTime on Linux runtimes
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+XrTime headless_client::clock() const
+{
+	if (session)
+		return now();
+	return replay_origin + (now() - replay_wall_origin) * opts.speed;
+}
+
+headless_client::headless_client(std::unique_ptr<wivrn_session> session_, options opts_) :
+        opts(std::move(opts_)),
+        session(std::move(session_)),
+        display_period(XrDuration(1'000'000'000 / opts.refresh_rate))
+{
+	if (not session)
+		return;
+
+	session->send_control(from_headset::headset_info_packet{
+	        .recommended_eye_width = opts.eye_width,
+	        .recommended_eye_height = opts.eye_height,
+	        .available_refresh_rates = {opts.refresh_rate},
+	        .preferred_refresh_rate = opts.refresh_rate,
+	        .fov = {left_fov, right_fov},
+	        .face_tracking = from_headset::face_type::none,
+	        .num_generic_trackers = 0,
+	        .supported_codecs = opts.codecs,
+	        .system_name = "WiVRn headless client",
+	});
+
+	session->send_control(from_headset::session_state_changed{
+	        .state = XR_SESSION_STATE_FOCUSED,
+	});
+
+	tracking_thread = utils::named_thread("tracking_thread", &headless_client::tracking, this);
+}
+
+headless_client::~headless_client()
+{
+	exiting = true;
+	if (tracking_thread.joinable())
+		tracking_thread.join();
+	stop_streams();
+}
+
+void headless_client::stop_streams()
+{
+	for (auto & s: streams)
+	{
+		{
+			std::lock_guard lock(s->mutex);
+			s->exiting = true;
+		}
+		s->cv.notify_all();
+		s->thread.join();
+	}
+	streams.clear();
+}
+
+void headless_client::tracking()
+{
+	std::vector<from_headset::tracking> samples;
+	from_headset::trackings packet{};
+
+	while (not exiting)
+	{
+		XrTime t0 = now();
+		XrDuration period = std::max<XrDuration>(display_period, 1'000'000);
+		XrDuration prediction = std::clamp<XrDuration>(max_offset, 0, 80'000'000);
+
+		// Samples are aligned on the virtual display, whose vsync is at multiples of the period
+		samples.clear();
+		for (XrDuration Δt = -(t0 % period) + (min_offset / period) * period;
+		     Δt <= prediction + period / 2;
+		     Δt += period)
+		{
+			samples.push_back({
+			        .production_timestamp = t0,
+			        .timestamp = t0 + Δt,
+			        .view_flags = XR_VIEW_STATE_ORIENTATION_VALID_BIT | XR_VIEW_STATE_POSITION_VALID_BIT |
+			                      XR_VIEW_STATE_ORIENTATION_TRACKED_BIT | XR_VIEW_STATE_POSITION_TRACKED_BIT,
+			        .views = {{
+			                {
+			                        .pose = {.orientation = {0, 0, 0, 1}, .position = {-ipd / 2, 0, 0}},
+			                        .fov = left_fov,
+			                },
+			                {
+			                        .pose = {.orientation = {0, 0, 0, 1}, .position = {ipd / 2, 0, 0}},
+			                        .fov = right_fov,
+			                },
+			        }},
+			        .device_poses = {head_pose(t0 + Δt, opts.motion)},
+			});
+		}
+
+		try
+		{
+			size_t current_size = 0;
+			packet.items.clear();
+			for (auto & item: samples)
+			{
+				size_t size = serialized_size(item);
+				if (size + current_size > 1400 and not packet.items.empty())
+				{
+					session->send_stream(from_headset::trackings{packet});
+					packet.items.clear();
+					current_size = 0;
+				}
+				current_size += size;
+				packet.items.push_back(std::move(item));
+			}
+			if (not packet.items.empty())
+				session->send_stream(from_headset::trackings{packet});
+		}
+		catch (std::exception & e)
+		{
+			spdlog::warn("Exception while sending tracking packet: {}", e.what());
+		}
+
+		std::this_thread::sleep_for(std::chrono::nanoseconds(period - (now() % period)));
+	}
+}
+
+void headless_client::send_feedback(const from_headset::feedback & feedback)
+{
+	if (not session)
+		return;
+
+	try
+	{
+		session->send_control(from_headset::feedback{feedback});
+	}
+	catch (std::exception & e)
+	{
+		spdlog::warn("Exception while sending feedback packet: {}", e.what());
+	}
+}
+
+void headless_client::operator()(to_headset::video_stream_description && desc)
+{
+	stop_streams();
+
+	spdlog::info("Video stream: {}x{} at {}fps, {} items", desc.width, desc.height, desc.fps, desc.items.size());
+	for (size_t index = 0; index < desc.items.size(); ++index)
+	{
+		auto & s = *streams.emplace_back(std::make_unique<stream>());
+		s.index = index;
+		s.description = desc.items[index];
+		if (opts.decode)
+			s.decoder = cpu_decoder::make(s.description);
+		s.thread = utils::named_thread("decoder" + std::to_string(index), &headless_client::decode, this, std::ref(s));
+	}
+}
+
+void headless_client::operator()(to_headset::video_stream_data_shard && shard)
+{
+	if (shard.stream_item_idx >= streams.size())
+		return;
+	auto & s = *streams[shard.stream_item_idx];
+	auto & current = s.current;
+
+	if (s.resync)
+	{
+		s.next_frame = shard.frame_idx;
+		s.resync = false;
+	}
+
+	if (not current.shards.empty() and shard.frame_idx > current.feedback.frame_index)
+	{
+		// A newer frame started before this one was complete
+		send_feedback(current.feedback);
+		s.next_frame = current.feedback.frame_index + 1;
+		current.shards.clear();
+		update_stats([](statistics & stats) { ++stats.lost; });
+	}
+
+	if (shard.frame_idx < s.next_frame or (not current.shards.empty() and shard.frame_idx < current.feedback.frame_index))
+	{
+		update_stats([](statistics & stats) { ++stats.late_shards; });
+		return;
+	}
+
+	if (current.shards.empty())
+	{
+		update_stats([&](statistics & stats) { stats.lost += shard.frame_idx - s.next_frame; });
+		current.feedback = {
+		        .frame_index = shard.frame_idx,
+		        .stream_index = s.index,
+		        .received_first_packet = clock(),
+		};
+		current.view_info.reset();
+	}
+
+	auto idx = shard.shard_idx;
+	if (idx >= current.shards.size())
+		current.shards.resize(idx + 1);
+	if (current.shards[idx])
+		return;
+	if (shard.view_info)
+		current.view_info = shard.view_info;
+	current.shards[idx] = std::move(shard);
+
+	if (not(current.shards.back()->flags & data_shard::end_of_frame) or
+	    not std::ranges::all_of(current.shards, [](const auto & i) { return i.has_value(); }))
+		return;
+
+	current.feedback.received_last_packet = clock();
+	auto timing_info = current.shards.back()->timing_info.value_or(data_shard::timing_info_t{});
+	current.feedback.encode_begin = timing_info.encode_begin;
+	current.feedback.encode_end = timing_info.encode_end;
+	current.feedback.send_begin = timing_info.send_begin;
+	current.feedback.send_end = timing_info.send_end;
+	WIVRN_TRACE_STREAM_SLICE("receive", current.feedback.stream_index, current.feedback.received_first_packet, current.feedback.received_last_packet, tracing::flow::step, tracing::frame_id(current.feedback.stream_index, current.feedback.frame_index));
+
+	s.next_frame = current.feedback.frame_index + 1;
+	submit(s);
+}
+
+void headless_client::submit(stream & s)
+{
+	{
+		std::lock_guard lock(s.mutex);
+		s.pending.push_back(std::move(s.current));
+	}
+	s.cv.notify_one();
+	s.current = {};
+}
+
+void headless_client::operator()(to_headset::video_stream_repeat && repeat)
+{
+	if (repeat.stream_item_idx >= streams.size())
+		return;
+	auto & s = *streams[repeat.stream_item_idx];
+
+	if (not s.current.shards.empty() and repeat.frame_idx > s.current.feedback.frame_index)
+	{
+		send_feedback(s.current.feedback);
+		s.next_frame = s.current.feedback.frame_index + 1;
+		s.current = {};
+		update_stats([](statistics & stats) { ++stats.lost; });
+	}
+
+	if (repeat.frame_idx < s.next_frame or not s.current.shards.empty())
+		return;
+
+	update_stats([&](statistics & stats) {
+		stats.lost += repeat.frame_idx - s.next_frame;
+		++stats.repeated;
+	});
+	s.next_frame = repeat.frame_idx + 1;
+
+	XrTime t = clock();
+	XrDuration period = display_period;
+	send_feedback({
+	        .frame_index = repeat.frame_idx,
+	        .stream_index = s.index,
+	        .encode_begin = repeat.timing_info.encode_begin,
+	        .encode_end = repeat.timing_info.encode_end,
+	        .send_begin = repeat.timing_info.send_begin,
+	        .send_end = repeat.timing_info.send_end,
+	        .received_first_packet = t,
+	        .received_last_packet = t,
+	        .sent_to_decoder = t,
+	        .received_from_decoder = t,
+	        .blitted = t,
+	        .displayed = t + period - t % period,
+	        .times_displayed = 1,
+	});
+}
+
+void headless_client::decode(stream & s)
+{
+	while (true)
+	{
+		frame f;
+		{
+			std::unique_lock lock(s.mutex);
+			s.cv.wait(lock, [&]() { return s.exiting or not s.pending.empty(); });
+			if (s.exiting)
+				return;
+			f = std::move(s.pending.front());
+			s.pending.pop_front();
+		}
+
+		auto & feedback = f.feedback;
+		bool ok = true;
+		feedback.sent_to_decoder = clock();
+		if (s.decoder)
+		{
+			std::vector<std::span<const uint8_t>> payload;
+			payload.reserve(f.shards.size());
+			for (const auto & shard: f.shards)
+				payload.emplace_back(shard->payload);
+			try
+			{
+				ok = s.decoder->decode(payload, feedback.frame_index);
+			}
+			catch (std::exception & e)
+			{
+				spdlog::warn("Failed to decode frame {}: {}", feedback.frame_index, e.what());
+				ok = false;
+			}
+		}
+		feedback.received_from_decoder = clock();
+
+		// The virtual display shows the frame on the next vsync
+		XrDuration period = display_period;
+		feedback.blitted = feedback.received_from_decoder;
+		feedback.displayed = feedback.blitted + period - feedback.blitted % period;
+		feedback.times_displayed = ok ? 1 : 0;
+
+		WIVRN_TRACE_STREAM_SLICE("decode", feedback.stream_index, feedback.sent_to_decoder, feedback.received_from_decoder, tracing::flow::step, tracing::frame_id(feedback.stream_index, feedback.frame_index));
+		WIVRN_TRACE_STREAM_SLICE("display", feedback.stream_index, feedback.blitted, feedback.displayed, tracing::flow::end, tracing::frame_id(feedback.stream_index, feedback.frame_index));
+
+		send_feedback(feedback);
+
+		size_t bytes = 0;
+		for (const auto & shard: f.shards)
+			bytes += shard->payload.size();
+
+		update_stats([&](statistics & stats) {
+			++stats.frames;
+			stats.bytes += bytes;
+			if (not ok)
+			{
+				++stats.decode_errors;
+				return;
+			}
+			++stats.decoded;
+			if (f.view_info and feedback.displayed > f.view_info->display_time)
+				++stats.late;
+			if (feedback.encode_begin)
+			{
+				stats.encode.add(ms(feedback.encode_end - feedback.encode_begin));
+				stats.network.add(ms(feedback.received_last_packet - feedback.send_begin));
+				stats.total.add(ms(feedback.received_from_decoder - feedback.encode_begin));
+			}
+			stats.decode.add(ms(feedback.received_from_decoder - feedback.sent_to_decoder));
+		});
+	}
+}
+
+void headless_client::operator()(to_headset::timesync_query && query)
+{
+	if (not session)
+		return;
+
+	session->send_stream(from_headset::timesync_response{
+	        .query = query.query,
+	        .response = now(),
+	});
+}
+
+void headless_client::operator()(to_headset::tracking_control && control)
+{
+	min_offset = control.min_offset.count();
+	max_offset = control.max_offset.count();
+}
+
+void headless_client::operator()(to_headset::refresh_rate_change && rate)
+{
+	spdlog::info("Refresh rate changed to {}", rate.fps);
+	display_period = XrDuration(1'000'000'000 / rate.fps);
+}
+
+void headless_client::report(statistics & stats, std::chrono::duration<double> elapsed, uint64_t bytes_received)
+{
+	auto quantiles = [](const utils::quantile_sketch & q) {
+		return fmt::format("{:.2f}/{:.2f}/{:.2f}", q.quantile(0.5), q.quantile(0.9), q.quantile(0.99));
+	};
+	double seconds = std::max(elapsed.count(), 0.001);
+
+	fmt::print("frames: {} ({:.1f}fps), decoded: {}, errors: {}, lost: {}, repeated: {}, late: {}, late shards: {}\n",
+	           stats.frames,
+	           stats.frames / seconds,
+	           stats.decoded,
+	           stats.decode_errors,
+	           stats.lost,
+	           stats.repeated,
+	           stats.late,
+	           stats.late_shards);
+	fmt::print("throughput: {:.2f}Mbit/s video, {:.2f}Mbit/s total\n",
+	           stats.bytes * 8e-6 / seconds,
+	           bytes_received * 8e-6 / seconds);
+	fmt::print("latency p50/p90/p99 (ms): encode {}, network {}, decode {}, encode to decoded {}\n",
+	           quantiles(stats.encode),
+	           quantiles(stats.network),
+	           quantiles(stats.decode),
+	           quantiles(stats.total));
+	std::fflush(stdout);
+}
+
+void headless_client::run()
+{
+	const auto start = std::chrono::steady_clock::now();
+	auto last_report = start;
+	uint64_t last_bytes = session->bytes_received();
+
+	while (std::chrono::steady_clock::now() < start + opts.duration)
+	{
+		try
+		{
+			session->poll(*this, 100ms);
+		}
+		catch (std::exception & e)
+		{
+			spdlog::info("Connection lost: {}", e.what());
+			break;
+		}
+
+		auto t = std::chrono::steady_clock::now();
+		if (t >= last_report + opts.report_interval)
+		{
+			std::lock_guard lock(stats_mutex);
+			uint64_t bytes = session->bytes_received();
+			report(interval_stats, t - last_report, bytes - last_bytes);
+			interval_stats = statistics{};
+			last_report = t;
+			last_bytes = bytes;
+		}
+	}
+
+	print_total(start);
+}
+
+void headless_client::replay(session_reader & reader)
+{
+	auto first = reader.start();
+	if (not first)
+		throw std::runtime_error("recording is empty");
+
+	XrTime target = *first + std::chrono::nanoseconds(opts.start).count();
+	if (opts.start.count() > 0)
+	{
+		// The stream description is only sent when the stream starts, apply it before seeking
+		while (auto entry = reader.next())
+		{
+			auto packet = std::get_if<to_headset::packets>(&entry->packet);
+			if (not packet)
+				continue;
+			if (std::holds_alternative<to_headset::video_stream_data_shard>(*packet) or entry->timestamp >= target)
+				break;
+			std::visit(*this, std::move(*packet));
+		}
+		reader.seek(target);
+		for (auto & s: streams)
+			s->resync = true;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	auto last_report = start;
+	uint64_t last_bytes = 0;
+	replay_origin = target;
+	replay_wall_origin = now();
+
+	while (auto entry = reader.next())
+	{
+		auto packet = std::get_if<to_headset::packets>(&entry->packet);
+		if (not packet)
+			continue;
+
+		XrDuration delay = (entry->timestamp - clock()) / opts.speed;
+		if (delay > 0)
+			std::this_thread::sleep_for(std::chrono::nanoseconds(delay));
+
+		replay_bytes += serialized_size(*packet);
+		std::visit(*this, std::move(*packet));
+
+		auto t = std::chrono::steady_clock::now();
+		if (t >= last_report + opts.report_interval)
+		{
+			std::lock_guard lock(stats_mutex);
+			report(interval_stats, t - last_report, replay_bytes - last_bytes);
+			interval_stats = statistics{};
+			last_report = t;
+			last_bytes = replay_bytes;
+		}
+	}
+
+	print_total(start);
+}
+
+uint64_t headless_client::bytes_received() const
+{
+	if (session)
+		return session->bytes_received();
+	return replay_bytes;
+}
+
+void headless_client::print_total(std::chrono::steady_clock::time_point start)
+{
+	exiting = true;
+	if (tracking_thread.joinable())
+		tracking_thread.join();
+	stop_streams();
+
+	std::lock_guard lock(stats_mutex);
+	fmt::print("total:\n");
+	report(total_stats, std::chrono::steady_clock::now() - start, bytes_received());
+}
+} // namespace wivrn::headless
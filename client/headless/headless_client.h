@@ -0,0 +1,172 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cpu_decoder.h"
+#include "session_recording.h"
+#include "utils/quantile_sketch.h"
+#include "wivrn_client.h"
+#include "wivrn_packets.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace wivrn::headless
+{
+struct options
+{
+	std::chrono::seconds duration{30};
+	std::chrono::seconds report_interval{5};
+	std::vector<video_codec> codecs{h264, h265, av1, raw};
+	uint32_t eye_width = 1832;
+	uint32_t eye_height = 1920;
+	float refresh_rate = 90;
+	bool decode = true;
+	// Amplitude of the synthetic head rotation, in radians
+	float motion = 0.5;
+	// Replay speed, 2 plays the recording twice as fast
+	double speed = 1;
+	// Replay from this time, relative to the start of the recording
+	std::chrono::seconds start{0};
+};
+
+// Behaves as a headset without display: answers the server, sends head
+// poses following a fixed pattern and decodes the video on the CPU.
+// Without a session, it replays a recording made by a headset instead.
+class headless_client
+{
+	using data_shard = to_headset::video_stream_data_shard;
+
+	struct frame
+	{
+		std::vector<std::optional<data_shard>> shards;
+		from_headset::feedback feedback{};
+		std::optional<data_shard::view_info_t> view_info;
+	};
+
+	struct stream
+	{
+		uint8_t index;
+		to_headset::video_stream_description::item description;
+		std::unique_ptr<cpu_decoder> decoder;
+
+		// Frame being reassembled, only accessed from the network thread
+		frame current;
+		uint64_t next_frame = 0;
+		// Start from the next received frame instead of counting the previous ones as lost
+		bool resync = false;
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::deque<frame> pending;
+		bool exiting = false;
+		std::thread thread;
+	};
+
+	struct statistics
+	{
+		uint64_t frames = 0;
+		uint64_t decoded = 0;
+		uint64_t decode_errors = 0;
+		uint64_t lost = 0;
+		uint64_t repeated = 0;
+		uint64_t late = 0;
+		uint64_t late_shards = 0;
+		uint64_t bytes = 0;
+
+		// All values in ms
+		utils::quantile_sketch encode{0.01, 0.01, 1000, 100'000};
+		utils::quantile_sketch network{0.01, 0.01, 1000, 100'000};
+		utils::quantile_sketch decode{0.01, 0.01, 1000, 100'000};
+		utils::quantile_sketch total{0.01, 0.01, 1000, 100'000};
+	};
+
+	options opts;
+	std::unique_ptr<wivrn_session> session;
+	std::atomic<bool> exiting = false;
+
+	// Maps the current time to the time of the recording when replaying
+	XrTime replay_origin = 0;
+	XrTime replay_wall_origin = 0;
+	uint64_t replay_bytes = 0;
+
+	std::vector<std::unique_ptr<stream>> streams;
+
+	std::atomic<XrDuration> display_period;
+	std::atomic<XrDuration> min_offset = 0;
+	std::atomic<XrDuration> max_offset = 0;
+	std::thread tracking_thread;
+
+	std::mutex stats_mutex;
+	statistics interval_stats;
+	statistics total_stats;
+
+	template <typename F>
+	void update_stats(F && f)
+	{
+		std::lock_guard lock(stats_mutex);
+		f(interval_stats);
+		f(total_stats);
+	}
+
+	void tracking();
+	void decode(stream &);
+	void submit(stream &);
+	void send_feedback(const from_headset::feedback &);
+	void stop_streams();
+	void report(statistics &, std::chrono::duration<double> elapsed, uint64_t bytes_received);
+	uint64_t bytes_received() const;
+	void print_total(std::chrono::steady_clock::time_point start);
+
+	// Current time, in the time of the recording when replaying
+	XrTime clock() const;
+
+public:
+	static XrTime now();
+
+	// session: connection to the server, nullptr to replay a recording
+	headless_client(std::unique_ptr<wivrn_session> session, options opts);
+	~headless_client();
+
+	// Run until duration elapses or the server disconnects, then print the statistics
+	void run();
+
+	// Feed the packets received by a headset to the decoders, with the
+	// recorded timing scaled by the speed option, then print the statistics
+	void replay(session_reader & reader);
+
+	void operator()(to_headset::video_stream_description &&);
+	void operator()(to_headset::video_stream_data_shard &&);
+	void operator()(to_headset::video_stream_repeat &&);
+	void operator()(to_headset::timesync_query &&);
+	void operator()(to_headset::tracking_control &&);
+	void operator()(to_headset::refresh_rate_change &&);
+
+	template <typename T>
+	void operator()(T &&)
+	{}
+};
+} // namespace wivrn::headless
@@ -0,0 +1,282 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "headless_client.h"
+
+#include "crypto.h"
+#include "utils/tracing.h"
+#include "wivrn_config.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <netdb.h>
+#include <optional>
+#include <ranges>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <string>
+
+namespace
+{
+void usage(const char * argv0)
+{
+	std::cerr << "Usage: " << argv0 << " [options] host\n"
+	          << "       " << argv0 << " [options] --replay FILE\n"
+	          << "Connect to a WiVRn server as a headset without display and print streaming statistics,\n"
+	          << "or decode a session recorded by a headset.\n\n"
+	          << "  -p, --port PORT           server port (default " << wivrn::default_port << ")\n"
+	          << "  -t, --tcp                 use TCP only\n"
+	          << "  -d, --duration SECONDS    stop after this duration (default 30)\n"
+	          << "  -i, --interval SECONDS    statistics report interval (default 5)\n"
+	          << "  -c, --codec LIST          comma separated list of codecs, from preferred to least preferred\n"
+	          << "                            (default h264,h265,av1,raw)\n"
+	          << "  -r, --resolution WxH      per eye resolution (default 1832x1920)\n"
+	          << "  -f, --refresh-rate FPS    display refresh rate (default 90)\n"
+	          << "  -m, --motion RADIANS      amplitude of the synthetic head motion (default 0.5)\n"
+	          << "      --pin PIN             PIN to use if the server requires pairing\n"
+	          << "      --no-decode           do not decode the video\n"
+	          << "      --record FILE         record the session, to replay it later\n"
+	          << "      --replay FILE         replay a recorded session instead of connecting to a server,\n"
+	          << "                            the whole recording is played regardless of --duration\n"
+	          << "      --speed FACTOR        replay speed (default 1)\n"
+	          << "      --start SECONDS       replay from this time in the recording (default 0)\n"
+	          << "  -h, --help                show this help\n";
+}
+
+std::vector<wivrn::video_codec> parse_codecs(std::string_view list)
+{
+	std::vector<wivrn::video_codec> result;
+	for (auto part: std::views::split(list, ','))
+	{
+		std::string_view codec(part.begin(), part.end());
+		if (codec == "h264")
+			result.push_back(wivrn::h264);
+		else if (codec == "h265" or codec == "hevc")
+			result.push_back(wivrn::h265);
+		else if (codec == "av1")
+			result.push_back(wivrn::av1);
+		else if (codec == "raw")
+			result.push_back(wivrn::raw);
+		else
+			throw std::invalid_argument("unknown codec " + std::string(codec));
+	}
+	return result;
+}
+
+std::unique_ptr<wivrn_session> connect(const std::string & host, int port, bool tcp_only, const std::optional<std::string> & pin)
+{
+	addrinfo hint{
+	        .ai_flags = AI_ADDRCONFIG,
+	        .ai_family = AF_UNSPEC,
+	        .ai_socktype = SOCK_STREAM,
+	};
+	addrinfo * addresses;
+	if (int err = getaddrinfo(host.c_str(), nullptr, &hint, &addresses))
+		throw std::runtime_error("cannot resolve hostname " + host + ": " + gai_strerror(err));
+
+	auto keypair = crypto::key::generate_x448_keypair();
+	auto pin_enter = [&](int) {
+		if (pin)
+			return *pin;
+		std::cerr << "PIN: " << std::flush;
+		std::string line;
+		std::getline(std::cin, line);
+		return line;
+	};
+
+	std::unique_ptr<wivrn_session> session;
+	for (auto i = addresses; i and not session; i = i->ai_next)
+	{
+		try
+		{
+			switch (i->ai_family)
+			{
+				case AF_INET:
+					session = std::make_unique<wivrn_session>(((sockaddr_in *)i->ai_addr)->sin_addr, port, tcp_only, keypair, pin_enter);
+					break;
+				case AF_INET6:
+					session = std::make_unique<wivrn_session>(((sockaddr_in6 *)i->ai_addr)->sin6_addr, port, tcp_only, keypair, pin_enter);
+					break;
+			}
+		}
+		catch (std::exception & e)
+		{
+			spdlog::warn("Cannot connect to {}: {}", host, e.what());
+		}
+	}
+	freeaddrinfo(addresses);
+
+	if (not session)
+		throw std::runtime_error("cannot connect to " + host);
+	return session;
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	// Statistics go to stdout, logs to stderr
+	spdlog::set_default_logger(spdlog::stderr_color_mt("wivrn-headless"));
+
+	enum
+	{
+		opt_pin = 256,
+		opt_no_decode,
+		opt_record,
+		opt_replay,
+		opt_speed,
+		opt_start,
+	};
+	const option long_options[] = {
+	        {"port", required_argument, nullptr, 'p'},
+	        {"tcp", no_argument, nullptr, 't'},
+	        {"duration", required_argument, nullptr, 'd'},
+	        {"interval", required_argument, nullptr, 'i'},
+	        {"codec", required_argument, nullptr, 'c'},
+	        {"resolution", required_argument, nullptr, 'r'},
+	        {"refresh-rate", required_argument, nullptr, 'f'},
+	        {"motion", required_argument, nullptr, 'm'},
+	        {"pin", required_argument, nullptr, opt_pin},
+	        {"no-decode", no_argument, nullptr, opt_no_decode},
+	        {"record", required_argument, nullptr, opt_record},
+	        {"replay", required_argument, nullptr, opt_replay},
+	        {"speed", required_argument, nullptr, opt_speed},
+	        {"start", required_argument, nullptr, opt_start},
+	        {"help", no_argument, nullptr, 'h'},
+	        {},
+	};
+
+	wivrn::headless::options opts;
+	int port = wivrn::default_port;
+	bool tcp_only = false;
+	std::optional<std::string> pin;
+	std::optional<std::string> record;
+	std::optional<std::string> replay;
+
+	try
+	{
+		int c;
+		while ((c = getopt_long(argc, argv, "p:td:i:c:r:f:m:h", long_options, nullptr)) != -1)
+		{
+			switch (c)
+			{
+				case 'p':
+					port = std::stoi(optarg);
+					break;
+				case 't':
+					tcp_only = true;
+					break;
+				case 'd':
+					opts.duration = std::chrono::seconds(std::stoi(optarg));
+					break;
+				case 'i':
+					opts.report_interval = std::chrono::seconds(std::max(std::stoi(optarg), 1));
+					break;
+				case 'c':
+					opts.codecs = parse_codecs(optarg);
+					break;
+				case 'r':
+					if (sscanf(optarg, "%ux%u", &opts.eye_width, &opts.eye_height) != 2)
+						throw std::invalid_argument("invalid resolution");
+					break;
+				case 'f':
+					opts.refresh_rate = std::stof(optarg);
+					break;
+				case 'm':
+					opts.motion = std::stof(optarg);
+					break;
+				case opt_pin:
+					pin = optarg;
+					break;
+				case opt_no_decode:
+					opts.decode = false;
+					break;
+				case opt_record:
+					record = optarg;
+					break;
+				case opt_replay:
+					replay = optarg;
+					break;
+				case opt_speed:
+					opts.speed = std::stod(optarg);
+					if (opts.speed <= 0)
+						throw std::invalid_argument("speed must be positive");
+					break;
+				case opt_start:
+					opts.start = std::chrono::seconds(std::stoi(optarg));
+					break;
+				case 'h':
+					usage(argv[0]);
+					return 0;
+				default:
+					usage(argv[0]);
+					return 2;
+			}
+		}
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "Invalid argument: " << e.what() << std::endl;
+		return 2;
+	}
+
+	if (optind + (replay ? 0 : 1) != argc)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+#if WIVRN_FEATURE_TRACING
+	if (auto trace_file = std::getenv("WIVRN_TRACE"))
+	{
+		try
+		{
+			// Timestamps of a replay are the ones of the recording
+			wivrn::tracing::start(trace_file, "wivrn-headless", "frames");
+		}
+		catch (std::exception & e)
+		{
+			spdlog::warn("Cannot write trace to {}: {}", trace_file, e.what());
+		}
+	}
+#endif
+
+	try
+	{
+		if (replay)
+		{
+			wivrn::session_reader reader(*replay);
+			wivrn::headless::headless_client client(nullptr, opts);
+			client.replay(reader);
+			return 0;
+		}
+
+		auto session = connect(argv[optind], port, tcp_only, pin);
+		if (record)
+			session->set_recorder(std::make_shared<wivrn::session_recorder>(*record), &wivrn::headless::headless_client::now);
+		wivrn::headless::headless_client client(std::move(session), opts);
+		client.run();
+	}
+	catch (std::exception & e)
+	{
+		spdlog::error("{}", e.what());
+		return 1;
+	}
+	return 0;
+}
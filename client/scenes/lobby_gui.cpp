@@ -776,6 +776,14 @@ void scenes::lobby::gui_settings()
 			imgui_ctx->tooltip(_("Enables the configuration window to be shown while the game is streaming.\nIf enabled, the window is activated by pressing both thumbsticks."));
 	}
 
+	if (ImGui::Checkbox(_S("Record sessions"), &config.record_session))
+	{
+		config.save();
+	}
+	imgui_ctx->vibrate_on_hover();
+	if (ImGui::IsItemHovered())
+		imgui_ctx->tooltip(_("Save the video stream and tracking data of each session, to help reproducing streaming issues.\nRecordings use about 1GB for each minute of streaming, only the last 5 are kept."));
+
 	ImGui::PopStyleVar(); // ImGuiStyleVar_ItemSpacing
 }
 
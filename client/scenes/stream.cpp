@@ -38,8 +38,11 @@
 #include "utils/contains.h"
 #include "utils/named_thread.h"
 #include "utils/ranges.h"
+#include "utils/tracing.h"
 #include "wivrn_packets.h"
 #include <algorithm>
+#include <ctime>
+#include <filesystem>
 #include <mutex>
 #include <ranges>
 #include <thread>
@@ -186,11 +189,78 @@ static from_headset::visibility_mask_changed::masks get_visibility_mask(xr::inst
 	return res;
 }
 
+// Recordings use about 1GB per minute, only keep the last ones
+static const size_t max_recordings = 5;
+
+static void remove_old_recordings(const std::filesystem::path & dir)
+{
+	// Names are sorted by date, keep room for the new recording
+	std::vector<std::filesystem::path> recordings;
+	for (const auto & entry: std::filesystem::directory_iterator(dir))
+	{
+		if (entry.path().extension() == ".wivrnrec")
+			recordings.push_back(entry.path());
+	}
+	if (recordings.size() < max_recordings)
+		return;
+
+	std::ranges::sort(recordings);
+	for (size_t i = 0; i <= recordings.size() - max_recordings; ++i)
+	{
+		spdlog::info("Removing old recording {}", recordings[i].string());
+		std::filesystem::remove(recordings[i]);
+	}
+}
+
 std::shared_ptr<scenes::stream> scenes::stream::create(std::unique_ptr<wivrn_session> network_session, float guessed_fps, std::string server_name)
 {
 	std::shared_ptr<stream> self{new stream{std::move(server_name)}};
 	self->network_session = std::move(network_session);
 
+	if (application::get_config().record_session)
+	{
+		try
+		{
+			auto dir = application::get_data_path() / "recordings";
+			std::filesystem::create_directories(dir);
+			remove_old_recordings(dir);
+
+			char name[64];
+			time_t now = time(nullptr);
+			strftime(name, sizeof(name), "%Y%m%d-%H%M%S.wivrnrec", localtime(&now));
+
+			self->network_session->set_recorder(
+			        std::make_shared<session_recorder>(dir / name),
+			        [instance = &self->instance]() { return instance->now(); });
+			spdlog::info("Recording session to {}", (dir / name).string());
+		}
+		catch (std::exception & e)
+		{
+			spdlog::warn("Cannot record session: {}", e.what());
+		}
+	}
+
+#if WIVRN_FEATURE_TRACING
+	try
+	{
+		char name[64];
+		time_t now = time(nullptr);
+		strftime(name, sizeof(name), "trace-%Y%m%d-%H%M%S.json", localtime(&now));
+		auto path = application::get_cache_path() / name;
+
+		// Trace timestamps are XrTime, as the feedback sent to the server
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		int64_t monotonic = ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+		tracing::start(path, "wivrn", "frames", self->instance.now() - monotonic);
+		spdlog::info("Writing trace to {}", path.string());
+	}
+	catch (std::exception & e)
+	{
+		spdlog::warn("Cannot write trace: {}", e.what());
+	}
+#endif
+
 	self->network_session->send_control([&]() {
 		from_headset::headset_info_packet info{
 		        .language = application::get_messages_info().language,
@@ -514,7 +584,42 @@ scenes::stream::~stream()
 
 	if (network_thread.joinable())
 		network_thread.join();
+
+#if WIVRN_FEATURE_TRACING
+	tracing::stop();
+#endif
+}
+
+namespace
+{
+struct repeated_blit_handle : public shard_accumulator::blit_handle
+{
+	// Keeps the image alive
+	std::shared_ptr<shard_accumulator::blit_handle> source;
+};
+
+std::shared_ptr<shard_accumulator::blit_handle> make_repeat(
+        std::shared_ptr<shard_accumulator::blit_handle> source,
+        const from_headset::feedback & feedback,
+        const to_headset::video_stream_data_shard::view_info_t & view_info,
+        XrTime now)
+{
+	auto handle = new repeated_blit_handle{
+	        shard_accumulator::blit_handle{
+	                feedback,
+	                view_info,
+	                source->image_view,
+	                source->image,
+	                source->current_layout,
+	                source->semaphore,
+	                source->semaphore_val,
+	        },
+	        source,
+	};
+	handle->feedback.received_from_decoder = now;
+	return std::shared_ptr<shard_accumulator::blit_handle>(handle);
 }
+} // namespace
 
 void scenes::stream::push_blit_handle(shard_accumulator * decoder, std::shared_ptr<shard_accumulator::blit_handle> handle)
 {
@@ -522,17 +627,35 @@ void scenes::stream::push_blit_handle(shard_accumulator * decoder, std::shared_p
 	if (!application::is_visible())
 		return;
 
+	std::vector<std::shared_ptr<shard_accumulator::blit_handle>> replaced;
 	{
 		std::shared_lock lock(decoder_mutex);
 		std::unique_lock frame_lock(frames_mutex);
 		auto stream = handle->feedback.stream_index;
 		if (stream < decoders.size())
 		{
-			if (decoder != decoders[stream].decoder.get())
+			auto & images = decoders[stream];
+			if (decoder != images.decoder.get())
 				return;
-			handle->feedback.received_from_decoder = instance.now();
-			std::swap(handle, decoders[stream].latest_frames[handle->feedback.frame_index % decoders[stream].latest_frames.size()]);
+			auto now = instance.now();
+			handle->feedback.received_from_decoder = now;
+			WIVRN_TRACE_STREAM_SLICE("decode", stream, handle->feedback.sent_to_decoder, now, tracing::flow::step, tracing::frame_id(stream, handle->feedback.frame_index));
+			images.repeat_source = handle;
+			replaced.push_back(images.push(std::move(handle)));
+
+			// Repeated frames that were waiting for this one
+			const auto & source = images.repeat_source;
+			for (const auto & repeat: images.pending_repeats)
+			{
+				if (repeat.source_frame_index == source->feedback.frame_index)
+					replaced.push_back(images.push(make_repeat(source, repeat.feedback, repeat.view_info, now)));
+			}
+			std::erase_if(images.pending_repeats, [&](const auto & repeat) {
+				return repeat.source_frame_index <= source->feedback.frame_index;
+			});
 		}
+		else
+			replaced.push_back(std::move(handle));
 
 		if (state_ != state::streaming and std::ranges::all_of(decoders, [](accumulator_images & i) {
 			    return i.alpha() or not i.empty();
@@ -543,10 +666,55 @@ void scenes::stream::push_blit_handle(shard_accumulator * decoder, std::shared_p
 		}
 	}
 
-	if (handle and not handle->feedback.blitted)
+	for (const auto & h: replaced)
+	{
+		if (h and not h->feedback.blitted)
+			send_feedback(h->feedback);
+	}
+}
+
+void scenes::stream::push_repeat(shard_accumulator * decoder,
+                                 uint64_t source_frame_index,
+                                 const from_headset::feedback & feedback,
+                                 const to_headset::video_stream_data_shard::view_info_t & view_info)
+{
+	if (!application::is_visible())
+		return;
+
+	std::shared_ptr<shard_accumulator::blit_handle> replaced;
 	{
-		send_feedback(handle->feedback);
+		std::shared_lock lock(decoder_mutex);
+		std::unique_lock frame_lock(frames_mutex);
+		auto stream = feedback.stream_index;
+		if (stream >= decoders.size() or decoder != decoders[stream].decoder.get())
+			return;
+
+		auto & images = decoders[stream];
+		if (images.repeat_source and images.repeat_source->feedback.frame_index == source_frame_index)
+		{
+			replaced = images.push(make_repeat(images.repeat_source, feedback, view_info, instance.now()));
+		}
+		else
+		{
+			// Source frame is still being decoded
+			if (images.pending_repeats.size() >= image_buffer_size)
+				images.pending_repeats.erase(images.pending_repeats.begin());
+			images.pending_repeats.push_back({
+			        .source_frame_index = source_frame_index,
+			        .feedback = feedback,
+			        .view_info = view_info,
+			});
+		}
 	}
+
+	if (replaced and not replaced->feedback.blitted)
+		send_feedback(replaced->feedback);
+}
+
+std::shared_ptr<shard_accumulator::blit_handle> scenes::stream::accumulator_images::push(std::shared_ptr<shard_accumulator::blit_handle> handle)
+{
+	std::swap(handle, latest_frames[handle->feedback.frame_index % latest_frames.size()]);
+	return handle;
 }
 
 bool scenes::stream::accumulator_images::alpha() const
@@ -747,6 +915,7 @@ bool scenes::stream::is_gui_interactable() const
 
 void scenes::stream::render(const XrFrameState & frame_state)
 {
+	WIVRN_TRACE_SCOPE("render");
 	if (exiting)
 		application::pop_scene();
 
@@ -846,6 +1015,13 @@ void scenes::stream::render(const XrFrameState & frame_state)
 			state_ = stream::state::stalled;
 		++blit_handle->feedback.times_displayed;
 		blit_handle->feedback.displayed = frame_state.predictedDisplayTime;
+		if (blit_handle->feedback.times_displayed == 1)
+			WIVRN_TRACE_STREAM_SLICE("display",
+			                         blit_handle->feedback.stream_index,
+			                         blit_handle->feedback.blitted,
+			                         blit_handle->feedback.displayed,
+			                         tracing::flow::end,
+			                         tracing::frame_id(blit_handle->feedback.stream_index, blit_handle->feedback.frame_index));
 
 		pose = blit_handle->view_info.pose;
 		fov = blit_handle->view_info.fov;
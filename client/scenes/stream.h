@@ -63,6 +63,19 @@ private:
 		// latest frames, rolling buffer
 		std::array<std::shared_ptr<wivrn::shard_accumulator::blit_handle>, image_buffer_size> latest_frames;
 
+		// Latest decoded frame, its image is used for repeated frames
+		std::shared_ptr<wivrn::shard_accumulator::blit_handle> repeat_source;
+		// Repeated frames whose source is not decoded yet
+		struct pending_repeat
+		{
+			uint64_t source_frame_index;
+			wivrn::from_headset::feedback feedback;
+			wivrn::to_headset::video_stream_data_shard::view_info_t view_info;
+		};
+		std::vector<pending_repeat> pending_repeats;
+
+		// Store the frame in latest_frames, return the one it replaces
+		std::shared_ptr<wivrn::shard_accumulator::blit_handle> push(std::shared_ptr<wivrn::shard_accumulator::blit_handle>);
 		std::shared_ptr<wivrn::shard_accumulator::blit_handle> frame(uint64_t id) const;
 		bool alpha() const;
 		bool empty() const;
@@ -201,9 +214,15 @@ public:
 	void operator()(to_headset::application_list &&);
 	void operator()(to_headset::application_icon &&);
 	void operator()(to_headset::running_applications &&);
+	void operator()(to_headset::video_stream_repeat &&);
 	void operator()(audio_data &&);
 
 	void push_blit_handle(wivrn::shard_accumulator * decoder, std::shared_ptr<wivrn::shard_accumulator::blit_handle> handle);
+	// Display the image of source_frame_index again with a new view information
+	void push_repeat(wivrn::shard_accumulator * decoder,
+	                 uint64_t source_frame_index,
+	                 const wivrn::from_headset::feedback & feedback,
+	                 const wivrn::to_headset::video_stream_data_shard::view_info_t & view_info);
 
 	void send_feedback(const wivrn::from_headset::feedback & feedback);
 
@@ -60,6 +60,15 @@ void scenes::stream::operator()(to_headset::video_stream_data_shard && shard)
 	decoders[idx].decoder->push_shard(std::move(shard));
 }
 
+void scenes::stream::operator()(to_headset::video_stream_repeat && repeat)
+{
+	std::shared_lock lock(decoder_mutex);
+	uint8_t idx = repeat.stream_item_idx;
+	if (idx >= decoders.size())
+		return;
+	decoders[idx].decoder->push_repeat(std::move(repeat));
+}
+
 void scenes::stream::operator()(to_headset::audio_stream_description && desc)
 {
 	audio_handle.emplace(desc, *network_session, instance);
@@ -20,9 +20,12 @@
 #pragma once
 
 #include "crypto.h"
+#include "session_recording.h"
 #include "wivrn_packets.h"
 #include "wivrn_sockets.h"
 #include <chrono>
+#include <functional>
+#include <memory>
 #include <poll.h>
 
 using namespace wivrn;
@@ -49,6 +52,41 @@ private:
 	template <typename T>
 	void handshake(T address, bool tcp_only, crypto::key & headset_keypair, std::function<std::string(int fd)> pin_enter);
 
+	std::shared_ptr<session_recorder> recorder;
+	std::function<XrTime()> recorder_clock;
+
+	template <typename T>
+	void record_sent(const T & packet)
+	{
+		// Microphone data is not recorded
+		if constexpr (not std::is_same_v<std::decay_t<T>, audio_data>)
+		{
+			if (recorder)
+			{
+				thread_local serialization_packet p;
+				control_socket_t::serialize(p, packet);
+				recorder->record(recorder_clock(), session_recording::record_type::sent, p);
+			}
+		}
+	}
+
+	void record_sent(std::span<serialization_packet> packets)
+	{
+		if (recorder)
+		{
+			for (auto & packet: packets)
+				recorder->record(recorder_clock(), session_recording::record_type::sent, packet);
+		}
+	}
+
+	template <typename T>
+	void dispatch(T && visitor, to_headset::packets && packet)
+	{
+		if (recorder)
+			recorder->record(recorder_clock(), packet);
+		std::visit(std::forward<T>(visitor), std::move(packet));
+	}
+
 public:
 	std::variant<in_addr, in6_addr> address;
 
@@ -57,15 +95,25 @@ public:
 	wivrn_session(const wivrn_session &) = delete;
 	wivrn_session & operator=(const wivrn_session &) = delete;
 
+	// Records all the packets exchanged with the server, until the session is closed
+	// now: current headset time, to timestamp the packets
+	void set_recorder(std::shared_ptr<session_recorder> recorder, std::function<XrTime()> now)
+	{
+		this->recorder = std::move(recorder);
+		recorder_clock = std::move(now);
+	}
+
 	template <typename T>
 	void send_control(T && packet)
 	{
+		record_sent(packet);
 		control.send(std::forward<T>(packet));
 	}
 
 	template <typename T>
 	void send_stream(T && packet)
 	{
+		record_sent(packet);
 		if (stream)
 			stream.send(std::forward<T>(packet));
 		else
@@ -82,9 +130,9 @@ public:
 		fds[1].fd = control.get_fd();
 
 		while (auto packet = stream.receive_pending())
-			std::visit(std::forward<T>(visitor), std::move(*packet));
+			dispatch(std::forward<T>(visitor), std::move(*packet));
 		while (auto packet = control.receive_pending())
-			std::visit(std::forward<T>(visitor), std::move(*packet));
+			dispatch(std::forward<T>(visitor), std::move(*packet));
 
 		int r = ::poll(fds, std::size(fds), timeout.count());
 		if (r < 0)
@@ -100,14 +148,14 @@ public:
 		{
 			auto packet = stream.receive();
 			if (packet)
-				std::visit(std::forward<T>(visitor), std::move(*packet));
+				dispatch(std::forward<T>(visitor), std::move(*packet));
 		}
 
 		if (fds[1].revents & POLLIN)
 		{
 			auto packet = control.receive();
 			if (packet)
-				std::visit(std::forward<T>(visitor), std::move(*packet));
+				dispatch(std::forward<T>(visitor), std::move(*packet));
 		}
 
 		return r;
@@ -0,0 +1,440 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "net_emulator.h"
+
+#include "utils/named_thread.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <pthread.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+// Datagrams are dropped when the bandwidth capped link has more queued data
+const auto max_queue_delay = 200ms;
+
+std::string_view trim(std::string_view s)
+{
+	auto begin = s.find_first_not_of(" \t\r\n");
+	if (begin == std::string_view::npos)
+		return {};
+	auto end = s.find_last_not_of(" \t\r\n");
+	return s.substr(begin, end - begin + 1);
+}
+
+std::vector<std::string_view> split(std::string_view s, std::string_view delimiters)
+{
+	std::vector<std::string_view> result;
+	while (true)
+	{
+		auto pos = s.find_first_of(delimiters);
+		result.push_back(trim(s.substr(0, pos)));
+		if (pos == std::string_view::npos)
+			return result;
+		s = s.substr(pos + 1);
+	}
+}
+
+double parse_number(std::string_view value, std::string_view & suffix)
+{
+	double result;
+	auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+	if (ec != std::errc{})
+		throw std::invalid_argument("invalid number " + std::string(value));
+	suffix = std::string_view(ptr, value.data() + value.size());
+	return result;
+}
+
+double parse_probability(std::string_view value)
+{
+	std::string_view suffix;
+	double result = parse_number(value, suffix);
+	if (not suffix.empty() or result < 0 or result > 1)
+		throw std::invalid_argument("invalid probability " + std::string(value));
+	return result;
+}
+
+std::chrono::microseconds parse_duration(std::string_view value, std::chrono::microseconds default_unit)
+{
+	std::string_view unit;
+	double result = parse_number(value, unit);
+	if (unit.empty())
+		return std::chrono::microseconds(int64_t(result * default_unit.count()));
+	if (unit == "us")
+		return std::chrono::microseconds(int64_t(result));
+	if (unit == "ms")
+		return std::chrono::microseconds(int64_t(result * 1'000));
+	if (unit == "s")
+		return std::chrono::microseconds(int64_t(result * 1'000'000));
+	throw std::invalid_argument("invalid duration " + std::string(value));
+}
+
+uint64_t parse_rate(std::string_view value)
+{
+	std::string_view unit;
+	double result = parse_number(value, unit);
+	if (unit.ends_with("bit"))
+		unit.remove_suffix(3);
+	if (unit.empty())
+		return result;
+	if (unit == "k")
+		return result * 1'000;
+	if (unit == "M")
+		return result * 1'000'000;
+	if (unit == "G")
+		return result * 1'000'000'000;
+	throw std::invalid_argument("invalid rate " + std::string(value));
+}
+
+// Comparison for a heap where the front is the earliest packet
+const auto later = [](const auto & a, const auto & b) {
+	return a.due > b.due or (a.due == b.due and a.sequence > b.sequence);
+};
+
+size_t total_size(std::span<const iovec> data)
+{
+	size_t size = 0;
+	for (const auto & i: data)
+		size += i.iov_len;
+	return size;
+}
+} // namespace
+
+namespace wivrn
+{
+std::vector<net_emulator::step> net_emulator::parse(std::string_view description, uint64_t & seed)
+{
+	std::vector<step> steps;
+	parameters params;
+	for (auto part: split(description, ";\n"))
+	{
+		if (part.empty() or part.starts_with('#'))
+			continue;
+
+		step s{.params = params};
+		if (auto colon = part.find(':'); colon != std::string_view::npos)
+		{
+			s.start = std::chrono::duration_cast<std::chrono::milliseconds>(parse_duration(trim(part.substr(0, colon)), 1s));
+			part = part.substr(colon + 1);
+		}
+		if (not steps.empty() and s.start <= steps.back().start)
+			throw std::invalid_argument("steps must be in increasing time order");
+
+		for (auto item: split(part, ","))
+		{
+			if (item.empty())
+				continue;
+			auto eq = item.find('=');
+			if (eq == std::string_view::npos)
+				throw std::invalid_argument("expected key=value, got " + std::string(item));
+			auto key = trim(item.substr(0, eq));
+			auto value = trim(item.substr(eq + 1));
+
+			auto & p = s.params;
+			if (key == "seed")
+			{
+				std::string_view suffix;
+				seed = parse_number(value, suffix);
+			}
+			else if (key == "loss")
+				p.loss = parse_probability(value);
+			else if (key == "burst")
+			{
+				// enter/exit[/loss]
+				auto values = split(value, "/");
+				if (values.size() < 2 or values.size() > 3)
+					throw std::invalid_argument("burst must be enter/exit or enter/exit/loss");
+				p.burst_enter = parse_probability(values[0]);
+				p.burst_exit = parse_probability(values[1]);
+				p.burst_loss = values.size() == 3 ? parse_probability(values[2]) : 1;
+			}
+			else if (key == "receive_loss")
+				p.receive_loss = parse_probability(value);
+			else if (key == "delay")
+				p.delay = parse_duration(value, 1ms);
+			else if (key == "jitter")
+				p.jitter = parse_duration(value, 1ms);
+			else if (key == "reorder")
+				p.reorder = parse_probability(value);
+			else if (key == "duplicate")
+				p.duplicate = parse_probability(value);
+			else if (key == "rate")
+				p.rate = parse_rate(value);
+			else
+				throw std::invalid_argument("unknown parameter " + std::string(key));
+		}
+		params = s.params;
+		steps.push_back(s);
+	}
+
+	if (steps.empty())
+		steps.emplace_back();
+	return steps;
+}
+
+net_emulator::net_emulator(std::vector<step> steps_, uint64_t seed) :
+        steps(std::move(steps_)),
+        start(std::chrono::steady_clock::now()),
+        seed(seed)
+{
+	static net_emulator * self;
+	self = this;
+
+	// Only the forking thread exists in the child: the worker must be restarted
+	// and the queued data belongs to the parent.
+	pthread_atfork(
+	        []() { self->mutex.lock(); },
+	        []() { self->mutex.unlock(); },
+	        []() {
+		        self->queue.clear();
+		        self->stream_tail.clear();
+		        self->sending_fd = -1;
+		        self->worker_running = false;
+		        new (&self->cv) std::condition_variable;
+		        self->mutex.unlock();
+	        });
+}
+
+net_emulator * net_emulator::instance()
+{
+	static net_emulator * emulator = []() -> net_emulator * {
+		const char * env = std::getenv("WIVRN_NETEM");
+		if (not env or not *env)
+			return nullptr;
+
+		try
+		{
+			std::string description = env;
+			if (description.starts_with('@'))
+			{
+				std::ifstream file(description.substr(1));
+				if (not file)
+					throw std::runtime_error("cannot open " + description.substr(1));
+				description.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+
+			uint64_t seed = 0;
+			auto steps = parse(description, seed);
+			std::cerr << "Network emulation enabled: " << steps.size() << " step(s), seed " << seed << std::endl;
+			return new net_emulator(std::move(steps), seed);
+		}
+		catch (std::exception & e)
+		{
+			std::cerr << "Invalid WIVRN_NETEM, network emulation disabled: " << e.what() << std::endl;
+			return nullptr;
+		}
+	}();
+	return emulator;
+}
+
+const net_emulator::parameters & net_emulator::params(std::chrono::steady_clock::time_point now)
+{
+	while (current_step + 1 < steps.size() and now - start >= steps[current_step + 1].start)
+	{
+		++current_step;
+		std::cerr << "Network emulation: step " << current_step << " at " << steps[current_step].start << std::endl;
+	}
+	return steps[current_step].params;
+}
+
+net_emulator::channel & net_emulator::get_channel(int fd, direction dir)
+{
+	// Threads are named, encoder threads have the same names in every run
+	thread_local std::string thread_name = []() {
+		char name[16]{};
+		pthread_getname_np(pthread_self(), name, sizeof(name));
+		return std::string(name);
+	}();
+
+	auto key = std::make_tuple(fd, dir, thread_name);
+	if (auto it = channels.find(key); it != channels.end())
+		return it->second;
+
+	// FNV-1a, std::hash is not guaranteed to give the same result in every build
+	uint64_t name_hash = 0xcbf29ce484222325;
+	for (char c: thread_name)
+		name_hash = (name_hash ^ uint8_t(c)) * 0x100000001b3;
+
+	std::seed_seq seq{
+	        uint32_t(seed),
+	        uint32_t(seed >> 32),
+	        uint32_t(fd),
+	        uint32_t(dir),
+	        uint32_t(name_hash),
+	        uint32_t(name_hash >> 32),
+	};
+	return channels.emplace(std::move(key), channel{.rng = std::mt19937_64(seq)}).first->second;
+}
+
+bool net_emulator::draw(channel & c, double probability)
+{
+	// Do not use the generator for disabled impairments, so that results
+	// with a given seed only depend on the enabled ones
+	return probability > 0 and std::uniform_real_distribution<double>(0, 1)(c.rng) < probability;
+}
+
+std::chrono::steady_clock::time_point net_emulator::transmit(std::chrono::steady_clock::time_point now, size_t size, const parameters & p)
+{
+	if (not p.rate)
+		return now;
+
+	link_free = std::max(link_free, now) + std::chrono::nanoseconds(size * 8'000'000'000 / p.rate);
+	return link_free;
+}
+
+void net_emulator::push(std::chrono::steady_clock::time_point due, int fd, bool stream, std::span<const iovec> data)
+{
+	packet & p = queue.emplace_back(due, sequence++, fd, stream);
+	p.data.reserve(total_size(data));
+	for (const auto & i: data)
+		p.data.insert(p.data.end(), (const uint8_t *)i.iov_base, (const uint8_t *)i.iov_base + i.iov_len);
+	std::ranges::push_heap(queue, later);
+
+	if (not worker_running)
+	{
+		worker_running = true;
+		utils::named_thread("net_emulator", &net_emulator::run, this).detach();
+	}
+	cv.notify_all();
+}
+
+void net_emulator::send_datagram(int fd, std::span<const iovec> data)
+{
+	size_t size = total_size(data);
+
+	std::lock_guard lock(mutex);
+	auto now = std::chrono::steady_clock::now();
+	const auto & p = params(now);
+	auto & c = get_channel(fd, direction::send);
+
+	if (p.burst_enter > 0)
+		c.burst = c.burst ? not draw(c, p.burst_exit) : draw(c, p.burst_enter);
+	else
+		c.burst = false;
+
+	if (draw(c, p.loss) or (c.burst and draw(c, p.burst_loss)))
+		return;
+
+	int copies = draw(c, p.duplicate) ? 2 : 1;
+	for (int i = 0; i < copies; ++i)
+	{
+		if (p.rate and link_free - now > max_queue_delay)
+			return;
+
+		auto due = transmit(now, size, p);
+		if (not draw(c, p.reorder))
+		{
+			due += p.delay;
+			if (p.jitter.count() > 0)
+				due += std::chrono::microseconds(std::uniform_int_distribution<int64_t>(0, p.jitter.count())(c.rng));
+		}
+		push(due, fd, false, data);
+	}
+}
+
+void net_emulator::send_stream(int fd, std::span<const iovec> data)
+{
+	std::lock_guard lock(mutex);
+	auto now = std::chrono::steady_clock::now();
+	const auto & p = params(now);
+
+	auto due = transmit(now, total_size(data), p) + p.delay;
+	if (p.jitter.count() > 0)
+		due += std::chrono::microseconds(std::uniform_int_distribution<int64_t>(0, p.jitter.count())(get_channel(fd, direction::send).rng));
+
+	auto & tail = stream_tail[fd];
+	due = std::max(due, tail);
+	tail = due;
+
+	push(due, fd, true, data);
+}
+
+bool net_emulator::keep_received(int fd)
+{
+	std::lock_guard lock(mutex);
+	return not draw(get_channel(fd, direction::receive), params(std::chrono::steady_clock::now()).receive_loss);
+}
+
+void net_emulator::forget(int fd)
+{
+	std::unique_lock lock(mutex);
+	if (std::erase_if(queue, [fd](const packet & p) { return p.fd == fd; }))
+		std::ranges::make_heap(queue, later);
+	stream_tail.erase(fd);
+	// A new socket with the same descriptor starts from the initial state
+	std::erase_if(channels, [fd](const auto & item) { return std::get<0>(item.first) == fd; });
+	cv.wait(lock, [&]() { return sending_fd != fd; });
+}
+
+void net_emulator::run()
+{
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		if (queue.empty())
+		{
+			cv.wait(lock);
+			continue;
+		}
+
+		if (auto due = queue.front().due; due > std::chrono::steady_clock::now())
+		{
+			cv.wait_until(lock, due);
+			continue;
+		}
+
+		std::ranges::pop_heap(queue, later);
+		packet p = std::move(queue.back());
+		queue.pop_back();
+		sending_fd = p.fd;
+		lock.unlock();
+
+		if (p.stream)
+		{
+			// Errors are detected by the receiving side of the connection
+			size_t offset = 0;
+			while (offset < p.data.size())
+			{
+				ssize_t sent = ::send(p.fd, p.data.data() + offset, p.data.size() - offset, MSG_NOSIGNAL);
+				if (sent <= 0)
+					break;
+				offset += sent;
+			}
+		}
+		else
+		{
+			// Failures are the same as lost datagrams
+			::send(p.fd, p.data.data(), p.data.size(), 0);
+		}
+
+		lock.lock();
+		sending_fd = -1;
+		cv.notify_all();
+	}
+}
+} // namespace wivrn
@@ -0,0 +1,148 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace wivrn
+{
+// Degrades the traffic of network sockets, to reproduce bad networks without
+// root access or a dedicated access point.
+// It is enabled by the WIVRN_NETEM environment variable, the value is a list
+// of steps separated by ';', each one is an optional start time followed by ':'
+// and comma separated parameters, for instance:
+//   WIVRN_NETEM="seed=1,delay=5ms;10s:loss=0.05,jitter=2ms;20s:loss=0"
+// Parameters not set in a step keep the value of the previous step.
+// If the value starts with '@', the steps are read from the file, one per line.
+class net_emulator
+{
+public:
+	struct parameters
+	{
+		// Probability to drop a sent datagram
+		double loss = 0;
+		// Gilbert-Elliott burst losses: probabilities to enter and leave the bad state,
+		// datagrams are dropped with burst_loss probability in the bad state
+		double burst_enter = 0;
+		double burst_exit = 1;
+		double burst_loss = 1;
+		// Probability to drop a received datagram
+		double receive_loss = 0;
+		std::chrono::microseconds delay{};
+		// Maximum random delay added to delay, datagrams may be reordered
+		std::chrono::microseconds jitter{};
+		// Probability for a datagram to skip the delay, overtaking the previous ones
+		double reorder = 0;
+		// Probability for a datagram to be sent twice
+		double duplicate = 0;
+		// Bandwidth cap in bit/s, 0 for unlimited
+		uint64_t rate = 0;
+	};
+
+	struct step
+	{
+		std::chrono::milliseconds start{};
+		parameters params;
+	};
+
+private:
+	struct packet
+	{
+		std::chrono::steady_clock::time_point due;
+		uint64_t sequence;
+		int fd;
+		bool stream;
+		std::vector<uint8_t> data;
+	};
+
+	const std::vector<step> steps;
+	const std::chrono::steady_clock::time_point start;
+	size_t current_step = 0;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	// heap ordered by due time
+	std::vector<packet> queue;
+	uint64_t sequence = 0;
+
+	// Random state of each socket, direction and sending thread, seeded from
+	// the configured seed, so that the impairments of a socket do not depend
+	// on the traffic of the other sockets or on how threads are scheduled
+	struct channel
+	{
+		std::mt19937_64 rng;
+		// Gilbert-Elliott state
+		bool burst = false;
+	};
+	enum class direction
+	{
+		send,
+		receive,
+	};
+	const uint64_t seed;
+	std::map<std::tuple<int, direction, std::string>, channel> channels;
+	// When the link is available for the next packet, for the bandwidth cap
+	std::chrono::steady_clock::time_point link_free;
+	// Due time of the last stream data for each socket, stream data is never reordered
+	std::unordered_map<int, std::chrono::steady_clock::time_point> stream_tail;
+
+	// Socket being written by the worker thread
+	int sending_fd = -1;
+	bool worker_running = false;
+
+	net_emulator(std::vector<step> steps, uint64_t seed);
+
+	const parameters & params(std::chrono::steady_clock::time_point now);
+	channel & get_channel(int fd, direction);
+	static bool draw(channel &, double probability);
+	std::chrono::steady_clock::time_point transmit(std::chrono::steady_clock::time_point now, size_t size, const parameters &);
+	void push(std::chrono::steady_clock::time_point due, int fd, bool stream, std::span<const iovec> data);
+	void run();
+
+public:
+	net_emulator(const net_emulator &) = delete;
+	net_emulator & operator=(const net_emulator &) = delete;
+
+	// nullptr if emulation is disabled, the emulator is never destroyed
+	// so that sockets can be closed during exit
+	static net_emulator * instance();
+
+	static std::vector<step> parse(std::string_view description, uint64_t & seed);
+
+	void send_datagram(int fd, std::span<const iovec> data);
+	// Only delay and bandwidth cap apply to stream data
+	void send_stream(int fd, std::span<const iovec> data);
+	// false if the received datagram must be dropped
+	bool keep_received(int fd);
+	// Drop queued data of a socket before it is closed
+	void forget(int fd);
+};
+} // namespace wivrn
@@ -0,0 +1,55 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace wivrn
+{
+// Frames of the raw codec are made of independent chunks,
+// each one is a header immediately followed by compressed_size bytes of payload.
+// Chunks cover disjoint ranges of the NV12 (or R8 for alpha) image.
+struct raw_chunk_header
+{
+	enum class compression_t : uint8_t
+	{
+		none,
+		lz4,
+	};
+
+	enum flags_t : uint8_t
+	{
+		// payload is xor'ed with the same range of reference_frame
+		delta = 1 << 0,
+	};
+
+	// position of the chunk in the decompressed frame
+	uint32_t offset;
+	// size of the decompressed chunk
+	uint32_t size;
+	// size of the payload
+	uint32_t compressed_size;
+	compression_t compression;
+	uint8_t flags;
+	uint16_t reserved;
+	// only meaningful for delta chunks
+	uint64_t reference_frame;
+};
+static_assert(sizeof(raw_chunk_header) == 24);
+} // namespace wivrn
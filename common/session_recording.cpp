@@ -0,0 +1,228 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "session_recording.h"
+
+#include "protocol_version.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace wivrn::session_recording;
+
+namespace wivrn
+{
+
+namespace
+{
+// Interval between index entries, in nanoseconds
+constexpr int64_t index_interval = 1'000'000'000;
+} // namespace
+
+session_recorder::session_recorder(const std::filesystem::path & path) :
+        writer(path)
+{
+	header h{
+	        .format_version = session_recording::format_version,
+	        .reserved = 0,
+	        .protocol_version = wivrn::protocol_version,
+	};
+	memcpy(h.magic, session_recording::magic, sizeof(h.magic));
+	writer.write(std::span((const uint8_t *)&h, sizeof(h)));
+}
+
+session_recorder::~session_recorder()
+{
+	std::lock_guard lock(mutex);
+	record_header h{
+	        .timestamp = index.empty() ? 0 : index.back().timestamp,
+	        .type = record_type::index,
+	        .size = uint32_t(index.size() * sizeof(index_entry)),
+	};
+	std::vector<uint8_t> data(sizeof(h) + h.size + sizeof(trailer));
+	memcpy(data.data(), &h, sizeof(h));
+	memcpy(data.data() + sizeof(h), index.data(), h.size);
+
+	// The index is large enough to be dropped if the queue is full, the
+	// trailer must then not be written
+	if (auto offset = writer.write(std::span(data).first(sizeof(h) + h.size)))
+	{
+		trailer t{.index_offset = *offset};
+		memcpy(t.magic, session_recording::index_magic, sizeof(t.magic));
+		writer.write(std::span((const uint8_t *)&t, sizeof(t)));
+	}
+}
+
+void session_recorder::write(XrTime timestamp, record_type type, serialization_packet & packet)
+{
+	const auto & spans = static_cast<std::vector<std::span<uint8_t>> &>(packet);
+
+	size_t size = 0;
+	for (const auto & span: spans)
+		size += span.size();
+
+	record_header h{
+	        .timestamp = timestamp,
+	        .type = type,
+	        .size = uint32_t(size),
+	};
+	std::vector<uint8_t> data(sizeof(h) + size);
+	memcpy(data.data(), &h, sizeof(h));
+	auto it = data.begin() + sizeof(h);
+	for (const auto & span: spans)
+		it = std::ranges::copy(span, it).out;
+
+	auto offset = writer.write(std::move(data));
+	if (offset and (index.empty() or timestamp >= index.back().timestamp + index_interval))
+		index.push_back({.timestamp = timestamp, .offset = *offset});
+}
+
+void session_recorder::record(XrTime timestamp, const to_headset::packets & p)
+{
+	if (std::holds_alternative<audio_data>(p))
+		return;
+
+	std::lock_guard lock(mutex);
+	packet.clear();
+	packet.serialize(p);
+	write(timestamp, record_type::received, packet);
+}
+
+void session_recorder::record(XrTime timestamp, const from_headset::packets & p)
+{
+	std::lock_guard lock(mutex);
+	packet.clear();
+	packet.serialize(p);
+	write(timestamp, record_type::sent, packet);
+}
+
+void session_recorder::record(XrTime timestamp, record_type type, serialization_packet & packet)
+{
+	std::lock_guard lock(mutex);
+	write(timestamp, type, packet);
+}
+
+session_reader::session_reader(const std::filesystem::path & path) :
+        file(path, std::ios::binary)
+{
+	if (not file)
+		throw std::runtime_error("Failed to open " + path.string());
+
+	header h;
+	if (not file.read((char *)&h, sizeof(h)) or memcmp(h.magic, session_recording::magic, sizeof(h.magic)))
+		throw std::runtime_error(path.string() + " is not a session recording");
+	if (h.format_version != session_recording::format_version)
+		throw std::runtime_error("Unsupported recording format version " + std::to_string(h.format_version));
+	if (h.protocol_version != wivrn::protocol_version)
+		throw std::runtime_error("Recording was made with a different protocol version");
+
+	file.seekg(0, std::ios::end);
+	end = file.tellg();
+
+	trailer t;
+	if (end >= sizeof(header) + sizeof(record_header) + sizeof(trailer))
+	{
+		file.seekg(end - sizeof(t));
+		file.read((char *)&t, sizeof(t));
+		record_header index_header;
+		if (not memcmp(t.magic, session_recording::index_magic, sizeof(t.magic)) and
+		    t.index_offset + sizeof(index_header) <= end - sizeof(t) and
+		    file.seekg(t.index_offset).read((char *)&index_header, sizeof(index_header)) and
+		    index_header.type == record_type::index and
+		    t.index_offset + sizeof(index_header) + index_header.size <= end - sizeof(t))
+		{
+			index.resize(index_header.size / sizeof(index_entry));
+			file.read((char *)index.data(), index.size() * sizeof(index_entry));
+			end = t.index_offset;
+		}
+	}
+
+	file.clear();
+	file.seekg(sizeof(header));
+}
+
+std::optional<session_reader::entry> session_reader::next()
+{
+	while (true)
+	{
+		uint64_t pos = file.tellg();
+		record_header h;
+		if (pos + sizeof(h) > end or not file.read((char *)&h, sizeof(h)))
+			return std::nullopt;
+
+		// Truncated record at the end of an interrupted recording
+		if (pos + sizeof(h) + h.size > end)
+			return std::nullopt;
+
+		std::shared_ptr<uint8_t[]> memory(new uint8_t[h.size]);
+		if (not file.read((char *)memory.get(), h.size))
+			return std::nullopt;
+
+		deserialization_packet packet(memory, std::span(memory.get(), h.size));
+		switch (h.type)
+		{
+			case record_type::received:
+				return entry{h.timestamp, packet.deserialize<to_headset::packets>()};
+			case record_type::sent:
+				return entry{h.timestamp, packet.deserialize<from_headset::packets>()};
+			case record_type::index:
+				return std::nullopt;
+		}
+		// Unknown record type, skip it
+	}
+}
+
+void session_reader::seek(XrTime timestamp)
+{
+	uint64_t pos = sizeof(header);
+	auto it = std::ranges::upper_bound(index, timestamp, {}, &index_entry::timestamp);
+	if (it != index.begin())
+		pos = std::prev(it)->offset;
+
+	file.clear();
+	file.seekg(pos);
+	record_header h;
+	while (pos + sizeof(h) <= end and file.read((char *)&h, sizeof(h)))
+	{
+		if (h.timestamp >= timestamp or h.type == record_type::index)
+			break;
+		pos += sizeof(h) + h.size;
+		file.seekg(pos);
+	}
+	file.clear();
+	file.seekg(pos);
+}
+
+std::optional<XrTime> session_reader::start()
+{
+	auto pos = file.tellg();
+	file.clear();
+	file.seekg(sizeof(header));
+
+	record_header h;
+	std::optional<XrTime> result;
+	if (sizeof(header) + sizeof(h) <= end and file.read((char *)&h, sizeof(h)) and h.type != record_type::index)
+		result = h.timestamp;
+
+	file.clear();
+	file.seekg(pos);
+	return result;
+}
+
+} // namespace wivrn
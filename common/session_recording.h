@@ -0,0 +1,145 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "utils/async_writer.h"
+#include "wivrn_packets.h"
+#include "wivrn_serialization.h"
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <variant>
+#include <vector>
+
+namespace wivrn
+{
+
+// Recording of the packets exchanged by a headset, with the headset time at
+// which they were received or sent, to replay a session offline.
+//
+// File layout, all integers are little endian:
+//   header:  "WIVRNREC", uint32 format version, uint32 reserved, uint64 protocol version
+//   records: int64 timestamp, uint8 type, 3 bytes padding, uint32 size, serialized packet
+//   index:   record of type index, file offset of the first record of each second
+//   trailer: uint64 offset of the index record, "WIVRNIDX"
+// The index and trailer are missing if the recording was interrupted, the
+// file can still be read but seeking is slower.
+// Clock offsets are not stored separately, the timesync queries and
+// responses are recorded as any other packet.
+namespace session_recording
+{
+inline constexpr char magic[8] = {'W', 'I', 'V', 'R', 'N', 'R', 'E', 'C'};
+inline constexpr char index_magic[8] = {'W', 'I', 'V', 'R', 'N', 'I', 'D', 'X'};
+inline constexpr uint32_t format_version = 1;
+
+enum class record_type : uint8_t
+{
+	received, // to_headset::packets
+	sent,     // from_headset::packets
+	index,    // array of index_entry
+};
+
+struct header
+{
+	char magic[8];
+	uint32_t format_version;
+	uint32_t reserved;
+	uint64_t protocol_version;
+};
+
+struct record_header
+{
+	int64_t timestamp;
+	record_type type;
+	uint8_t padding[3];
+	uint32_t size;
+};
+
+struct index_entry
+{
+	int64_t timestamp;
+	uint64_t offset;
+};
+
+struct trailer
+{
+	uint64_t index_offset;
+	char magic[8];
+};
+} // namespace session_recording
+
+class session_recorder
+{
+	utils::async_writer writer;
+
+	std::mutex mutex;
+	std::vector<session_recording::index_entry> index;
+	serialization_packet packet;
+
+	void write(XrTime timestamp, session_recording::record_type type, serialization_packet & packet);
+
+public:
+	session_recorder(const std::filesystem::path & path);
+	// Writes the index
+	~session_recorder();
+
+	// Audio data is not recorded, it is not needed to analyse the video
+	// stream and would make the recordings much larger
+	void record(XrTime timestamp, const to_headset::packets & packet);
+	void record(XrTime timestamp, const from_headset::packets & packet);
+	// packet: already serialized to_headset::packets or from_headset::packets,
+	// as done by typed_socket::serialize
+	void record(XrTime timestamp, session_recording::record_type type, serialization_packet & packet);
+
+	// number of packets that were not recorded because the disk was too slow
+	uint64_t dropped_count()
+	{
+		return writer.dropped_count();
+	}
+};
+
+class session_reader
+{
+	std::ifstream file;
+	std::vector<session_recording::index_entry> index;
+	// offset of the index record, or of the end of the file
+	uint64_t end;
+
+public:
+	struct entry
+	{
+		XrTime timestamp;
+		std::variant<to_headset::packets, from_headset::packets> packet;
+	};
+
+	session_reader(const std::filesystem::path & path);
+
+	// return value: next packet, nullopt at the end of the recording
+	std::optional<entry> next();
+
+	// Moves to the first packet at or after timestamp
+	void seek(XrTime timestamp);
+
+	// timestamp of the first packet, nullopt if the recording is empty
+	std::optional<XrTime> start();
+};
+
+} // namespace wivrn
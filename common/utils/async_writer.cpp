@@ -0,0 +1,101 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "async_writer.h"
+
+#include "named_thread.h"
+
+#include <stdexcept>
+
+namespace utils
+{
+
+async_writer::async_writer(const std::filesystem::path & path, size_t max_pending) :
+        file(path, std::ios::binary | std::ios::trunc),
+        max_pending(max_pending)
+{
+	if (not file)
+		throw std::runtime_error("Failed to open " + path.string());
+
+	thread = named_thread("async_writer", &async_writer::run, this);
+}
+
+async_writer::~async_writer()
+{
+	close();
+}
+
+void async_writer::run()
+{
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		cv.wait(lock, [&]() { return closed or not queue.empty(); });
+		if (queue.empty())
+			break;
+
+		auto data = std::move(queue.front());
+		queue.pop_front();
+		lock.unlock();
+		file.write((const char *)data.data(), data.size());
+		lock.lock();
+		pending -= data.size();
+	}
+	file.close();
+}
+
+std::optional<uint64_t> async_writer::write(std::span<const uint8_t> data)
+{
+	return write(std::vector<uint8_t>(data.begin(), data.end()));
+}
+
+std::optional<uint64_t> async_writer::write(std::vector<uint8_t> && data)
+{
+	std::lock_guard lock(mutex);
+	if (closed or pending + data.size() > max_pending)
+	{
+		++dropped;
+		return std::nullopt;
+	}
+
+	uint64_t result = offset;
+	offset += data.size();
+	pending += data.size();
+	queue.push_back(std::move(data));
+	cv.notify_one();
+	return result;
+}
+
+void async_writer::close()
+{
+	{
+		std::lock_guard lock(mutex);
+		closed = true;
+		cv.notify_all();
+	}
+	if (thread.joinable())
+		thread.join();
+}
+
+uint64_t async_writer::dropped_count()
+{
+	std::lock_guard lock(mutex);
+	return dropped;
+}
+
+} // namespace utils
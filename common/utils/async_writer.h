@@ -0,0 +1,74 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+
+// Writes to a file from a background thread, so that callers on realtime
+// threads never wait for the disk.
+// When more than max_pending bytes are queued, new writes are dropped as a whole
+// instead of blocking, so that records in the file are never truncated.
+class async_writer
+{
+	std::ofstream file;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::vector<uint8_t>> queue;
+	size_t pending = 0;
+	const size_t max_pending;
+	// bytes accepted so far, offset of the next write in the file
+	uint64_t offset = 0;
+	uint64_t dropped = 0;
+	bool closed = false;
+
+	std::thread thread;
+
+	void run();
+
+public:
+	async_writer(const std::filesystem::path & path, size_t max_pending = 256 * 1024 * 1024);
+	async_writer(const async_writer &) = delete;
+	async_writer & operator=(const async_writer &) = delete;
+	~async_writer();
+
+	// return value: offset of the data in the file, nullopt if it was dropped
+	std::optional<uint64_t> write(std::span<const uint8_t> data);
+	std::optional<uint64_t> write(std::vector<uint8_t> && data);
+
+	// Writes all pending data and closes the file, further writes are dropped
+	void close();
+
+	// number of writes that were dropped because the queue was full
+	uint64_t dropped_count();
+};
+
+} // namespace utils
@@ -0,0 +1,87 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "quantile_sketch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace utils
+{
+
+quantile_sketch::quantile_sketch(double relative_accuracy, double min_value, double max_value, size_t window) :
+        gamma((1 + relative_accuracy) / (1 - relative_accuracy)),
+        log_gamma(std::log(gamma)),
+        min_value(min_value),
+        max_value(max_value),
+        half_window(std::max<size_t>(1, window / 2))
+{
+	assert(relative_accuracy > 0 and relative_accuracy < 1);
+	assert(min_value > 0 and max_value > min_value);
+	min_key = std::ceil(std::log(min_value) / log_gamma);
+	size_t num_buckets = key(max_value) + 1;
+	for (auto & b: buckets)
+		b.resize(num_buckets);
+}
+
+int32_t quantile_sketch::key(double value) const
+{
+	value = std::clamp(value, min_value, max_value);
+	return int32_t(std::ceil(std::log(value) / log_gamma)) - min_key;
+}
+
+void quantile_sketch::add(double value)
+{
+	if (counts[current] >= half_window)
+	{
+		current = 1 - current;
+		std::ranges::fill(buckets[current], 0);
+		counts[current] = 0;
+	}
+	++buckets[current][key(value)];
+	++counts[current];
+}
+
+double quantile_sketch::quantile(double q) const
+{
+	size_t n = size();
+	if (n == 0)
+		return 0;
+
+	size_t rank = std::clamp(q, 0., 1.) * (n - 1);
+	size_t cumulative = 0;
+	for (size_t i = 0, end = buckets[0].size(); i < end; ++i)
+	{
+		cumulative += buckets[0][i] + buckets[1][i];
+		if (cumulative > rank)
+			// Middle of the bucket, in the sense of relative error
+			return 2 * std::pow(gamma, int32_t(i) + min_key) / (gamma + 1);
+	}
+	return max_value;
+}
+
+void quantile_sketch::reset()
+{
+	for (auto & b: buckets)
+		std::ranges::fill(b, 0);
+	counts = {};
+	current = 0;
+}
+
+} // namespace utils
@@ -0,0 +1,68 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace utils
+{
+
+// Online quantile estimator with bounded relative error (DDSketch).
+// Values are counted in logarithmically spaced buckets, so that adding a sample
+// is O(1) and any quantile can be queried without sorting.
+// Only the most recent samples are considered: the window is split in two
+// halves, the oldest one is dropped when the newest is full.
+class quantile_sketch
+{
+	double gamma;
+	double log_gamma;
+	double min_value;
+	double max_value;
+	int32_t min_key;
+	size_t half_window;
+
+	std::array<std::vector<uint32_t>, 2> buckets;
+	std::array<size_t, 2> counts{};
+	int current = 0;
+
+	int32_t key(double value) const;
+
+public:
+	// relative_accuracy: maximum relative error of returned quantiles
+	// min_value, max_value: range of tracked values, samples outside are clamped
+	// window: number of samples to consider
+	quantile_sketch(double relative_accuracy, double min_value, double max_value, size_t window);
+
+	void add(double value);
+
+	// q in [0, 1], returns 0 if there are no samples
+	double quantile(double q) const;
+
+	size_t size() const
+	{
+		return counts[0] + counts[1];
+	}
+
+	void reset();
+};
+
+} // namespace utils
@@ -0,0 +1,121 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "named_thread.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+// Fixed set of threads executing short tasks, for work split in independent pieces
+class task_pool
+{
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::condition_variable idle_cv;
+	std::deque<std::function<void()>> tasks;
+	size_t active = 0;
+	bool stop = false;
+	std::exception_ptr error;
+	std::vector<std::thread> threads;
+
+	void run()
+	{
+		std::unique_lock lock(mutex);
+		while (true)
+		{
+			cv.wait(lock, [&]() { return stop or not tasks.empty(); });
+			if (stop)
+				return;
+			auto task = std::move(tasks.front());
+			tasks.pop_front();
+			++active;
+			lock.unlock();
+			try
+			{
+				task();
+			}
+			catch (...)
+			{
+				lock.lock();
+				if (not error)
+					error = std::current_exception();
+				lock.unlock();
+			}
+			lock.lock();
+			if (--active == 0 and tasks.empty())
+				idle_cv.notify_all();
+		}
+	}
+
+public:
+	task_pool(const std::string & name, unsigned int count)
+	{
+		for (unsigned int i = 0; i < std::max(count, 1u); ++i)
+			threads.push_back(named_thread(name + std::to_string(i), &task_pool::run, this));
+	}
+
+	task_pool(const task_pool &) = delete;
+	task_pool & operator=(const task_pool &) = delete;
+
+	~task_pool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stop = true;
+		}
+		cv.notify_all();
+		for (auto & t: threads)
+			t.join();
+	}
+
+	size_t size() const
+	{
+		return threads.size();
+	}
+
+	void push(std::function<void()> task)
+	{
+		{
+			std::lock_guard lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		cv.notify_one();
+	}
+
+	// Wait until all pushed tasks are executed, rethrows the first exception thrown by a task
+	void wait()
+	{
+		std::unique_lock lock(mutex);
+		idle_cv.wait(lock, [&]() { return tasks.empty() and active == 0; });
+		if (auto e = std::exchange(error, nullptr))
+			std::rethrow_exception(e);
+	}
+};
+} // namespace utils
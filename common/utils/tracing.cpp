@@ -0,0 +1,210 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "tracing.h"
+
+#include "async_writer.h"
+
+#include <array>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <unistd.h>
+
+namespace wivrn::tracing
+{
+std::atomic<bool> details::active = false;
+
+namespace
+{
+// Process id of the stream tracks
+const int streams_pid = 1;
+
+std::mutex mutex;
+std::unique_ptr<utils::async_writer> writer;
+int64_t offset;
+int pid;
+// Incremented for each trace, to write the thread names again
+std::atomic<uint32_t> generation = 0;
+
+// Stream tracks that have been named in the current trace
+std::array<std::atomic<bool>, 256> stream_tracks;
+
+thread_local uint32_t thread_generation = 0;
+thread_local int tid = 0;
+
+int64_t monotonic()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+}
+
+// Timestamps are in µs
+struct us
+{
+	int64_t ns;
+};
+
+void append(std::string & out, us t)
+{
+	char buffer[32];
+	auto sign = t.ns < 0 ? "-" : "";
+	uint64_t abs = t.ns < 0 ? -t.ns : t.ns;
+	snprintf(buffer, sizeof(buffer), "%s%llu.%03llu", sign, (unsigned long long)(abs / 1000), (unsigned long long)(abs % 1000));
+	out += buffer;
+}
+
+void append(std::string & out, const char * s)
+{
+	out += s;
+}
+
+void append(std::string & out, const std::string & s)
+{
+	out += s;
+}
+
+template <typename T>
+        requires std::is_arithmetic_v<T>
+void append(std::string & out, T value)
+{
+	out += std::to_string(value);
+}
+
+void write(std::string && event)
+{
+	std::lock_guard lock(mutex);
+	if (writer)
+		writer->write(std::vector<uint8_t>(event.begin(), event.end()));
+}
+
+template <typename... Args>
+void write_event(const Args &... args)
+{
+	std::string event;
+	event.reserve(192);
+	(append(event, args), ...);
+	event += "},\n";
+	write(std::move(event));
+}
+
+void thread_metadata()
+{
+	if (thread_generation == generation.load(std::memory_order_relaxed))
+		return;
+	thread_generation = generation;
+	tid = gettid();
+
+	char name[16] = "";
+	pthread_getname_np(pthread_self(), name, sizeof(name));
+	write_event(R"({"ph":"M","name":"thread_name","pid":)", pid, R"(,"tid":)", tid, R"(,"args":{"name":")", name, "\"}");
+}
+
+void flow_event(flow f, uint64_t id, int64_t timestamp, int p, int t)
+{
+	if (f == flow::none)
+		return;
+	write_event(R"({"ph":")",
+	            std::string(1, char(f)),
+	            R"(","name":"frame","cat":"frame","id":)",
+	            id,
+	            R"(,"ts":)",
+	            us{timestamp},
+	            R"(,"pid":)",
+	            p,
+	            R"(,"tid":)",
+	            t,
+	            f == flow::end ? R"(,"bp":"e")" : "");
+}
+} // namespace
+
+void start(const std::filesystem::path & path, const char * process_name, const char * streams_name, int64_t clock_offset)
+{
+	std::lock_guard lock(mutex);
+	if (writer)
+		return;
+
+	writer = std::make_unique<utils::async_writer>(path);
+	offset = clock_offset;
+	pid = getpid();
+	++generation;
+	for (auto & track: stream_tracks)
+		track = false;
+
+	// Array format, the closing bracket is optional so that the trace can
+	// be read even if the process did not exit cleanly
+	std::string header = "[\n";
+	header += R"({"ph":"M","name":"process_name","pid":)" + std::to_string(pid) + R"(,"args":{"name":")" + process_name + "\"}},\n";
+	header += R"({"ph":"M","name":"process_name","pid":)" + std::to_string(streams_pid) + R"(,"args":{"name":")" + streams_name + "\"}},\n";
+	writer->write(std::vector<uint8_t>(header.begin(), header.end()));
+
+	details::active = true;
+}
+
+void stop()
+{
+	details::active = false;
+
+	std::unique_ptr<utils::async_writer> w;
+	{
+		std::lock_guard lock(mutex);
+		w = std::move(writer);
+	}
+	// The destructor waits for the pending events
+}
+
+int64_t now()
+{
+	return monotonic() + offset;
+}
+
+void slice(const char * name, int64_t begin, int64_t end, flow f, uint64_t id)
+{
+	thread_metadata();
+	write_event(R"({"ph":"X","name":")", name, R"(","ts":)", us{begin}, R"(,"dur":)", us{end - begin}, R"(,"pid":)", pid, R"(,"tid":)", tid);
+	flow_event(f, id, begin, pid, tid);
+}
+
+void instant(const char * name, int64_t timestamp)
+{
+	thread_metadata();
+	write_event(R"({"ph":"i","s":"t","name":")", name, R"(","ts":)", us{timestamp}, R"(,"pid":)", pid, R"(,"tid":)", tid);
+}
+
+void counter(const char * name, double value, int64_t timestamp)
+{
+	write_event(R"({"ph":"C","name":")", name, R"(","ts":)", us{timestamp}, R"(,"pid":)", pid, R"(,"args":{"value":)", value, "}");
+}
+
+void stream_slice(const char * name, uint8_t stream, int64_t begin, int64_t end, flow f, uint64_t id)
+{
+	if (not stream_tracks[stream].exchange(true, std::memory_order_relaxed))
+		write_event(R"({"ph":"M","name":"thread_name","pid":)", streams_pid, R"(,"tid":)", int(stream), R"(,"args":{"name":"stream )", int(stream), "\"}");
+	write_event(R"({"ph":"X","name":")", name, R"(","ts":)", us{begin}, R"(,"dur":)", us{end - begin}, R"(,"pid":)", streams_pid, R"(,"tid":)", int(stream));
+	flow_event(f, id, begin, streams_pid, stream);
+}
+
+void clock_offset(int64_t offset)
+{
+	write_event(R"({"ph":"C","name":"headset_clock_offset","ts":)", us{now()}, R"(,"pid":)", pid, R"(,"args":{"offset":)", offset, "}");
+}
+} // namespace wivrn::tracing
@@ -0,0 +1,127 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_config.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+// Timeline of the activity of each thread, with the frames linked from the
+// encoder to the display. The trace is written in the JSON trace event format
+// which can be opened with https://ui.perfetto.dev or chrome://tracing.
+//
+// Tracing is compiled only if WIVRN_FEATURE_TRACING is set, otherwise the
+// WIVRN_TRACE_* macros expand to nothing and their arguments are not evaluated.
+namespace wivrn::tracing
+{
+namespace details
+{
+extern std::atomic<bool> active;
+}
+
+inline bool enabled()
+{
+	return details::active.load(std::memory_order_relaxed);
+}
+
+// streams_name: name of the group of stream tracks, see stream_slice
+// clock_offset: added to CLOCK_MONOTONIC to get the timestamps of the
+// process, such as XrTime on the headset
+void start(const std::filesystem::path & path, const char * process_name, const char * streams_name, int64_t clock_offset = 0);
+void stop();
+
+// Current time, in the same clock as the timestamps given to the tracing functions
+int64_t now();
+
+// Identifies the flow of a frame, from the encoder to the display
+inline uint64_t frame_id(uint8_t stream, uint64_t frame)
+{
+	return (frame << 8) | stream;
+}
+
+enum class flow : char
+{
+	none = 0,
+	begin = 's',
+	step = 't',
+	end = 'f',
+};
+
+// Names must be string literals
+void slice(const char * name, int64_t begin, int64_t end, flow f = flow::none, uint64_t id = 0);
+void instant(const char * name, int64_t timestamp);
+void counter(const char * name, double value, int64_t timestamp);
+
+// Slice on the track of a video stream instead of the current thread, for
+// spans of a frame that do not match the activity of a thread, or that are
+// reported by the headset
+void stream_slice(const char * name, uint8_t stream, int64_t begin, int64_t end, flow f = flow::none, uint64_t id = 0);
+
+// Headset time minus the time of this process, used to merge the traces of
+// the server and the headset with tools/merge_traces.py
+void clock_offset(int64_t offset);
+
+class scope
+{
+	const char * name;
+	int64_t begin;
+	flow f;
+	uint64_t id;
+
+public:
+	scope(const char * name, flow f = flow::none, uint64_t id = 0) :
+	        name(name), begin(enabled() ? now() : 0), f(f), id(id) {}
+	scope(const scope &) = delete;
+	scope & operator=(const scope &) = delete;
+	~scope()
+	{
+		if (begin)
+			slice(name, begin, now(), f, id);
+	}
+};
+} // namespace wivrn::tracing
+
+#if WIVRN_FEATURE_TRACING
+#define WIVRN_TRACE_CONCAT2(a, b) a##b
+#define WIVRN_TRACE_CONCAT(a, b) WIVRN_TRACE_CONCAT2(a, b)
+#define WIVRN_TRACE_SCOPE(...) ::wivrn::tracing::scope WIVRN_TRACE_CONCAT(wivrn_trace_scope_, __LINE__)(__VA_ARGS__)
+#define WIVRN_TRACE_CALL(function, ...)                          \
+	do                                                       \
+	{                                                        \
+		if (::wivrn::tracing::enabled())                 \
+			::wivrn::tracing::function(__VA_ARGS__); \
+	} while (0)
+#define WIVRN_TRACE_SLICE(...) WIVRN_TRACE_CALL(slice, __VA_ARGS__)
+#define WIVRN_TRACE_STREAM_SLICE(...) WIVRN_TRACE_CALL(stream_slice, __VA_ARGS__)
+#define WIVRN_TRACE_INSTANT(...) WIVRN_TRACE_CALL(instant, __VA_ARGS__)
+#define WIVRN_TRACE_COUNTER(...) WIVRN_TRACE_CALL(counter, __VA_ARGS__)
+#define WIVRN_TRACE_CLOCK_OFFSET(...) WIVRN_TRACE_CALL(clock_offset, __VA_ARGS__)
+#else
+#define WIVRN_TRACE_SCOPE(...) \
+	do                     \
+	{                      \
+	} while (0)
+#define WIVRN_TRACE_SLICE(...) WIVRN_TRACE_SCOPE()
+#define WIVRN_TRACE_STREAM_SLICE(...) WIVRN_TRACE_SCOPE()
+#define WIVRN_TRACE_INSTANT(...) WIVRN_TRACE_SCOPE()
+#define WIVRN_TRACE_COUNTER(...) WIVRN_TRACE_SCOPE()
+#define WIVRN_TRACE_CLOCK_OFFSET(...) WIVRN_TRACE_SCOPE()
+#endif
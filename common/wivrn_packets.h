@@ -38,7 +38,7 @@
 namespace wivrn
 {
 
-static constexpr int protocol_revision = 2;
+static constexpr int protocol_revision = 3;
 
 enum class device_id : uint8_t
 {
@@ -640,6 +640,17 @@ public:
 	data_holder data;
 };
 
+// Sent instead of video data when the frame is identical to a previous one,
+// the image of the source frame is displayed with the new view information
+struct video_stream_repeat
+{
+	uint8_t stream_item_idx;
+	uint64_t frame_idx;
+	uint64_t source_frame_idx;
+	video_stream_data_shard::view_info_t view_info;
+	video_stream_data_shard::timing_info_t timing_info;
+};
+
 struct haptics
 {
 	device_id id;
@@ -732,6 +743,7 @@ using packets = std::variant<
         refresh_rate_change,
         application_list,
         application_icon,
-        running_applications>;
+        running_applications,
+        video_stream_repeat>;
 } // namespace to_headset
 } // namespace wivrn
@@ -20,6 +20,7 @@
 #include "wivrn_sockets.h"
 
 #include "crypto.h"
+#include "net_emulator.h"
 #include <algorithm>
 #include <arpa/inet.h>
 #include <cassert>
@@ -63,7 +64,11 @@ wivrn::fd_base & wivrn::fd_base::operator=(wivrn::fd_base && other)
 wivrn::fd_base::~fd_base()
 {
 	if (fd >= 0)
+	{
+		if (auto emulator = net_emulator::instance())
+			emulator->forget(fd);
 		::close(fd);
+	}
 }
 
 wivrn::UDP::UDP()
@@ -94,6 +99,8 @@ void wivrn::UDP::connect(in6_addr address, int port)
 
 	if (::connect(fd, (sockaddr *)&sa, sizeof(sa)) < 0)
 		throw std::system_error{errno, std::generic_category()};
+
+	emulator = net_emulator::instance();
 }
 
 void wivrn::UDP::connect(in_addr address, int port)
@@ -105,6 +112,8 @@ void wivrn::UDP::connect(in_addr address, int port)
 
 	if (::connect(fd, (sockaddr *)&sa, sizeof(sa)) < 0)
 		throw std::system_error{errno, std::generic_category()};
+
+	emulator = net_emulator::instance();
 }
 
 void wivrn::UDP::subscribe_multicast(in6_addr address)
@@ -164,6 +173,7 @@ void wivrn::TCP::init()
 	}
 
 	mutex = std::make_unique<std::mutex>();
+	emulator = net_emulator::instance();
 }
 
 wivrn::TCP::TCP(int fd)
@@ -351,6 +361,9 @@ wivrn::deserialization_packet wivrn::UDP::receive_raw()
 		std::span<uint8_t> message{(uint8_t *)iovecs[i].iov_base, mmsgs[i].msg_len};
 		assert(message.data() != nullptr);
 
+		if (emulator and not emulator->keep_received(fd))
+			continue;
+
 		if (encrypted)
 		{
 			// Not big enough for the IV: drop the packet
@@ -367,13 +380,15 @@ wivrn::deserialization_packet wivrn::UDP::receive_raw()
 			decrypter.decrypt_in_place(message);
 		}
 
-		if (i == 0)
-			return deserialization_packet{buffer, message};
-
 		messages.push_back(message);
 	}
 
-	__builtin_unreachable();
+	if (messages.empty())
+		return {};
+
+	auto span = messages.back();
+	messages.pop_back();
+	return deserialization_packet{buffer, span};
 }
 
 void wivrn::UDP::send_raw(serialization_packet && packet)
@@ -404,6 +419,12 @@ void wivrn::UDP::send_raw(serialization_packet && packet)
 		bytes_sent_ += span.size();
 	}
 
+	if (emulator)
+	{
+		emulator->send_datagram(fd, iovecs);
+		return;
+	}
+
 	if (::writev(fd, iovecs.data(), iovecs.size()) < 0)
 		throw std::system_error{errno, std::generic_category()};
 }
@@ -459,6 +480,13 @@ void wivrn::UDP::send_many_raw(std::span<serialization_packet> packets)
 		j += mmsgs[i].msg_hdr.msg_iovlen;
 	}
 
+	if (emulator)
+	{
+		for (const auto & mmsg: mmsgs)
+			emulator->send_datagram(fd, {mmsg.msg_hdr.msg_iov, mmsg.msg_hdr.msg_iovlen});
+		return;
+	}
+
 	// sendmmsg may not send all messages, just consider them as lost for UDP
 	if (sendmmsg(fd, mmsgs.data(), mmsgs.size(), 0) < 0)
 		throw std::system_error{errno, std::generic_category()};
@@ -579,6 +607,13 @@ void wivrn::TCP::send_raw(serialization_packet && packet)
 		encrypter.encrypt_in_place(data);
 	}
 
+	if (emulator)
+	{
+		emulator->send_stream(fd, iovecs);
+		bytes_sent_ += sizeof(size) + size;
+		return;
+	}
+
 	while (true)
 	{
 		ssize_t sent = ::sendmsg(fd, &hdr, MSG_NOSIGNAL);
@@ -652,6 +687,14 @@ void wivrn::TCP::send_many_raw(std::span<serialization_packet> packets)
 		encrypter.encrypt_in_place(spans);
 	}
 
+	if (emulator)
+	{
+		emulator->send_stream(fd, iovecs);
+		for (const auto & span: spans)
+			bytes_sent_ += span.size();
+		return;
+	}
+
 	while (true)
 	{
 		ssize_t sent = ::sendmsg(fd, &hdr, MSG_NOSIGNAL);
@@ -62,6 +62,8 @@ struct index_of_type<T, T2, Ts...> : std::integral_constant<size_t, 1 + index_of
 static_assert(index_of_type<int, int, float>::value == 0);
 static_assert(index_of_type<float, int, float>::value == 1);
 
+class net_emulator;
+
 class fd_base
 {
 protected:
@@ -110,6 +112,9 @@ class UDP : public fd_base
 	static std::atomic<uint64_t> iv_counter;
 	static_assert(sizeof(iv_counter) == 8);
 
+	// Only set for network sockets when WIVRN_NETEM is set
+	net_emulator * emulator = nullptr;
+
 	bool encrypted = false;
 	std::array<uint8_t, 16> key;
 	std::array<uint8_t, 16 - sizeof(iv_counter)> recv_iv_header;
@@ -149,6 +154,9 @@ class TCP : public fd_base
 	crypto::decrypt_context decrypter;
 	crypto::encrypt_context encrypter;
 
+	// Only set when WIVRN_NETEM is set
+	net_emulator * emulator = nullptr;
+
 public:
 	TCP() = default;
 	TCP(in6_addr address, int port);
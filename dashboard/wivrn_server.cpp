@@ -66,6 +66,9 @@ static bool has_cap_sys_nice()
 wivrn_server::wivrn_server(QObject * parent) :
         QObject(parent)
 {
+	// Type of the Statistics property
+	qDBusRegisterMetaType<QMap<QString, double>>();
+
 	dbus_watcher.setConnection(QDBusConnection::sessionBus());
 	dbus_watcher.addWatchedService("io.github.wivrn.Server");
 
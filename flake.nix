@@ -62,6 +62,11 @@
             };
           };
 
+          # lz4 is fetched by CMake, the build is offline
+          cmakeFlags = oldAttrs.cmakeFlags ++ [
+            (lib.cmakeFeature "FETCHCONTENT_SOURCE_DIR_LZ4" "${pkgs.lz4.src}")
+          ];
+
           buildInputs = oldAttrs.buildInputs ++ extraBuildInputs;
           nativeBuildInputs = oldAttrs.nativeBuildInputs ++ extraNativeBuildInputs;
         }));
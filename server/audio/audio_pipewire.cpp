@@ -22,6 +22,7 @@
 #include "os/os_time.h"
 #include "util/u_logging.h"
 #include "utils/ring_buffer.h"
+#include "utils/thread_profile.h"
 #include <magic_enum.hpp>
 #include <memory>
 #include <pipewire/pipewire.h>
@@ -195,6 +196,8 @@ struct pipewire_device : public audio_device
 		if (desc.speaker or desc.microphone)
 			thread = std::jthread(
 			        [this](std::stop_token) {
+				pthread_setname_np(pthread_self(), "pipewire audio");
+				apply_thread_profile(thread_role::audio);
 				pw_main_loop_run(pw_loop.get());
 				speaker.reset();
 				microphone.reset();
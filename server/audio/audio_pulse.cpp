@@ -5,6 +5,7 @@
 #include "os/os_time.h"
 #include "util/u_logging.h"
 #include "utils/sync_queue.h"
+#include "utils/thread_profile.h"
 #include "utils/wrap_lambda.h"
 
 #include <pulse/context.h>
@@ -294,6 +295,7 @@ struct pulse_device : public audio_device
 	{
 		assert(desc.speaker);
 		pthread_setname_np(pthread_self(), "speaker_thread");
+		apply_thread_profile(thread_role::audio);
 
 		U_LOG_I("started speaker thread, sample rate %dHz, %d channels", desc.speaker->sample_rate, desc.speaker->num_channels);
 
@@ -365,6 +367,7 @@ struct pulse_device : public audio_device
 	{
 		assert(desc.microphone);
 		pthread_setname_np(pthread_self(), "mic_thread");
+		apply_thread_profile(thread_role::audio);
 
 		const size_t sample_size = desc.microphone->num_channels * sizeof(int16_t);
 		try
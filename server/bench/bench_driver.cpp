@@ -0,0 +1,115 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "driver/clock_offset.h"
+#include "driver/pose_list.h"
+#include "driver/wivrn_pacer.h"
+#include "os/os_time.h"
+
+#include <benchmark/benchmark.h>
+#include <memory>
+
+using namespace wivrn;
+
+namespace
+{
+const clock_offset offset{.b = 0, .stable = true};
+
+from_headset::tracking make_tracking(XrTime t)
+{
+	from_headset::tracking tracking{
+	        .production_timestamp = t,
+	        .timestamp = t,
+	};
+	tracking.device_poses.push_back({
+	        .pose = {
+	                .orientation = {0, 0, 0, 1},
+	                .position = {0, 1.6, 0},
+	        },
+	        .device = device_id::HEAD,
+	        .flags = from_headset::tracking::orientation_valid | from_headset::tracking::position_valid,
+	});
+	return tracking;
+}
+
+std::unique_ptr<pose_list> poses;
+
+// Readers query the pose in the middle of the history, as the compositor does.
+// With state.range(0), thread 0 also receives a new sample per iteration.
+void BM_history_get_at(benchmark::State & state)
+{
+	const XrTime period = 2'000'000;
+	XrTime t = os_monotonic_get_ns();
+	if (state.thread_index() == 0)
+	{
+		poses = std::make_unique<pose_list>(device_id::HEAD);
+		for (int i = 0; i < 10; ++i)
+			poses->update_tracking(make_tracking(t + i * period), offset);
+	}
+
+	bool writer = state.range(0) and state.thread_index() == 0;
+	for (auto _: state)
+	{
+		if (writer)
+		{
+			t += period;
+			poses->update_tracking(make_tracking(t), offset);
+		}
+		else
+			benchmark::DoNotOptimize(poses->get_at(t + 5 * period + period / 2));
+	}
+
+	if (state.thread_index() == 0)
+		poses.reset();
+}
+
+void BM_clock_offset_add_sample(benchmark::State & state)
+{
+	clock_offset_estimator estimator;
+	const XrTime headset_offset = 5'000'000'000;
+
+	// Fill the samples so that each iteration runs the regression
+	for (int i = 0; i < 100; ++i)
+	{
+		XrTime now = os_monotonic_get_ns();
+		estimator.add_sample({.query = now - 1'000'000, .response = now - 500'000 + headset_offset});
+	}
+
+	for (auto _: state)
+	{
+		XrTime now = os_monotonic_get_ns();
+		estimator.add_sample({.query = now - 1'000'000, .response = now - 500'000 + headset_offset});
+	}
+	benchmark::DoNotOptimize(estimator.get_offset());
+}
+
+void BM_pacer_predict(benchmark::State & state)
+{
+	wivrn_pacer pacer(U_TIME_1S_IN_NS / 90);
+	for (auto _: state)
+	{
+		int64_t frame_id, wake_up_time, desired_present_time, present_slop, predicted_display_time;
+		pacer.predict(frame_id, wake_up_time, desired_present_time, present_slop, predicted_display_time);
+		benchmark::DoNotOptimize(predicted_display_time);
+	}
+}
+} // namespace
+
+BENCHMARK(BM_history_get_at)->ArgName("writer")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_clock_offset_add_sample);
+BENCHMARK(BM_pacer_predict);
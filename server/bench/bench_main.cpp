@@ -0,0 +1,41 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+int main(int argc, char ** argv)
+{
+	// Default to JSON so that results can be compared between releases
+	std::vector<char *> args(argv, argv + argc);
+	char json_format[] = "--benchmark_format=json";
+	if (std::ranges::none_of(args, [](std::string_view arg) { return arg.starts_with("--benchmark_format"); }))
+		args.push_back(json_format);
+
+	int args_count = args.size();
+	benchmark::Initialize(&args_count, args.data());
+	if (benchmark::ReportUnrecognizedArguments(args_count, args.data()))
+		return 1;
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
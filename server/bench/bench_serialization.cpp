@@ -0,0 +1,116 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "packets.h"
+#include "wivrn_serialization.h"
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+
+using namespace wivrn;
+
+namespace
+{
+// Copy the serialized spans to a single buffer, as received from the network
+deserialization_packet to_received(serialization_packet & packet)
+{
+	std::vector<std::span<uint8_t>> & spans = packet;
+	size_t size = 0;
+	for (const auto & span: spans)
+		size += span.size();
+
+	std::shared_ptr<uint8_t[]> memory(new uint8_t[size]);
+	size_t offset = 0;
+	for (const auto & span: spans)
+	{
+		memcpy(memory.get() + offset, span.data(), span.size());
+		offset += span.size();
+	}
+	return deserialization_packet(memory, {memory.get(), size});
+}
+
+template <typename T>
+void bench_serialize(benchmark::State & state, const T & value)
+{
+	serialization_packet packet;
+	size_t bytes = 0;
+	for (auto _: state)
+	{
+		packet.clear();
+		packet.serialize(value);
+		std::vector<std::span<uint8_t>> & spans = packet;
+		benchmark::DoNotOptimize(spans.data());
+		for (const auto & span: spans)
+			bytes += span.size();
+	}
+	state.SetBytesProcessed(bytes);
+}
+
+template <typename T>
+void bench_deserialize(benchmark::State & state, const T & value)
+{
+	serialization_packet packet;
+	packet.serialize(value);
+	auto received = to_received(packet);
+	for (auto _: state)
+	{
+		auto copy = received;
+		benchmark::DoNotOptimize(copy.deserialize<T>());
+	}
+	state.SetBytesProcessed(state.iterations() * received.initial_buffer.size());
+}
+
+void BM_serialize_shard(benchmark::State & state)
+{
+	std::vector<uint8_t> payload;
+	bench_serialize(state, bench::make_shard(payload));
+}
+
+void BM_deserialize_shard(benchmark::State & state)
+{
+	std::vector<uint8_t> payload;
+	bench_deserialize(state, bench::make_shard(payload));
+}
+
+void BM_serialize_trackings(benchmark::State & state)
+{
+	bench_serialize(state, bench::make_trackings(state.range(0)));
+}
+
+void BM_deserialize_trackings(benchmark::State & state)
+{
+	bench_deserialize(state, bench::make_trackings(state.range(0)));
+}
+
+void BM_serialize_feedback(benchmark::State & state)
+{
+	bench_serialize(state, bench::make_feedback());
+}
+
+void BM_deserialize_feedback(benchmark::State & state)
+{
+	bench_deserialize(state, bench::make_feedback());
+}
+} // namespace
+
+BENCHMARK(BM_serialize_shard);
+BENCHMARK(BM_deserialize_shard);
+BENCHMARK(BM_serialize_trackings)->Arg(1)->Arg(4);
+BENCHMARK(BM_deserialize_trackings)->Arg(1)->Arg(4);
+BENCHMARK(BM_serialize_feedback);
+BENCHMARK(BM_deserialize_feedback);
@@ -0,0 +1,132 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "packets.h"
+#include "wivrn_sockets.h"
+
+#include <arpa/inet.h>
+#include <benchmark/benchmark.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+
+using namespace wivrn;
+
+namespace
+{
+template <typename Socket>
+using socket_t = typed_socket<Socket, to_headset::packets, to_headset::packets>;
+
+int local_port(const fd_base & socket)
+{
+	sockaddr_in6 address;
+	socklen_t len = sizeof(address);
+	if (getsockname(socket.get_fd(), (sockaddr *)&address, &len) < 0)
+		throw std::system_error(errno, std::system_category(), "getsockname");
+	return ntohs(address.sin6_port);
+}
+
+void wait_readable(const fd_base & socket)
+{
+	pollfd fd{.fd = socket.get_fd(), .events = POLLIN};
+	if (poll(&fd, 1, 1000) <= 0)
+		throw std::runtime_error("no packet received");
+}
+
+template <size_t N>
+std::array<uint8_t, N> random_bytes(std::mt19937 & gen)
+{
+	std::array<uint8_t, N> result;
+	std::uniform_int_distribution<int> dist(0, 255);
+	for (auto & i: result)
+		i = dist(gen);
+	return result;
+}
+
+template <typename Socket>
+void transfer(benchmark::State & state, socket_t<Socket> & sender, socket_t<Socket> & receiver)
+{
+	std::vector<uint8_t> payload;
+	auto shard = bench::make_shard(payload);
+
+	for (auto _: state)
+	{
+		sender.send(to_headset::video_stream_data_shard{shard});
+
+		std::optional<to_headset::packets> packet;
+		while (not packet)
+		{
+			packet = receiver.receive_pending();
+			if (packet)
+				break;
+			wait_readable(receiver);
+			packet = receiver.receive();
+		}
+		benchmark::DoNotOptimize(packet);
+	}
+	state.SetBytesProcessed(receiver.bytes_received());
+}
+
+void BM_udp_loopback(benchmark::State & state)
+{
+	socket_t<UDP> receiver;
+	receiver.bind({
+	        .sin6_family = AF_INET6,
+	        .sin6_addr = in6addr_loopback,
+	});
+	receiver.set_receive_buffer_size(1024 * 1024);
+
+	socket_t<UDP> sender;
+	sender.connect(in6addr_loopback, local_port(receiver));
+
+	if (state.range(0))
+	{
+		std::mt19937 gen;
+		auto key = random_bytes<16>(gen);
+		auto iv_a = random_bytes<8>(gen);
+		auto iv_b = random_bytes<8>(gen);
+		sender.set_aes_key_and_ivs(key, iv_a, iv_b);
+		receiver.set_aes_key_and_ivs(key, iv_b, iv_a);
+	}
+
+	transfer(state, sender, receiver);
+}
+
+void BM_tcp_loopback(benchmark::State & state)
+{
+	TCPListener listener(0);
+	socket_t<TCP> sender(in6addr_loopback, local_port(listener));
+	socket_t<TCP> receiver = listener.accept<socket_t<TCP>>().first;
+
+	if (state.range(0))
+	{
+		std::mt19937 gen;
+		auto key = random_bytes<16>(gen);
+		auto iv_a = random_bytes<16>(gen);
+		auto iv_b = random_bytes<16>(gen);
+		sender.set_aes_key_and_ivs(key, iv_a, iv_b);
+		receiver.set_aes_key_and_ivs(key, iv_b, iv_a);
+	}
+
+	transfer(state, sender, receiver);
+}
+} // namespace
+
+BENCHMARK(BM_udp_loopback)->ArgName("encrypted")->Arg(0)->Arg(1);
+BENCHMARK(BM_tcp_loopback)->ArgName("encrypted")->Arg(0)->Arg(1);
@@ -0,0 +1,728 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "driver/configuration.h"
+#include "driver/frame_generator.h"
+#include "driver/wivrn_comp_target.h"
+#include "encoder/encoder_settings.h"
+#include "encoder/video_encoder.h"
+#include "reference_decoder.h"
+#include "util/comp_vulkan.h"
+#include "util/u_logging.h"
+#include "util/u_string_list.h"
+#include "utils/wivrn_vk_bundle.h"
+#include "video_quality.h"
+#include "vk/allocation.h"
+#include "vk/vk_helpers.h"
+#include "wivrn_config.h"
+
+#include <CLI/CLI.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <magic_enum.hpp>
+#include <nlohmann/json.hpp>
+#include <thread>
+
+using namespace wivrn;
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+double to_ms(clock::duration d)
+{
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+struct options
+{
+	std::string encoder = encoder_x264;
+	video_codec codec = video_codec::h264;
+	uint32_t width = 3664;
+	uint32_t height = 1920;
+	float fps = 90;
+	int frames = 900;
+	double bitrate = 50; // Mbit/s
+	int bit_depth = 8;
+	int stripes = 1;
+	int idr_interval = 0;
+	std::map<std::string, std::string> encoder_options;
+	std::string device;
+	configuration::frame_generator source{.pattern = configuration::frame_generator::pattern_t::gradient};
+	bool quality = true;
+	bool pacing = true;
+	std::string csv;
+	std::string json;
+};
+
+struct frame_result
+{
+	uint64_t index;
+	bool idr;
+	size_t bytes = 0;
+	double present_ms;
+	double encode_ms;
+	double first_slice_ms;
+	std::optional<std::array<double, 3>> psnr;
+	std::optional<double> ssim;
+};
+
+// Vulkan device created the same way as the compositor does
+class vulkan
+{
+	vk_bundle vk{};
+
+public:
+	std::optional<wivrn_vk_bundle> bundle;
+
+	vulkan()
+	{
+		auto & instance_ext = wivrn_comp_target::wanted_instance_extensions;
+		auto & device_ext = wivrn_comp_target::wanted_device_extensions;
+
+		u_string_list * required_instance = u_string_list_create_from_array(instance_ext.data(), instance_ext.size());
+		u_string_list * optional_instance = u_string_list_create();
+		u_string_list * required_device = u_string_list_create();
+		u_string_list * optional_device = u_string_list_create_from_array(device_ext.data(), device_ext.size());
+
+		comp_vulkan_arguments args{};
+		args.required_instance_version = VK_MAKE_VERSION(1, 3, 0);
+		args.get_instance_proc_address = vkGetInstanceProcAddr;
+		args.required_instance_extensions = required_instance;
+		args.optional_instance_extensions = optional_instance;
+		args.required_device_extensions = required_device;
+		args.optional_device_extensions = optional_device;
+		args.log_level = U_LOGGING_WARN;
+		args.selected_gpu_index = -1;
+		args.client_gpu_index = -1;
+
+		comp_vulkan_results results{};
+		bool ok = comp_vulkan_init_bundle(&vk, &args, &results);
+
+		u_string_list_destroy(&required_instance);
+		u_string_list_destroy(&optional_instance);
+		u_string_list_destroy(&required_device);
+		u_string_list_destroy(&optional_device);
+
+		if (not ok)
+			throw std::runtime_error("failed to initialize Vulkan");
+
+		bundle.emplace(vk, instance_ext, device_ext);
+	}
+
+	~vulkan()
+	{
+		bundle.reset();
+		vk.vkDestroyDevice(vk.device, nullptr);
+		vk.vkDestroyInstance(vk.instance, nullptr);
+		vk_deinit_mutex(&vk);
+	}
+};
+
+uint16_t align(uint32_t value, uint32_t alignment)
+{
+	return ((value + alignment - 1) / alignment) * alignment;
+}
+
+// Horizontal stripes encoded concurrently, as the server does for software encoders
+std::vector<encoder_settings> make_settings(const options & opts)
+{
+	std::vector<encoder_settings> res;
+	for (int i = 0; i < opts.stripes; ++i)
+	{
+		encoder_settings settings{};
+		settings.channels = to_headset::video_stream_description::channels_t::colour;
+		settings.subsampling = 1;
+		settings.encoder_name = opts.encoder;
+		settings.offset_x = 0;
+		settings.offset_y = align(opts.height * i / opts.stripes, 32);
+		settings.width = opts.width;
+		settings.height = std::min<uint32_t>(align(opts.height * (i + 1) / opts.stripes, 32), opts.height) - settings.offset_y;
+		settings.video_width = settings.width;
+		settings.video_height = settings.height;
+		settings.codec = opts.codec;
+		settings.bit_depth = opts.bit_depth;
+		settings.group = i;
+		settings.options = opts.encoder_options;
+		if (not opts.device.empty())
+			settings.device = opts.device;
+		settings.bitrate_multiplier = double(settings.height) / opts.height;
+		settings.bitrate = opts.bitrate * 1'000'000 * settings.bitrate_multiplier;
+		if (opts.stripes > 1)
+			settings.threads = std::max<int>(1, std::thread::hardware_concurrency() / opts.stripes);
+		res.push_back(settings);
+	}
+	return res;
+}
+
+image_allocation make_image(wivrn_vk_bundle & vk, const options & opts, vk::Format format)
+{
+	bool is_10bit = format == vk::Format::eG10X6B10X6R10X62Plane420Unorm3Pack16;
+	std::array formats = {
+	        is_10bit ? vk::Format::eR10X6UnormPack16 : vk::Format::eR8Unorm,
+	        is_10bit ? vk::Format::eR10X6G10X6Unorm2Pack16 : vk::Format::eR8G8Unorm,
+	        format};
+
+	vk::StructureChain image_info{
+	        vk::ImageCreateInfo{
+	                .flags = vk::ImageCreateFlagBits::eExtendedUsage | vk::ImageCreateFlagBits::eMutableFormat,
+	                .imageType = vk::ImageType::e2D,
+	                .format = format,
+	                .extent = {
+	                        .width = opts.width,
+	                        .height = opts.height,
+	                        .depth = 1,
+	                },
+	                .mipLevels = 1,
+	                .arrayLayers = 2, // colour then alpha
+	                .samples = vk::SampleCountFlagBits::e1,
+	                .tiling = vk::ImageTiling::eOptimal,
+	                .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage |
+	                         vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+	                .sharingMode = vk::SharingMode::eExclusive,
+	        },
+	        vk::ImageFormatListCreateInfo{
+	                .viewFormatCount = formats.size(),
+	                .pViewFormats = formats.data(),
+	        },
+	};
+#if WIVRN_USE_VULKAN_ENCODE
+	if (vk.vk.features.video_maintenance_1 and opts.encoder == encoder_vulkan)
+	{
+		image_info.get().flags |= vk::ImageCreateFlagBits::eVideoProfileIndependentKHR;
+		image_info.get().usage |= vk::ImageUsageFlagBits::eVideoEncodeSrcKHR;
+	}
+#endif
+
+	return image_allocation(
+	        vk.device,
+	        image_info.get(),
+	        {.usage = VMA_MEMORY_USAGE_AUTO},
+	        "encoder bench image");
+}
+
+double percentile(std::vector<double> values, double q)
+{
+	if (values.empty())
+		return 0;
+	std::ranges::sort(values);
+	return values[std::min<size_t>(values.size() - 1, q * values.size())];
+}
+
+template <typename F>
+std::vector<double> collect(const std::vector<frame_result> & frames, F && f)
+{
+	std::vector<double> res;
+	for (const auto & frame: frames)
+		if (auto value = f(frame))
+			res.push_back(*value);
+	return res;
+}
+
+double mean(const std::vector<double> & values)
+{
+	if (values.empty())
+		return 0;
+	double sum = 0;
+	for (double v: values)
+		sum += v;
+	return sum / values.size();
+}
+
+// JSON does not support infinite values
+nlohmann::json db(double value)
+{
+	if (std::isfinite(value))
+		return value;
+	return nullptr;
+}
+
+void write_csv(std::ostream & out, const std::vector<frame_result> & frames)
+{
+	out << "frame,idr,bytes,present_ms,encode_ms,first_slice_ms,psnr_y,psnr_cb,psnr_cr,ssim_y\n";
+	for (const auto & frame: frames)
+	{
+		out << std::format("{},{},{},{:.3f},{:.3f},{:.3f}", frame.index, int(frame.idr), frame.bytes, frame.present_ms, frame.encode_ms, frame.first_slice_ms);
+		if (frame.psnr)
+			out << std::format(",{:.3f},{:.3f},{:.3f},{:.5f}", (*frame.psnr)[0], (*frame.psnr)[1], (*frame.psnr)[2], *frame.ssim);
+		else
+			out << ",,,,";
+		out << "\n";
+	}
+}
+
+nlohmann::json make_json(const options & opts, const std::vector<frame_result> & frames)
+{
+	auto sizes = collect(frames, [](const frame_result & f) { return std::optional<double>(f.bytes); });
+	auto encode = collect(frames, [](const frame_result & f) { return std::optional<double>(f.encode_ms); });
+	auto first_slice = collect(frames, [](const frame_result & f) { return std::optional<double>(f.first_slice_ms); });
+	auto present = collect(frames, [](const frame_result & f) { return std::optional<double>(f.present_ms); });
+	auto idr_sizes = collect(frames, [](const frame_result & f) { return f.idr ? std::optional<double>(f.bytes) : std::nullopt; });
+	auto ssim = collect(frames, [](const frame_result & f) { return f.ssim; });
+
+	auto distribution = [](const std::vector<double> & values) {
+		return nlohmann::json{
+		        {"mean", mean(values)},
+		        {"p50", percentile(values, 0.5)},
+		        {"p95", percentile(values, 0.95)},
+		        {"p99", percentile(values, 0.99)},
+		        {"max", percentile(values, 1)},
+		};
+	};
+
+	nlohmann::json summary{
+	        {"frames", frames.size()},
+	        {"bitrate_mbps", mean(sizes) * 8 * opts.fps / 1'000'000},
+	        {"size_bytes", distribution(sizes)},
+	        {"idr_size_bytes", mean(idr_sizes)},
+	        {"present_ms", distribution(present)},
+	        {"encode_ms", distribution(encode)},
+	        {"first_slice_ms", distribution(first_slice)},
+	};
+
+	if (not ssim.empty())
+	{
+		std::array<double, 3> psnr{};
+		for (int i = 0; i < 3; ++i)
+			psnr[i] = mean(collect(frames, [i](const frame_result & f) {
+				return f.psnr and std::isfinite((*f.psnr)[i]) ? std::optional((*f.psnr)[i]) : std::nullopt;
+			}));
+		summary["psnr_y"] = psnr[0];
+		summary["psnr_cb"] = psnr[1];
+		summary["psnr_cr"] = psnr[2];
+		summary["ssim_y"] = mean(ssim);
+	}
+
+	nlohmann::json json{
+	        {"settings",
+	         {
+	                 {"encoder", opts.encoder},
+	                 {"codec", magic_enum::enum_name(opts.codec)},
+	                 {"width", opts.width},
+	                 {"height", opts.height},
+	                 {"fps", opts.fps},
+	                 {"bitrate_mbps", opts.bitrate},
+	                 {"bit_depth", opts.bit_depth},
+	                 {"stripes", opts.stripes},
+	                 {"idr_interval", opts.idr_interval},
+	                 {"options", opts.encoder_options},
+	                 {"source", opts.source.pattern == configuration::frame_generator::pattern_t::replay ? opts.source.file.string() : std::string(magic_enum::enum_name(opts.source.pattern))},
+	         }},
+	        {"summary", summary},
+	};
+
+	auto & list = json["frames"] = nlohmann::json::array();
+	for (const auto & frame: frames)
+	{
+		nlohmann::json item{
+		        {"frame", frame.index},
+		        {"idr", frame.idr},
+		        {"bytes", frame.bytes},
+		        {"present_ms", frame.present_ms},
+		        {"encode_ms", frame.encode_ms},
+		        {"first_slice_ms", frame.first_slice_ms},
+		};
+		if (frame.psnr)
+		{
+			item["psnr_y"] = db((*frame.psnr)[0]);
+			item["psnr_cb"] = db((*frame.psnr)[1]);
+			item["psnr_cr"] = db((*frame.psnr)[2]);
+			item["ssim_y"] = *frame.ssim;
+		}
+		list.push_back(item);
+	}
+	return json;
+}
+
+void print_summary(const nlohmann::json & json)
+{
+	const auto & s = json["summary"];
+	auto line = [](const char * name, const nlohmann::json & d, const char * unit) {
+		std::cout << std::format("{:<16}mean {:8.2f}  p50 {:8.2f}  p95 {:8.2f}  p99 {:8.2f}  max {:8.2f} {}\n",
+		                         name,
+		                         d["mean"].get<double>(),
+		                         d["p50"].get<double>(),
+		                         d["p95"].get<double>(),
+		                         d["p99"].get<double>(),
+		                         d["max"].get<double>(),
+		                         unit);
+	};
+	std::cout << std::format("{} frames, {:.2f} Mbit/s\n", s["frames"].get<size_t>(), s["bitrate_mbps"].get<double>());
+	line("present", s["present_ms"], "ms");
+	line("encode", s["encode_ms"], "ms");
+	line("first slice", s["first_slice_ms"], "ms");
+	line("size", s["size_bytes"], "bytes");
+	if (s.contains("ssim_y"))
+		std::cout << std::format("PSNR Y {:.2f} dB, Cb {:.2f} dB, Cr {:.2f} dB, SSIM Y {:.5f}\n",
+		                         s["psnr_y"].get<double>(),
+		                         s["psnr_cb"].get<double>(),
+		                         s["psnr_cr"].get<double>(),
+		                         s["ssim_y"].get<double>());
+}
+
+std::vector<frame_result> run(const options & opts)
+{
+	vulkan vk;
+	auto & bundle = *vk.bundle;
+	auto & device = bundle.device;
+
+	auto format = opts.bit_depth == 10 ? vk::Format::eG10X6B10X6R10X62Plane420Unorm3Pack16 : vk::Format::eG8B8R82Plane420Unorm;
+	const uint32_t bytes = opts.bit_depth == 10 ? 2 : 1;
+	const uint32_t max_value = opts.bit_depth == 10 ? 1023 : 255;
+
+	auto settings = make_settings(opts);
+	std::vector<std::unique_ptr<video_encoder>> encoders;
+	for (auto & item: settings)
+		encoders.push_back(video_encoder::create(bundle, item, encoders.size(), opts.width, opts.height, opts.fps));
+	print_encoders(settings);
+
+	std::vector<std::optional<bench::reference_decoder>> decoders(settings.size());
+	if (opts.quality and opts.codec != video_codec::raw)
+	{
+		for (auto & decoder: decoders)
+			decoder.emplace(opts.codec);
+	}
+
+	auto image = make_image(bundle, opts, format);
+	frame_generator generator(bundle, opts.source, opts.width, opts.height, format, 1);
+
+	// Copy of the source image, to compare with the decoded frames
+	const vk::DeviceSize luma_size = vk::DeviceSize(opts.width) * opts.height * bytes;
+	buffer_allocation reference(
+	        device,
+	        {
+	                .size = luma_size * 3 / 2,
+	                .usage = vk::BufferUsageFlagBits::eTransferDst,
+	        },
+	        {
+	                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+	                .usage = VMA_MEMORY_USAGE_AUTO,
+	        },
+	        "encoder bench reference");
+	std::array reference_regions{
+	        vk::BufferImageCopy{
+	                .imageSubresource = {.aspectMask = vk::ImageAspectFlagBits::ePlane0, .layerCount = 1},
+	                .imageExtent = {opts.width, opts.height, 1},
+	        },
+	        vk::BufferImageCopy{
+	                .bufferOffset = luma_size,
+	                .imageSubresource = {.aspectMask = vk::ImageAspectFlagBits::ePlane1, .layerCount = 1},
+	                .imageExtent = {opts.width / 2, opts.height / 2, 1},
+	        },
+	};
+
+	vk::raii::CommandPool command_pool(device,
+	                                   {
+	                                           .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+	                                           .queueFamilyIndex = bundle.queue_family_index,
+	                                   });
+	auto command_buffer = std::move(device.allocateCommandBuffers({
+	        .commandPool = *command_pool,
+	        .commandBufferCount = 1,
+	})[0]);
+	vk::raii::Fence fence(device, vk::FenceCreateInfo{});
+
+	struct stripe_output
+	{
+		std::vector<uint8_t> bitstream;
+		std::optional<clock::time_point> first_data;
+		clock::time_point begin;
+		clock::time_point end;
+		std::exception_ptr error;
+	};
+	std::vector<stripe_output> outputs(encoders.size());
+
+	std::vector<frame_result> results;
+	const auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1 / opts.fps));
+	auto next_frame = clock::now();
+	for (int frame_index = 0; frame_index < opts.frames; ++frame_index)
+	{
+		if (opts.pacing)
+		{
+			std::this_thread::sleep_until(next_frame);
+			next_frame += period;
+		}
+
+		auto & result = results.emplace_back(frame_result{
+		        .index = uint64_t(frame_index),
+		        .idr = frame_index == 0 or (opts.idr_interval > 0 and frame_index % opts.idr_interval == 0),
+		});
+
+		auto present_begin = clock::now();
+		command_buffer.reset();
+		command_buffer.begin(vk::CommandBufferBeginInfo{
+		        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+		});
+		generator.record(command_buffer, image, 0);
+		if (decoders[0])
+			command_buffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, reference, reference_regions);
+
+		bool need_queue_transfer = false;
+		std::vector<vk::Semaphore> present_done_sem;
+		for (auto & encoder: encoders)
+		{
+			auto [transfer, sem] = encoder->present_image(image, command_buffer, frame_index);
+			need_queue_transfer |= transfer;
+			if (sem)
+				present_done_sem.push_back(sem);
+		}
+
+		vk::SubmitInfo submit_info{};
+#if WIVRN_USE_VULKAN_ENCODE
+		if (need_queue_transfer)
+		{
+			vk::ImageMemoryBarrier barrier{
+			        .srcAccessMask = vk::AccessFlagBits::eMemoryRead,
+			        .dstAccessMask = vk::AccessFlagBits::eMemoryWrite,
+			        .oldLayout = vk::ImageLayout::eTransferSrcOptimal,
+			        .newLayout = vk::ImageLayout::eVideoEncodeSrcKHR,
+			        .srcQueueFamilyIndex = bundle.queue_family_index,
+			        .dstQueueFamilyIndex = bundle.encode_queue_family_index,
+			        .image = image,
+			        .subresourceRange = {.aspectMask = vk::ImageAspectFlagBits::eColor,
+			                             .baseMipLevel = 0,
+			                             .levelCount = 1,
+			                             .baseArrayLayer = 0,
+			                             .layerCount = 2},
+			};
+			command_buffer.pipelineBarrier(
+			        vk::PipelineStageFlagBits::eTransfer,
+			        vk::PipelineStageFlagBits::eNone,
+			        {},
+			        {},
+			        {},
+			        barrier);
+		}
+		submit_info.setSignalSemaphores(present_done_sem);
+#endif
+		command_buffer.end();
+		submit_info.setCommandBuffers(*command_buffer);
+		bundle.queue.submit(submit_info, *fence);
+		for (auto & encoder: encoders)
+			encoder->post_submit();
+
+		if (auto res = device.waitForFences(*fence, true, UINT64_MAX); res != vk::Result::eSuccess)
+			throw std::runtime_error("waitForFences failed: " + vk::to_string(res));
+		device.resetFences(*fence);
+		result.present_ms = to_ms(clock::now() - present_begin);
+
+		auto encode = [&](size_t i) {
+			auto & out = outputs[i];
+			out.bitstream.clear();
+			out.first_data.reset();
+			out.error = nullptr;
+			out.begin = clock::now();
+			try
+			{
+				encoders[i]->encode(result.idr, frame_index, [&](std::span<uint8_t> data, bool) {
+					if (not out.first_data)
+						out.first_data = clock::now();
+					out.bitstream.insert(out.bitstream.end(), data.begin(), data.end());
+				});
+			}
+			catch (...)
+			{
+				out.error = std::current_exception();
+			}
+			out.end = clock::now();
+		};
+		if (encoders.size() == 1)
+			encode(0);
+		else
+		{
+			std::vector<std::jthread> threads;
+			for (size_t i = 0; i < encoders.size(); ++i)
+				threads.emplace_back(encode, i);
+		}
+
+		result.encode_ms = 0;
+		result.first_slice_ms = std::numeric_limits<double>::max();
+		for (const auto & out: outputs)
+		{
+			if (out.error)
+				std::rethrow_exception(out.error);
+			result.bytes += out.bitstream.size();
+			result.encode_ms = std::max(result.encode_ms, to_ms(out.end - out.begin));
+			result.first_slice_ms = std::min(result.first_slice_ms, to_ms(out.first_data.value_or(out.end) - out.begin));
+		}
+
+		if (not decoders[0])
+			continue;
+
+		// Source planes, NV12 with 10-bit samples in the high bits
+		const uint8_t * source = reference.data();
+		const size_t row_pitch = opts.width * bytes;
+		const int shift = bytes == 2 ? 6 : 0;
+		std::array<uint64_t, 3> error{};
+		std::array<uint64_t, 3> samples{};
+		double ssim = 0;
+		bool decoded = true;
+		for (size_t i = 0; i < encoders.size() and decoded; ++i)
+		{
+			auto planes = decoders[i]->decode(outputs[i].bitstream);
+			if (not planes)
+			{
+				decoded = false;
+				break;
+			}
+			const auto & item = settings[i];
+			bench::plane y{
+			        .data = source + item.offset_y * row_pitch + item.offset_x * bytes,
+			        .row_pitch = row_pitch,
+			        .sample_pitch = bytes,
+			        .shift = shift,
+			        .wide = bytes == 2,
+			};
+			bench::plane cb{
+			        .data = source + luma_size + item.offset_y / 2 * row_pitch + item.offset_x * bytes,
+			        .row_pitch = row_pitch,
+			        .sample_pitch = 2 * bytes,
+			        .shift = shift,
+			        .wide = bytes == 2,
+			};
+			bench::plane cr = cb;
+			cr.data += bytes;
+			std::array source_planes{y, cb, cr};
+
+			for (int p = 0; p < 3; ++p)
+			{
+				uint32_t w = p ? item.width / 2 : item.width;
+				uint32_t h = p ? item.height / 2 : item.height;
+				error[p] += bench::squared_error(source_planes[p], (*planes)[p], w, h);
+				samples[p] += uint64_t(w) * h;
+			}
+			ssim += bench::ssim(y, (*planes)[0], item.width, item.height, max_value) * item.height / opts.height;
+		}
+
+		if (decoded)
+		{
+			result.psnr = std::array{
+			        bench::psnr(error[0], samples[0], max_value),
+			        bench::psnr(error[1], samples[1], max_value),
+			        bench::psnr(error[2], samples[2], max_value),
+			};
+			result.ssim = ssim;
+		}
+		else
+			U_LOG_W("Frame %d could not be decoded", frame_index);
+	}
+
+	// Encoders must be destroyed before the Vulkan device
+	encoders.clear();
+	return results;
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	options opts;
+	std::string size = std::format("{}x{}", opts.width, opts.height);
+	std::string codec = "h264";
+	std::string source = "gradient";
+	std::vector<std::string> encoder_options;
+
+	CLI::App app{"Encode synthetic or recorded frames with a WiVRn encoder and measure latency, size and quality"};
+	app.add_option("-e,--encoder", opts.encoder, "encoder: nvenc, vaapi, vulkan, x264, x265 or raw")->capture_default_str();
+	app.add_option("-c,--codec", codec, "codec: h264, h265, av1 or raw")->capture_default_str();
+	app.add_option("-s,--size", size, "image size, both eyes side by side")->option_text("WxH")->capture_default_str();
+	app.add_option("-r,--fps", opts.fps, "frame rate")->capture_default_str();
+	app.add_option("-n,--frames", opts.frames, "number of frames to encode")->capture_default_str();
+	app.add_option("-b,--bitrate", opts.bitrate, "bitrate in Mbit/s")->capture_default_str();
+	app.add_option("--bit-depth", opts.bit_depth, "8 or 10")->check(CLI::IsMember({8, 10}))->capture_default_str();
+	app.add_option("--stripes", opts.stripes, "number of horizontal stripes encoded concurrently")->check(CLI::Range(1, 16))->capture_default_str();
+	app.add_option("--idr-interval", opts.idr_interval, "frames between IDR frames, 0 for the first frame only")->capture_default_str();
+	app.add_option("-o,--option", encoder_options, "encoder specific option, as in the configuration file")->option_text("KEY=VALUE");
+	app.add_option("--device", opts.device, "encoder device");
+	app.add_option("--source", source, "gradient, text, noise, or raw NV12 file to replay")->capture_default_str();
+	app.add_option("--csv", opts.csv, "write per frame data as CSV, - for stdout")->option_text("FILE");
+	app.add_option("--json", opts.json, "write the summary and per frame data as JSON, - for stdout")->option_text("FILE");
+	auto no_quality = app.add_flag("--no-quality", "do not decode frames to compute PSNR and SSIM");
+	auto no_pacing = app.add_flag("--no-pacing", "encode as fast as possible instead of at the frame rate");
+
+	CLI11_PARSE(app, argc, argv);
+
+	opts.quality = not *no_quality;
+	opts.pacing = not *no_pacing;
+
+	if (auto c = magic_enum::enum_cast<video_codec>(codec))
+		opts.codec = *c;
+	else
+	{
+		std::cerr << "Invalid codec " << codec << std::endl;
+		return 2;
+	}
+
+	if (sscanf(size.c_str(), "%ux%u", &opts.width, &opts.height) != 2 or opts.width == 0 or opts.height == 0)
+	{
+		std::cerr << "Invalid size " << size << std::endl;
+		return 2;
+	}
+	// Same alignment as the server
+	opts.width = align(opts.width, 64);
+	opts.height = align(opts.height, 64);
+
+	for (const auto & option: encoder_options)
+	{
+		auto pos = option.find('=');
+		if (pos == std::string::npos)
+		{
+			std::cerr << "Invalid encoder option " << option << std::endl;
+			return 2;
+		}
+		opts.encoder_options[option.substr(0, pos)] = option.substr(pos + 1);
+	}
+
+	if (auto pattern = magic_enum::enum_cast<configuration::frame_generator::pattern_t>(source);
+	    pattern and *pattern != configuration::frame_generator::pattern_t::replay)
+		opts.source.pattern = *pattern;
+	else
+	{
+		opts.source.pattern = configuration::frame_generator::pattern_t::replay;
+		opts.source.file = source;
+	}
+
+	try
+	{
+		auto frames = run(opts);
+		auto json = make_json(opts, frames);
+		print_summary(json);
+
+		if (opts.csv == "-")
+			write_csv(std::cout, frames);
+		else if (not opts.csv.empty())
+		{
+			std::ofstream out(opts.csv);
+			write_csv(out, frames);
+		}
+
+		if (opts.json == "-")
+			std::cout << json.dump(2) << std::endl;
+		else if (not opts.json.empty())
+			std::ofstream(opts.json) << json.dump(2) << std::endl;
+	}
+	catch (std::exception & e)
+	{
+		U_LOG_E("%s", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "packets.h"
+
+#include <numeric>
+
+namespace wivrn::bench
+{
+to_headset::video_stream_data_shard make_shard(std::vector<uint8_t> & payload)
+{
+	payload.resize(to_headset::video_stream_data_shard::max_payload_size);
+	std::iota(payload.begin(), payload.end(), 0);
+
+	XrPosef pose{
+	        .orientation = {0, 0, 0, 1},
+	        .position = {0, 1.6, 0},
+	};
+	XrFovf fov{-0.8, 0.8, 0.8, -0.8};
+
+	return {
+	        .stream_item_idx = 0,
+	        .frame_idx = 1000,
+	        .shard_idx = 0,
+	        .flags = to_headset::video_stream_data_shard::start_of_slice,
+	        .view_info = to_headset::video_stream_data_shard::view_info_t{
+	                .display_time = 1'000'000'000,
+	                .pose = {pose, pose},
+	                .fov = {fov, fov},
+	        },
+	        .payload = payload,
+	};
+}
+
+from_headset::trackings make_trackings(int count)
+{
+	from_headset::trackings result;
+	for (int i = 0; i < count; ++i)
+	{
+		from_headset::tracking item{
+		        .production_timestamp = 1'000'000'000,
+		        .timestamp = 1'000'000'000 + i * 1'000'000,
+		        .view_flags = XR_VIEW_STATE_ORIENTATION_VALID_BIT | XR_VIEW_STATE_POSITION_VALID_BIT,
+		};
+		for (auto device: {device_id::HEAD, device_id::LEFT_AIM, device_id::LEFT_GRIP, device_id::RIGHT_AIM, device_id::RIGHT_GRIP})
+		{
+			item.device_poses.push_back({
+			        .pose = {
+			                .orientation = {0, 0, 0, 1},
+			                .position = {0, 1, 0},
+			        },
+			        .device = device,
+			        .flags = from_headset::tracking::orientation_valid | from_headset::tracking::position_valid,
+			});
+		}
+		result.items.push_back(std::move(item));
+	}
+	return result;
+}
+
+from_headset::feedback make_feedback()
+{
+	return {
+	        .frame_index = 1000,
+	        .stream_index = 0,
+	        .encode_begin = 1'000'000'000,
+	        .encode_end = 1'003'000'000,
+	        .send_begin = 1'003'000'000,
+	        .send_end = 1'004'000'000,
+	        .received_first_packet = 1'004'000'000,
+	        .received_last_packet = 1'005'000'000,
+	        .sent_to_decoder = 1'005'000'000,
+	        .received_from_decoder = 1'008'000'000,
+	        .blitted = 1'009'000'000,
+	        .displayed = 1'020'000'000,
+	        .times_displayed = 1,
+	};
+}
+} // namespace wivrn::bench
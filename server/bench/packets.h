@@ -0,0 +1,31 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_packets.h"
+
+#include <vector>
+
+namespace wivrn::bench
+{
+// Packets with realistic content, shared by the benchmarks
+to_headset::video_stream_data_shard make_shard(std::vector<uint8_t> & payload);
+from_headset::trackings make_trackings(int count);
+from_headset::feedback make_feedback();
+} // namespace wivrn::bench
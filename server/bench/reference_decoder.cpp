@@ -0,0 +1,140 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "reference_decoder.h"
+
+#include "util/u_logging.h"
+
+#include <stdexcept>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace wivrn::bench
+{
+namespace
+{
+AVCodecID codec_id(video_codec codec)
+{
+	switch (codec)
+	{
+		case video_codec::h264:
+			return AV_CODEC_ID_H264;
+		case video_codec::h265:
+			return AV_CODEC_ID_HEVC;
+		case video_codec::av1:
+			return AV_CODEC_ID_AV1;
+		case video_codec::raw:
+			break;
+	}
+	throw std::invalid_argument("codec is not supported by ffmpeg");
+}
+} // namespace
+
+reference_decoder::reference_decoder(video_codec c) :
+        codec(nullptr, [](AVCodecContext * ctx) { avcodec_free_context(&ctx); }),
+        frame(av_frame_alloc(), [](AVFrame * frame) { av_frame_free(&frame); })
+{
+	auto avcodec = avcodec_find_decoder(codec_id(c));
+	if (avcodec == nullptr)
+		throw std::runtime_error{"avcodec_find_decoder failed"};
+
+	codec.reset(avcodec_alloc_context3(avcodec));
+	// Output each frame as soon as it is decoded, frames are compared in order
+	codec->flags |= AV_CODEC_FLAG_LOW_DELAY;
+	codec->thread_type = FF_THREAD_SLICE;
+	codec->thread_count = 0;
+
+	if (avcodec_open2(codec.get(), avcodec, nullptr) < 0)
+		throw std::runtime_error{"avcodec_open2 failed"};
+}
+
+std::optional<std::array<plane, 3>> reference_decoder::decode(std::span<const uint8_t> bitstream)
+{
+	packet.assign(bitstream.begin(), bitstream.end());
+	packet.resize(bitstream.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+
+	AVPacket pkt{};
+	pkt.pts = AV_NOPTS_VALUE;
+	pkt.dts = AV_NOPTS_VALUE;
+	pkt.data = packet.data();
+	pkt.size = bitstream.size();
+	pkt.pos = -1;
+
+	av_frame_unref(frame.get());
+	if (avcodec_send_packet(codec.get(), &pkt) < 0)
+		return std::nullopt;
+	if (avcodec_receive_frame(codec.get(), frame.get()) < 0)
+		return std::nullopt;
+
+	auto luma = [&](bool wide) {
+		return plane{
+		        .data = frame->data[0],
+		        .row_pitch = size_t(frame->linesize[0]),
+		        .sample_pitch = wide ? 2u : 1u,
+		        .wide = wide,
+		};
+	};
+
+	switch (frame->format)
+	{
+		case AV_PIX_FMT_YUV420P:
+		case AV_PIX_FMT_YUVJ420P:
+		case AV_PIX_FMT_YUV420P10LE: {
+			bool wide = frame->format == AV_PIX_FMT_YUV420P10LE;
+			return std::array{
+			        luma(wide),
+			        plane{
+			                .data = frame->data[1],
+			                .row_pitch = size_t(frame->linesize[1]),
+			                .sample_pitch = wide ? 2u : 1u,
+			                .wide = wide,
+			        },
+			        plane{
+			                .data = frame->data[2],
+			                .row_pitch = size_t(frame->linesize[2]),
+			                .sample_pitch = wide ? 2u : 1u,
+			                .wide = wide,
+			        },
+			};
+		}
+		case AV_PIX_FMT_NV12:
+		case AV_PIX_FMT_P010LE: {
+			bool wide = frame->format == AV_PIX_FMT_P010LE;
+			auto l = luma(wide);
+			l.shift = wide ? 6 : 0;
+			plane cb{
+			        .data = frame->data[1],
+			        .row_pitch = size_t(frame->linesize[1]),
+			        .sample_pitch = wide ? 4u : 2u,
+			        .shift = wide ? 6 : 0,
+			        .wide = wide,
+			};
+			plane cr = cb;
+			cr.data += wide ? 2 : 1;
+			return std::array{l, cb, cr};
+		}
+		default:
+			U_LOG_W("Unsupported decoded pixel format %s", av_get_pix_fmt_name(AVPixelFormat(frame->format)));
+			return std::nullopt;
+	}
+}
+} // namespace wivrn::bench
@@ -0,0 +1,49 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "video_quality.h"
+#include "wivrn_packets.h"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+struct AVCodecContext;
+struct AVFrame;
+
+namespace wivrn::bench
+{
+// Software decoder used to measure the quality of encoded frames
+class reference_decoder
+{
+	std::unique_ptr<AVCodecContext, void (*)(AVCodecContext *)> codec;
+	std::unique_ptr<AVFrame, void (*)(AVFrame *)> frame;
+	std::vector<uint8_t> packet;
+
+public:
+	reference_decoder(video_codec);
+
+	// Decode a complete frame, planes are Y, Cb, Cr with 10-bit samples in the low bits.
+	// Planes are valid until the next call.
+	std::optional<std::array<plane, 3>> decode(std::span<const uint8_t> bitstream);
+};
+} // namespace wivrn::bench
@@ -0,0 +1,90 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "video_quality.h"
+
+#include <cmath>
+#include <limits>
+
+namespace wivrn::bench
+{
+uint64_t squared_error(const plane & a, const plane & b, uint32_t width, uint32_t height)
+{
+	uint64_t sum = 0;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			int64_t d = int64_t(a.at(x, y)) - int64_t(b.at(x, y));
+			sum += d * d;
+		}
+	}
+	return sum;
+}
+
+double psnr(uint64_t squared_error, uint64_t samples, uint32_t max_value)
+{
+	if (squared_error == 0 or samples == 0)
+		return std::numeric_limits<double>::infinity();
+
+	double mse = double(squared_error) / samples;
+	return 10 * std::log10(double(max_value) * max_value / mse);
+}
+
+double ssim(const plane & a, const plane & b, uint32_t width, uint32_t height, uint32_t max_value)
+{
+	const uint32_t window = 8;
+	const uint32_t stride = 4;
+	const double c1 = std::pow(0.01 * max_value, 2);
+	const double c2 = std::pow(0.03 * max_value, 2);
+	const double n = window * window;
+
+	double total = 0;
+	size_t count = 0;
+	for (uint32_t y0 = 0; y0 + window <= height; y0 += stride)
+	{
+		for (uint32_t x0 = 0; x0 + window <= width; x0 += stride)
+		{
+			uint64_t sum_a = 0, sum_b = 0, sum_aa = 0, sum_bb = 0, sum_ab = 0;
+			for (uint32_t y = y0; y < y0 + window; ++y)
+			{
+				for (uint32_t x = x0; x < x0 + window; ++x)
+				{
+					uint64_t va = a.at(x, y);
+					uint64_t vb = b.at(x, y);
+					sum_a += va;
+					sum_b += vb;
+					sum_aa += va * va;
+					sum_bb += vb * vb;
+					sum_ab += va * vb;
+				}
+			}
+			double mean_a = sum_a / n;
+			double mean_b = sum_b / n;
+			double var_a = sum_aa / n - mean_a * mean_a;
+			double var_b = sum_bb / n - mean_b * mean_b;
+			double covar = sum_ab / n - mean_a * mean_b;
+
+			total += ((2 * mean_a * mean_b + c1) * (2 * covar + c2)) /
+			         ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+			++count;
+		}
+	}
+	return count ? total / count : 1;
+}
+} // namespace wivrn::bench
@@ -0,0 +1,59 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace wivrn::bench
+{
+// A plane of 8 or 16-bit samples, possibly interleaved with other planes
+struct plane
+{
+	const uint8_t * data;
+	// bytes between rows
+	size_t row_pitch;
+	// bytes between samples
+	size_t sample_pitch = 1;
+	// 16-bit samples are shifted right by this amount
+	int shift = 0;
+	bool wide = false;
+
+	uint32_t at(uint32_t x, uint32_t y) const
+	{
+		const uint8_t * p = data + y * row_pitch + x * sample_pitch;
+		if (not wide)
+			return *p;
+		uint16_t value;
+		memcpy(&value, p, sizeof(value));
+		return value >> shift;
+	}
+};
+
+// Sum of squared differences, to be combined over several areas before computing the PSNR
+uint64_t squared_error(const plane & a, const plane & b, uint32_t width, uint32_t height);
+
+// max_value: 255 for 8-bit, 1023 for 10-bit
+// return value: PSNR in dB, infinity if there is no error
+double psnr(uint64_t squared_error, uint64_t samples, uint32_t max_value);
+
+// Mean SSIM over 8x8 windows with a stride of 4
+double ssim(const plane & a, const plane & b, uint32_t width, uint32_t height, uint32_t max_value);
+} // namespace wivrn::bench
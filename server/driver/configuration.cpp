@@ -67,6 +67,14 @@ NLOHMANN_JSON_SERIALIZE_ENUM(
                 {raw, "raw"},
         })
 
+NLOHMANN_JSON_SERIALIZE_ENUM(
+        raw_chunk_header::compression_t,
+        {
+                {raw_chunk_header::compression_t(-1), ""},
+                {raw_chunk_header::compression_t::none, "none"},
+                {raw_chunk_header::compression_t::lz4, "lz4"},
+        })
+
 NLOHMANN_JSON_SERIALIZE_ENUM(
         service_publication,
         {
@@ -76,6 +84,16 @@ NLOHMANN_JSON_SERIALIZE_ENUM(
                 {service_publication::avahi, "avahi"},
         })
 
+NLOHMANN_JSON_SERIALIZE_ENUM(
+        configuration::frame_generator::pattern_t,
+        {
+                {configuration::frame_generator::pattern_t(-1), ""},
+                {configuration::frame_generator::pattern_t::gradient, "gradient"},
+                {configuration::frame_generator::pattern_t::text, "text"},
+                {configuration::frame_generator::pattern_t::noise, "noise"},
+                {configuration::frame_generator::pattern_t::replay, "replay"},
+        })
+
 void configuration::set_config_file(const std::filesystem::path & path)
 {
 	config_file = resolve_path(path);
@@ -150,9 +168,52 @@ configuration::encoder parse_encoder(const nlohmann::json & item)
 		throw std::runtime_error("invalid codec value " + item["codec"].get<std::string>());
 	SET_IF(options);
 	SET_IF(device);
+	SET_IF(intra_refresh);
+	SET_IF(foveation_qp);
+	SET_IF(compression);
+	if (e.compression == raw_chunk_header::compression_t(-1))
+		throw std::runtime_error("invalid compression value " + item["compression"].get<std::string>());
+	SET_IF(delta);
+#undef SET_IF
 	return e;
 }
 
+configuration::frame_generator parse_frame_generator(const nlohmann::json & item)
+{
+	configuration::frame_generator g{.pattern = configuration::frame_generator::pattern_t(-1)};
+	if (item.is_string())
+		g.pattern = item;
+	else
+	{
+		if (item.contains("pattern"))
+			g.pattern = item["pattern"];
+		if (item.contains("file"))
+			g.file = item["file"].get<std::string>();
+	}
+
+	if (g.pattern == configuration::frame_generator::pattern_t(-1))
+		throw std::runtime_error("invalid synthetic source pattern " + item.dump());
+	if (g.pattern == configuration::frame_generator::pattern_t::replay and g.file.empty())
+		throw std::runtime_error("synthetic source replay requires a file");
+	return g;
+}
+
+configuration::thread_profile parse_thread_profile(const nlohmann::json & item)
+{
+	configuration::thread_profile p;
+
+#define SET_IF(property)              \
+	if (item.contains(#property)) \
+		p.property = item[#property];
+
+	SET_IF(cpus);
+	SET_IF(policy);
+	SET_IF(priority);
+	SET_IF(nice);
+#undef SET_IF
+	return p;
+}
+
 configuration::configuration()
 {
 	try
@@ -175,6 +236,21 @@ configuration::configuration()
 		if (auto it = json.find("bitrate"); it != json.end())
 			bitrate = *it;
 
+		if (auto it = json.find("target-miss-rate"); it != json.end())
+			target_miss_rate = *it;
+
+		if (auto it = json.find("pipeline-depth"); it != json.end())
+			pipeline_depth = *it;
+
+		if (auto it = json.find("max-repeated-frames"); it != json.end())
+			max_repeated_frames = *it;
+
+		if (auto it = json.find("stripes"); it != json.end())
+			stripes = *it;
+
+		if (auto it = json.find("blank-hidden-area"); it != json.end())
+			blank_hidden_area = *it;
+
 		if (auto it = json.find("encoders"); it != json.end())
 		{
 			for (const auto & encoder: *it)
@@ -195,6 +271,12 @@ configuration::configuration()
 			}
 		}
 
+		if (auto it = json.find("threads"); it != json.end())
+		{
+			for (const auto & [role, item]: it->items())
+				threads[role] = parse_thread_profile(item);
+		}
+
 		if (auto it = json.find("debug-gui"); it != json.end())
 			debug_gui = *it;
 
@@ -209,6 +291,15 @@ configuration::configuration()
 		else if (auto it = json.find("tcp_only"); it != json.end())
 			tcp_only = *it;
 
+		if (auto it = json.find("standby"); it != json.end())
+			standby = *it;
+
+		if (auto it = json.find("synthetic-source"); it != json.end() and not it->is_null())
+			synthetic_source = parse_frame_generator(*it);
+
+		if (auto it = json.find("metrics-file"); it != json.end() and not it->is_null())
+			metrics_file = it->get<std::string>();
+
 		if (auto it = json.find("publish-service"); it != json.end())
 		{
 			publication = *it;
@@ -28,6 +28,7 @@
 #include <string>
 #include <variant>
 
+#include "raw_chunk.h"
 #include "wivrn_packets.h"
 
 namespace wivrn
@@ -52,19 +53,58 @@ struct configuration
 		std::optional<wivrn::video_codec> codec;
 		std::map<std::string, std::string> options;
 		std::optional<std::string> device;
+		std::optional<int> intra_refresh;
+		std::optional<float> foveation_qp;
+		std::optional<raw_chunk_header::compression_t> compression;
+		std::optional<bool> delta;
+	};
+
+	struct thread_profile
+	{
+		std::optional<std::vector<int>> cpus;
+		std::optional<std::string> policy;
+		std::optional<int> priority;
+		std::optional<int> nice;
+	};
+
+	struct frame_generator
+	{
+		enum class pattern_t
+		{
+			gradient,
+			text,
+			noise,
+			replay,
+		};
+		pattern_t pattern;
+		// raw NV12 frames for replay
+		std::filesystem::path file;
 	};
 
 	std::vector<encoder> encoders;
 	std::optional<encoder> encoder_passthrough;
 	std::optional<int> bitrate;
+	// number of stripes per eye for the default software encoder, unset for automatic
+	std::optional<int> stripes;
+	std::optional<double> target_miss_rate;
 	int bit_depth = 8;
+	int pipeline_depth = 2;
+	int max_repeated_frames = 0;
+	bool blank_hidden_area = false;
 	std::optional<std::array<double, 2>> scale;
 	std::optional<std::array<float, 3>> grip_surface;
 	std::vector<std::string> application;
 	bool debug_gui = false;
 	bool use_steamvr_lh = false;
 	bool tcp_only = false;
+	bool standby = false;
+	// encode generated frames instead of the compositor output
+	std::optional<frame_generator> synthetic_source;
 	service_publication publication = service_publication::avahi;
+	// OpenMetrics file updated with the streaming statistics
+	std::optional<std::filesystem::path> metrics_file;
+	// key: thread role
+	std::map<std::string, thread_profile> threads;
 
 	// monostate: default value, string: user defined, nullptr: disabled
 	std::variant<std::monostate, std::string, std::nullptr_t> openvr_compat_path;
@@ -0,0 +1,346 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "flight_recorder.h"
+
+#include "os/os_time.h"
+#include "util/u_logging.h"
+#include "utils/named_thread.h"
+#include "utils/xdg_base_directory.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <magic_enum.hpp>
+
+namespace wivrn
+{
+
+namespace
+{
+// File format: magic, version, event names, frame type names, then the
+// records sorted by time. Integers are little endian.
+const char magic[8] = {'W', 'I', 'V', 'R', 'N', 'F', 'R', 0};
+const uint32_t format_version = 1;
+
+// Number of dumps kept in the directory
+const size_t max_dumps = 20;
+
+// Latency spike: time from encode to blit above twice the median plus this margin
+const double latency_margin_ms = 20;
+const size_t min_latency_samples = 200;
+
+// Burst of lost frames: this many frames in one second
+const size_t lost_frames_burst = 10;
+
+// IDR storm: this many IDR on a stream in 5 seconds
+const size_t idr_storm = 4;
+const int64_t idr_storm_duration = 5'000'000'000;
+
+const int64_t window_ns = std::chrono::nanoseconds(flight_recorder::window).count();
+const int64_t after_trigger_ns = std::chrono::nanoseconds(flight_recorder::after_trigger).count();
+
+std::atomic<uint64_t> next_id = 1;
+
+struct thread_ring
+{
+	uint64_t owner = 0;
+	std::shared_ptr<void> ring;
+	std::atomic<bool> * alive = nullptr;
+
+	~thread_ring()
+	{
+		if (alive)
+			*alive = false;
+	}
+};
+thread_local thread_ring local;
+
+template <typename T>
+void write_pod(std::ostream & out, const T & value)
+{
+	out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename E>
+void write_names(std::ostream & out)
+{
+	auto names = magic_enum::enum_names<E>();
+	write_pod(out, uint8_t(names.size()));
+	for (auto name: names)
+	{
+		out.write(name.data(), name.size());
+		out.put(0);
+	}
+}
+} // namespace
+
+flight_recorder::flight_recorder() :
+        id(next_id++),
+        latency(0.01, 0.1, 10'000, 1000)
+{
+	thread = utils::named_thread("flight_recorder", [this]() { run(); });
+}
+
+flight_recorder::~flight_recorder()
+{
+	{
+		std::lock_guard lock(mutex);
+		quit = true;
+	}
+	cv.notify_all();
+	thread.join();
+}
+
+flight_recorder::ring & flight_recorder::local_ring()
+{
+	if (local.owner == id) [[likely]]
+		return *static_cast<ring *>(local.ring.get());
+
+	auto r = std::make_shared<ring>();
+	{
+		std::lock_guard lock(rings_mutex);
+		// Forget the threads that exited, once their events are too old
+		int64_t expired = os_monotonic_get_ns() - window_ns;
+		std::erase_if(rings, [&](const std::shared_ptr<ring> & r) {
+			uint64_t n = r->published.load(std::memory_order_acquire);
+			return not r->alive and (n == 0 or int64_t(r->records[(n - 1) % ring_size][0].load(std::memory_order_relaxed)) < expired);
+		});
+		rings.push_back(r);
+	}
+
+	// A thread used by several sessions keeps its old ring alive until here
+	if (local.alive)
+		*local.alive = false;
+	local.owner = id;
+	local.alive = &r->alive;
+	local.ring = std::move(r);
+	return *static_cast<ring *>(local.ring.get());
+}
+
+void flight_recorder::push(event e, uint64_t frame, int64_t time, uint8_t stream, frame_type type)
+{
+	auto & r = local_ring();
+	uint64_t index = r.published.load(std::memory_order_relaxed);
+	auto & rec = r.records[index % ring_size];
+
+	// The reader discards the records that were overwritten while it was copying them
+	r.write_index.store(index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	rec[0].store(time, std::memory_order_relaxed);
+	rec[1].store(frame, std::memory_order_relaxed);
+	rec[2].store(uint64_t(e) | uint64_t(stream) << 8 | uint64_t(type) << 16, std::memory_order_relaxed);
+	r.published.store(index + 1, std::memory_order_release);
+
+	if (type == frame_type::idr and e == event::encode_begin)
+		on_idr(stream, time);
+}
+
+std::vector<flight_recorder::record> flight_recorder::collect(int64_t begin, int64_t end)
+{
+	std::vector<std::shared_ptr<ring>> snapshot;
+	{
+		std::lock_guard lock(rings_mutex);
+		snapshot = rings;
+	}
+
+	std::vector<record> result;
+	for (const auto & r: snapshot)
+	{
+		uint64_t last = r->published.load(std::memory_order_acquire);
+		uint64_t first = last > ring_size ? last - ring_size : 0;
+
+		std::vector<std::pair<uint64_t, record>> copy;
+		copy.reserve(last - first);
+		for (uint64_t i = first; i < last; ++i)
+		{
+			const auto & rec = r->records[i % ring_size];
+			uint64_t info = rec[2].load(std::memory_order_relaxed);
+			copy.emplace_back(
+			        i,
+			        record{
+			                .time = int64_t(rec[0].load(std::memory_order_relaxed)),
+			                .frame = rec[1].load(std::memory_order_relaxed),
+			                .ev = event(info & 0xff),
+			                .stream = uint8_t(info >> 8),
+			                .type = frame_type(info >> 16),
+			        });
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t written = r->write_index.load(std::memory_order_relaxed);
+		for (const auto & [i, rec]: copy)
+		{
+			if (i + ring_size >= written and rec.time >= begin and rec.time <= end)
+				result.push_back(rec);
+		}
+	}
+
+	std::ranges::stable_sort(result, {}, &record::time);
+	return result;
+}
+
+std::filesystem::path flight_recorder::directory()
+{
+	return xdg_cache_home() / "wivrn" / "flight_recorder";
+}
+
+void flight_recorder::write(const std::vector<record> & records, const std::string & reason)
+{
+	auto dir = directory();
+	std::filesystem::create_directories(dir);
+
+	char date[32];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&now));
+	auto path = dir / (std::string(date) + "-" + reason + ".wivrnfr");
+
+	std::ofstream out(path, std::ios::binary);
+	out.write(magic, sizeof(magic));
+	write_pod(out, format_version);
+	write_names<event>(out);
+	write_names<frame_type>(out);
+	write_pod(out, uint64_t(records.size()));
+	for (const auto & rec: records)
+	{
+		write_pod(out, rec.time);
+		write_pod(out, rec.frame);
+		write_pod(out, rec.ev);
+		write_pod(out, rec.stream);
+		write_pod(out, rec.type);
+	}
+	out.close();
+	if (not out)
+		throw std::runtime_error("cannot write " + path.string());
+
+	U_LOG_I("Flight recorder: %zu events written to %s (%s)", records.size(), path.c_str(), reason.c_str());
+
+	// Remove the oldest dumps, names are sorted by date
+	std::vector<std::filesystem::path> dumps;
+	for (const auto & entry: std::filesystem::directory_iterator(dir))
+	{
+		if (entry.path().extension() == ".wivrnfr")
+			dumps.push_back(entry.path());
+	}
+	if (dumps.size() > max_dumps)
+	{
+		std::ranges::sort(dumps);
+		for (size_t i = 0; i < dumps.size() - max_dumps; ++i)
+			std::filesystem::remove(dumps[i]);
+	}
+}
+
+void flight_recorder::run()
+{
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		cv.wait(lock, [&]() { return quit or not pending.empty(); });
+		if (pending.empty())
+			return;
+
+		// Wait for the events that follow the trigger, if the session ends
+		// before, write the events collected so far
+		auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(pending.front().end - os_monotonic_get_ns());
+		cv.wait_until(lock, end, [&]() { return quit; });
+
+		request r = std::move(pending.front());
+		pending.pop_front();
+		r.end = std::min(r.end, os_monotonic_get_ns());
+
+		lock.unlock();
+		try
+		{
+			write(collect(r.begin, r.end), r.reason);
+		}
+		catch (std::exception & e)
+		{
+			U_LOG_W("Flight recorder: failed to write events: %s", e.what());
+		}
+		lock.lock();
+	}
+}
+
+void flight_recorder::trigger(std::string reason, int64_t time, bool automatic)
+{
+	{
+		std::lock_guard lock(mutex);
+		if (automatic)
+		{
+			if (last_automatic_dump and time < last_automatic_dump + window_ns)
+				return;
+			last_automatic_dump = time;
+			U_LOG_W("Flight recorder: %s detected", reason.c_str());
+		}
+		pending.push_back(request{
+		        .reason = std::move(reason),
+		        .begin = time - window_ns,
+		        .end = automatic ? time + after_trigger_ns : time,
+		});
+	}
+	cv.notify_all();
+}
+
+void flight_recorder::dump(std::string reason)
+{
+	trigger(std::move(reason), os_monotonic_get_ns(), false);
+}
+
+void flight_recorder::on_idr(uint8_t stream, int64_t time)
+{
+	{
+		std::lock_guard lock(idr_mutex);
+		auto & times = idr_times[stream];
+		times.push_back(time);
+		while (times.front() < time - idr_storm_duration)
+			times.pop_front();
+		if (times.size() < idr_storm)
+			return;
+		times.clear();
+	}
+	trigger("idr_storm", time, true);
+}
+
+void flight_recorder::on_feedback(const from_headset::feedback & feedback)
+{
+	int64_t now = os_monotonic_get_ns();
+
+	bool incomplete = feedback.received_first_packet and not feedback.received_last_packet;
+	bool skipped = feedback.received_from_decoder and not feedback.blitted;
+	if (incomplete or skipped)
+	{
+		lost_frames.push_back(now);
+		while (lost_frames.front() < now - 1'000'000'000)
+			lost_frames.pop_front();
+		if (lost_frames.size() >= lost_frames_burst)
+		{
+			lost_frames.clear();
+			trigger("frame_loss", now, true);
+		}
+	}
+
+	if (feedback.times_displayed != 1 or not feedback.encode_begin or not feedback.blitted)
+		return;
+
+	double ms = (feedback.blitted - feedback.encode_begin) / 1e6;
+	if (latency.size() >= min_latency_samples and ms > 2 * latency.quantile(0.5) + latency_margin_ms)
+		trigger("latency_spike", now, true);
+	latency.add(ms);
+}
+
+} // namespace wivrn
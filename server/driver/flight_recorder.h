@@ -0,0 +1,166 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "utils/quantile_sketch.h"
+#include "wivrn_packets.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wivrn
+{
+
+// Timing events of the last seconds, kept in memory at all times and written
+// to disk when something goes wrong: latency spike, burst of lost frames, IDR
+// storm, or when requested with wivrnctl.
+// Each thread writes in its own ring buffer, without locks, the dumps are
+// converted to the WIVRN_DUMP_TIMINGS CSV format with tools/flight_recorder_to_csv.py
+class flight_recorder
+{
+public:
+	// Names are the ones of the CSV file
+	enum class event : uint8_t
+	{
+		wake_up,
+		begin,
+		submit,
+		slot_ready,
+		encode_begin,
+		encode_end,
+		repeat,
+		send_begin,
+		send_end,
+		receive_begin,
+		receive_end,
+		decode_begin,
+		decode_end,
+		blit,
+		display,
+	};
+
+	enum class frame_type : uint8_t
+	{
+		none,
+		idr,
+		refresh,
+		p,
+	};
+
+	// Events kept in memory
+	static constexpr auto window = std::chrono::seconds(10);
+	// Events after an automatic trigger that are included in the dump
+	static constexpr auto after_trigger = std::chrono::seconds(2);
+
+private:
+	static constexpr size_t ring_size = 1 << 15;
+
+	// Written by a single thread, read by the dump thread.
+	// Records are 3 words: time, frame, event | stream | frame_type
+	struct ring
+	{
+		std::array<std::array<std::atomic<uint64_t>, 3>, ring_size> records;
+		// Index of the record being written
+		std::atomic<uint64_t> write_index = 0;
+		// Number of complete records
+		std::atomic<uint64_t> published = 0;
+		// False when the thread exited
+		std::atomic<bool> alive = true;
+	};
+
+	struct record
+	{
+		int64_t time;
+		uint64_t frame;
+		event ev;
+		uint8_t stream;
+		frame_type type;
+	};
+
+	const uint64_t id;
+
+	std::mutex rings_mutex;
+	std::vector<std::shared_ptr<ring>> rings;
+
+	ring & local_ring();
+	std::vector<record> collect(int64_t begin, int64_t end);
+	void write(const std::vector<record> & records, const std::string & reason);
+
+	// Automatic triggers
+	std::mutex idr_mutex;
+	std::map<uint8_t, std::deque<int64_t>> idr_times;
+	void on_idr(uint8_t stream, int64_t time);
+
+	// Only used from the thread receiving the feedback
+	utils::quantile_sketch latency;
+	std::deque<int64_t> lost_frames;
+
+	// Dump thread
+	std::mutex mutex;
+	std::condition_variable cv;
+	struct request
+	{
+		std::string reason;
+		// Events between begin and end are written, after end
+		int64_t begin;
+		int64_t end;
+	};
+	// Written in order, a manual dump requested while an automatic one waits
+	// for its following events is queued after it
+	std::deque<request> pending;
+	int64_t last_automatic_dump = 0;
+	bool quit = false;
+	std::thread thread;
+	void run();
+
+	// Schedule a dump, automatic ones are limited to one per window and
+	// include the events that follow, or the ones until the session ends
+	void trigger(std::string reason, int64_t time, bool automatic);
+
+public:
+	flight_recorder();
+	flight_recorder(const flight_recorder &) = delete;
+	flight_recorder & operator=(const flight_recorder &) = delete;
+	~flight_recorder();
+
+	// time: server clock (CLOCK_MONOTONIC)
+	void push(event e, uint64_t frame, int64_t time, uint8_t stream = -1, frame_type type = frame_type::none);
+
+	// Detects latency spikes and lost frames
+	void on_feedback(const from_headset::feedback & feedback);
+
+	// Write the events of the last seconds now
+	void dump(std::string reason);
+
+	static std::filesystem::path directory();
+};
+
+} // namespace wivrn
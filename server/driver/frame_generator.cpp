@@ -0,0 +1,341 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "frame_generator.h"
+
+#include "util/u_logging.h"
+#include "utils/wivrn_vk_bundle.h"
+
+#include <array>
+#include <cstring>
+#include <format>
+#include <magic_enum.hpp>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+
+namespace wivrn
+{
+namespace
+{
+// 5x7 font, one byte per row, most significant of the 5 bits on the left
+const std::string_view glyph_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+const std::array<std::array<uint8_t, 7>, 36> glyphs{{
+        {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // A
+        {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // B
+        {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // C
+        {0x1E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x1E}, // D
+        {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // E
+        {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // F
+        {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // G
+        {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // H
+        {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // I
+        {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // J
+        {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // K
+        {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // L
+        {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // M
+        {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // N
+        {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // O
+        {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // P
+        {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // Q
+        {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // R
+        {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // S
+        {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // T
+        {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // U
+        {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // V
+        {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // W
+        {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // X
+        {0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04}, // Y
+        {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // Z
+        {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // 0
+        {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 1
+        {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // 2
+        {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // 3
+        {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // 4
+        {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // 5
+        {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // 6
+        {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // 7
+        {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // 8
+        {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // 9
+}};
+
+const uint32_t glyph_scale = 3;
+const uint32_t cell_width = 6 * glyph_scale;
+const uint32_t cell_height = 9 * glyph_scale;
+const uint32_t text_lines = 64;
+// rows scrolled per frame
+const uint32_t scroll_speed = 2;
+
+// Store an 8-bit value, 10-bit formats have the value in the high bits of 16-bit samples
+void store(uint8_t * data, size_t index, uint8_t value, uint32_t bytes)
+{
+	if (bytes == 1)
+		data[index] = value;
+	else
+		reinterpret_cast<uint16_t *>(data)[index] = value << 8;
+}
+
+buffer_allocation make_buffer(wivrn_vk_bundle & vk, vk::DeviceSize size, const std::string & name)
+{
+	return buffer_allocation(
+	        vk.device,
+	        {
+	                .size = size,
+	                .usage = vk::BufferUsageFlagBits::eTransferSrc,
+	        },
+	        {
+	                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+	                .usage = VMA_MEMORY_USAGE_AUTO,
+	        },
+	        name);
+}
+} // namespace
+
+frame_generator::frame_generator(wivrn_vk_bundle & vk, const configuration::frame_generator & config, uint32_t width, uint32_t height, vk::Format format, uint32_t slots) :
+        pattern(config.pattern),
+        width(width),
+        height(height),
+        bytes(format == vk::Format::eG10X6B10X6R10X62Plane420Unorm3Pack16 ? 2 : 1)
+{
+	U_LOG_I("Synthetic source: %s pattern, %ux%u", std::string(magic_enum::enum_name(pattern)).c_str(), width, height);
+
+	const size_t frame_size = width * height * 3 / 2 * bytes;
+	switch (pattern)
+	{
+		case pattern_t::gradient: {
+			// Diagonal ramps, moved by changing the offset of the copy
+			luma_row_length = width + 256;
+			chroma_row_length = width / 2 + 128;
+			luma = make_buffer(vk, vk::DeviceSize(luma_row_length) * height * bytes, "synthetic source luma");
+			chroma = make_buffer(vk, vk::DeviceSize(chroma_row_length) * (height / 2) * 2 * bytes, "synthetic source chroma");
+
+			auto y_data = luma.data();
+			for (uint32_t y = 0; y < height; ++y)
+				for (uint32_t x = 0; x < luma_row_length; ++x)
+					store(y_data, size_t(y) * luma_row_length + x, (x + y) & 0xff, bytes);
+
+			auto c_data = chroma.data();
+			for (uint32_t y = 0; y < height / 2; ++y)
+			{
+				for (uint32_t x = 0; x < chroma_row_length; ++x)
+				{
+					size_t i = 2 * (size_t(y) * chroma_row_length + x);
+					store(c_data, i, (2 * x) & 0xff, bytes);
+					store(c_data, i + 1, (2 * y + 64) & 0xff, bytes);
+				}
+			}
+			break;
+		}
+
+		case pattern_t::text: {
+			// Random words, repeated so that scrolling loops without a seam
+			scroll_rows = text_lines * cell_height;
+			luma_row_length = width;
+			chroma_row_length = width / 2;
+			luma = make_buffer(vk, vk::DeviceSize(width) * (height + scroll_rows) * bytes, "synthetic source luma");
+			chroma = make_buffer(vk, vk::DeviceSize(width / 2) * (height / 2) * 2 * bytes, "synthetic source chroma");
+
+			std::minstd_rand rng(42);
+			const uint32_t columns = width / cell_width;
+			std::vector<std::string> lines(text_lines);
+			for (auto & line: lines)
+			{
+				while (line.size() < columns)
+				{
+					line.append(1 + rng() % 10, ' ');
+					for (int i = 0, n = 2 + rng() % 8; i < n; ++i)
+						line += glyph_chars[rng() % glyph_chars.size()];
+				}
+			}
+
+			auto y_data = luma.data();
+			for (uint32_t y = 0; y < height + scroll_rows; ++y)
+			{
+				const auto & line = lines[(y / cell_height) % text_lines];
+				uint32_t glyph_row = (y % cell_height) / glyph_scale;
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					uint32_t column = x / cell_width;
+					uint32_t glyph_column = (x % cell_width) / glyph_scale;
+					bool on = false;
+					if (column < line.size() and glyph_row < 7 and glyph_column < 5)
+					{
+						if (auto c = glyph_chars.find(line[column]); c != std::string_view::npos)
+							on = glyphs[c][glyph_row] & (0x10 >> glyph_column);
+					}
+					store(y_data, size_t(y) * width + x, on ? 235 : 16, bytes);
+				}
+			}
+
+			auto c_data = chroma.data();
+			for (size_t i = 0, n = size_t(width / 2) * (height / 2) * 2; i < n; ++i)
+				store(c_data, i, 128, bytes);
+			break;
+		}
+
+		case pattern_t::noise:
+			for (uint32_t i = 0; i < slots; ++i)
+				staging.push_back(make_buffer(vk, frame_size, std::format("synthetic source frame {}", i)));
+			break;
+
+		case pattern_t::replay: {
+			replay.open(config.file, std::ios::binary);
+			if (not replay)
+				throw std::runtime_error("cannot open " + config.file.string());
+			replay.seekg(0, std::ios::end);
+			const size_t replay_frame_size = width * height * 3 / 2;
+			replay_frames = size_t(replay.tellg()) / replay_frame_size;
+			if (replay_frames == 0)
+				throw std::runtime_error(std::format("{} does not contain a {}x{} NV12 frame", config.file.string(), width, height));
+			replay.seekg(0);
+			replay_buffer.resize(replay_frame_size);
+			U_LOG_I("Replaying %zu frames from %s", replay_frames, config.file.c_str());
+
+			for (uint32_t i = 0; i < slots; ++i)
+				staging.push_back(make_buffer(vk, frame_size, std::format("synthetic source frame {}", i)));
+			break;
+		}
+	}
+}
+
+void frame_generator::fill_noise(uint8_t * data)
+{
+	// xorshift64, seeded by the frame counter so that runs are repeatable
+	uint64_t state = (counter + 1) * 0x9e3779b97f4a7c15;
+	auto words = reinterpret_cast<uint64_t *>(data);
+	const size_t n = width * height * 3 / 2 * bytes / sizeof(uint64_t);
+	for (size_t i = 0; i < n; ++i)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		words[i] = state;
+	}
+}
+
+void frame_generator::read_replay(uint8_t * data)
+{
+	if (counter % replay_frames == 0)
+	{
+		replay.clear();
+		replay.seekg(0);
+	}
+
+	uint8_t * dst = bytes == 1 ? data : replay_buffer.data();
+	replay.read((char *)dst, replay_buffer.size());
+	if (not replay)
+	{
+		U_LOG_W("Failed to read synthetic source replay file");
+		replay.clear();
+		return;
+	}
+
+	if (bytes != 1)
+	{
+		for (size_t i = 0; i < replay_buffer.size(); ++i)
+			store(data, i, replay_buffer[i], bytes);
+	}
+}
+
+void frame_generator::record(vk::raii::CommandBuffer & cmd, vk::Image image, uint32_t slot)
+{
+	vk::Buffer y_buffer;
+	vk::Buffer cbcr_buffer;
+	vk::DeviceSize y_offset = 0;
+	vk::DeviceSize cbcr_offset = 0;
+	uint32_t y_row_length = width;
+	uint32_t cbcr_row_length = width / 2;
+
+	switch (pattern)
+	{
+		case pattern_t::gradient:
+			y_buffer = luma;
+			cbcr_buffer = chroma;
+			y_row_length = luma_row_length;
+			cbcr_row_length = chroma_row_length;
+			y_offset = (counter * 2 % 256) * bytes;
+			cbcr_offset = (counter % 128) * 2 * bytes;
+			break;
+		case pattern_t::text:
+			y_buffer = luma;
+			cbcr_buffer = chroma;
+			y_offset = (counter * scroll_speed % scroll_rows) * width * bytes;
+			break;
+		case pattern_t::noise:
+		case pattern_t::replay: {
+			auto & buffer = staging[slot % staging.size()];
+			if (pattern == pattern_t::noise)
+				fill_noise(buffer.data());
+			else
+				read_replay(buffer.data());
+			y_buffer = buffer;
+			cbcr_buffer = buffer;
+			cbcr_offset = vk::DeviceSize(width) * height * bytes;
+			break;
+		}
+	}
+	++counter;
+
+	vk::ImageMemoryBarrier barrier{
+	        .srcAccessMask = vk::AccessFlagBits::eNone,
+	        .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+	        .oldLayout = vk::ImageLayout::eUndefined,
+	        .newLayout = vk::ImageLayout::eTransferDstOptimal,
+	        .image = image,
+	        .subresourceRange = {
+	                .aspectMask = vk::ImageAspectFlagBits::eColor,
+	                .levelCount = 1,
+	                .layerCount = 1,
+	        },
+	};
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+
+	cmd.copyBufferToImage(
+	        y_buffer,
+	        image,
+	        vk::ImageLayout::eTransferDstOptimal,
+	        vk::BufferImageCopy{
+	                .bufferOffset = y_offset,
+	                .bufferRowLength = y_row_length,
+	                .imageSubresource = {
+	                        .aspectMask = vk::ImageAspectFlagBits::ePlane0,
+	                        .layerCount = 1,
+	                },
+	                .imageExtent = {width, height, 1},
+	        });
+	cmd.copyBufferToImage(
+	        cbcr_buffer,
+	        image,
+	        vk::ImageLayout::eTransferDstOptimal,
+	        vk::BufferImageCopy{
+	                .bufferOffset = cbcr_offset,
+	                .bufferRowLength = cbcr_row_length,
+	                .imageSubresource = {
+	                        .aspectMask = vk::ImageAspectFlagBits::ePlane1,
+	                        .layerCount = 1,
+	                },
+	                .imageExtent = {width / 2, height / 2, 1},
+	        });
+
+	barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+	barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+	barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+}
+} // namespace wivrn
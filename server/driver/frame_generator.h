@@ -0,0 +1,71 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "configuration.h"
+#include "vk/allocation.h"
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace wivrn
+{
+struct wivrn_vk_bundle;
+
+// Fills the colour layer of the compositor images with synthetic content,
+// to get a repeatable load on the encoders without an application
+class frame_generator
+{
+	using pattern_t = configuration::frame_generator::pattern_t;
+
+	pattern_t pattern;
+	uint32_t width;
+	uint32_t height;
+	// bytes per sample: 1 for 8-bit, 2 for 10-bit
+	uint32_t bytes;
+
+	// Static content larger than the image, copied with a moving offset
+	buffer_allocation luma;
+	buffer_allocation chroma;
+	uint32_t luma_row_length = 0;
+	uint32_t chroma_row_length = 0;
+	// number of rows the text pattern scrolls before looping
+	uint32_t scroll_rows = 0;
+
+	// Content generated for each frame, one per frame in flight
+	std::vector<buffer_allocation> staging;
+	std::ifstream replay;
+	size_t replay_frames = 0;
+	std::vector<uint8_t> replay_buffer;
+
+	uint64_t counter = 0;
+
+	void fill_noise(uint8_t * data);
+	void read_replay(uint8_t * data);
+
+public:
+	frame_generator(wivrn_vk_bundle & vk, const configuration::frame_generator & config, uint32_t width, uint32_t height, vk::Format format, uint32_t slots);
+
+	// Record the commands to overwrite the image, it must be in transfer src layout and is left in the same layout.
+	// slot must not be reused until the command buffer has completed.
+	void record(vk::raii::CommandBuffer & cmd, vk::Image image, uint32_t slot);
+};
+} // namespace wivrn
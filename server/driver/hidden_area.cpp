@@ -0,0 +1,201 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hidden_area.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+namespace wivrn
+{
+
+// Number of grid cells on each axis of the full size image
+static const int grid_size = 256;
+// Visible area is grown by this number of cells, to account for
+// reprojection on the headset and imprecise masks
+static const int margin = 4;
+
+uint32_t hidden_area::grid::count(int x0, int y0, int x1, int y1) const
+{
+	x0 = std::clamp(x0, 0, grid_size);
+	x1 = std::clamp(x1, 0, grid_size);
+	y0 = std::clamp(y0, 0, grid_size);
+	y1 = std::clamp(y1, 0, grid_size);
+	if (x0 >= x1 or y0 >= y1)
+		return 0;
+	const int stride = grid_size + 1;
+	return sat[y1 * stride + x1] - sat[y0 * stride + x1] - sat[y1 * stride + x0] + sat[y0 * stride + x0];
+}
+
+void hidden_area::set_mask(int eye,
+                           const from_headset::visibility_mask_changed::mask & visible,
+                           const XrFovf & fov)
+{
+	auto & g = grids[eye];
+	g = {};
+	if (visible.indices.size() < 3)
+		return;
+
+	std::vector<uint8_t> cells(grid_size * grid_size);
+
+	// Vertices are on the z=-1 plane, convert them to cell coordinates
+	const float l = std::tan(fov.angleLeft);
+	const float r = std::tan(fov.angleRight);
+	const float u = std::tan(fov.angleUp);
+	const float d = std::tan(fov.angleDown);
+	auto to_cell = [&](const XrVector2f & v) {
+		return XrVector2f{
+		        (v.x - l) / (r - l) * grid_size,
+		        (u - v.y) / (u - d) * grid_size,
+		};
+	};
+
+	for (size_t i = 0; i + 2 < visible.indices.size(); i += 3)
+	{
+		std::array<XrVector2f, 3> t;
+		for (int j = 0; j < 3; ++j)
+		{
+			auto index = visible.indices[i + j];
+			if (index >= visible.vertices.size())
+			{
+				g = {};
+				return;
+			}
+			t[j] = to_cell(visible.vertices[index]);
+		}
+
+		auto edge = [](const XrVector2f & a, const XrVector2f & b, float x, float y) {
+			return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+		};
+		float area = edge(t[0], t[1], t[2].x, t[2].y);
+		if (area == 0)
+			continue;
+
+		int x0 = std::clamp<int>(std::floor(std::min({t[0].x, t[1].x, t[2].x})), 0, grid_size);
+		int x1 = std::clamp<int>(std::ceil(std::max({t[0].x, t[1].x, t[2].x})), 0, grid_size);
+		int y0 = std::clamp<int>(std::floor(std::min({t[0].y, t[1].y, t[2].y})), 0, grid_size);
+		int y1 = std::clamp<int>(std::ceil(std::max({t[0].y, t[1].y, t[2].y})), 0, grid_size);
+		for (int y = y0; y < y1; ++y)
+		{
+			for (int x = x0; x < x1; ++x)
+			{
+				// Test the cell centre, winding order is not specified
+				float w0 = edge(t[1], t[2], x + 0.5f, y + 0.5f) * area;
+				float w1 = edge(t[2], t[0], x + 0.5f, y + 0.5f) * area;
+				float w2 = edge(t[0], t[1], x + 0.5f, y + 0.5f) * area;
+				if (w0 >= 0 and w1 >= 0 and w2 >= 0)
+					cells[y * grid_size + x] = 1;
+			}
+		}
+	}
+
+	const int stride = grid_size + 1;
+	g.sat.assign(stride * (grid_size + 1), 0);
+	for (int y = 0; y < grid_size; ++y)
+	{
+		uint32_t row = 0;
+		for (int x = 0; x < grid_size; ++x)
+		{
+			row += cells[y * grid_size + x];
+			g.sat[(y + 1) * stride + x + 1] = g.sat[y * stride + x + 1] + row;
+		}
+	}
+}
+
+void hidden_area::clear()
+{
+	grids = {};
+}
+
+// Position in the full size image of each pixel boundary of the foveated image
+static std::vector<int> source_positions(const std::vector<uint16_t> & param)
+{
+	std::vector<int> res{0};
+	int middle = param.size() / 2;
+	for (int i = 0; i < int(param.size()); ++i)
+	{
+		int ratio = 1 + std::abs(i - middle);
+		for (int j = 0; j < param[i]; ++j)
+			res.push_back(res.back() + ratio);
+	}
+	return res;
+}
+
+std::vector<vk::Rect2D> hidden_area::hidden_rects(const std::array<to_headset::foveation_parameter, 2> & foveation) const
+{
+	std::vector<vk::Rect2D> res;
+	int eye_offset = 0;
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		auto x = source_positions(foveation[eye].x);
+		auto y = source_positions(foveation[eye].y);
+		const int eye_width = x.size() - 1;
+		const int eye_height = y.size() - 1;
+		const auto & g = grids[eye];
+
+		if (g.sat.empty() or eye_width == 0 or eye_height == 0)
+		{
+			eye_offset += eye_width;
+			continue;
+		}
+
+		// Convert positions in the full size image to grid cells
+		auto cell_begin = [](int pos, int size) { return pos * grid_size / size - margin; };
+		auto cell_end = [](int pos, int size) { return (pos * grid_size + size - 1) / size + margin; };
+
+		for (int ty = 0; ty < eye_height; ty += tile_size)
+		{
+			int ty1 = std::min(ty + tile_size, eye_height);
+			int cy0 = cell_begin(y[ty], y.back());
+			int cy1 = cell_end(y[ty1], y.back());
+
+			std::optional<vk::Rect2D> run;
+			for (int tx = 0; tx < eye_width; tx += tile_size)
+			{
+				int tx1 = std::min(tx + tile_size, eye_width);
+				int cx0 = cell_begin(x[tx], x.back());
+				int cx1 = cell_end(x[tx1], x.back());
+
+				if (g.count(cx0, cy0, cx1, cy1) == 0 and tx1 - tx >= 2 and ty1 - ty >= 2)
+				{
+					// Chroma is subsampled, keep even sizes
+					uint32_t w = (tx1 - tx) & ~1;
+					if (run)
+						run->extent.width += w;
+					else
+						run = vk::Rect2D{
+						        .offset = {eye_offset + tx, ty},
+						        .extent = {w, uint32_t(ty1 - ty) & ~1},
+						};
+				}
+				else if (run)
+				{
+					res.push_back(*run);
+					run.reset();
+				}
+			}
+			if (run)
+				res.push_back(*run);
+		}
+		eye_offset += eye_width;
+	}
+	return res;
+}
+
+} // namespace wivrn
@@ -0,0 +1,59 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_packets.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace wivrn
+{
+
+// Areas of the foveated image that are not visible through the lenses
+class hidden_area
+{
+	// Visible cells of the full size image of one eye,
+	// stored as a summed area table
+	struct grid
+	{
+		std::vector<uint32_t> sat;
+
+		// Number of visible cells in [x0, x1[ × [y0, y1[
+		uint32_t count(int x0, int y0, int x1, int y1) const;
+	};
+	std::array<grid, 2> grids;
+
+public:
+	// Size of the blanked tiles, in pixels of the foveated image
+	static const int tile_size = 32;
+
+	// Rasterize the visible triangle mesh of one eye, fov is the one of the full size image
+	void set_mask(int eye,
+	              const from_headset::visibility_mask_changed::mask & visible,
+	              const XrFovf & fov);
+	void clear();
+
+	// Rectangles of the foveated image (both eyes side by side) that are hidden
+	std::vector<vk::Rect2D> hidden_rects(const std::array<to_headset::foveation_parameter, 2> & foveation) const;
+};
+
+} // namespace wivrn
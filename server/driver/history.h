@@ -25,6 +25,7 @@
 #include <cstddef>
 #include <mutex>
 #include <openxr/openxr.h>
+#include <optional>
 
 namespace wivrn
 {
@@ -42,6 +43,30 @@ class history
 	std::mutex mutex;
 	XrTime last_request;
 
+	// Closest samples before and after a time, mutex must be locked
+	std::pair<TimedData *, TimedData *> find(XrTime at_timestamp_ns)
+	{
+		TimedData * before = nullptr;
+		TimedData * after = nullptr;
+
+		for (auto & item: data)
+		{
+			if (not item.at_timestamp_ns)
+				continue;
+			if (item.at_timestamp_ns < at_timestamp_ns)
+			{
+				if (not before or before->at_timestamp_ns < item.at_timestamp_ns)
+					before = &item;
+			}
+			else
+			{
+				if (not after or after->at_timestamp_ns > item.at_timestamp_ns)
+					after = &item;
+			}
+		}
+		return {before, after};
+	}
+
 protected:
 	history() :
 	        last_request(os_monotonic_get_ns()) {}
@@ -85,24 +110,7 @@ public:
 
 		last_request = os_monotonic_get_ns();
 
-		TimedData * before = nullptr;
-		TimedData * after = nullptr;
-
-		for (auto & item: data)
-		{
-			if (not item.at_timestamp_ns)
-				continue;
-			if (item.at_timestamp_ns < at_timestamp_ns)
-			{
-				if (not before or before->at_timestamp_ns < item.at_timestamp_ns)
-					before = &item;
-			}
-			else
-			{
-				if (not after or after->at_timestamp_ns > item.at_timestamp_ns)
-					after = &item;
-			}
-		}
+		auto [before, after] = find(at_timestamp_ns);
 
 		XrTime produced = 0;
 		if (after)
@@ -131,6 +139,21 @@ public:
 
 		return {};
 	}
+	// Value between two received samples, without clamping to the closest one.
+	// Does not count as a request.
+	std::optional<Data> get_between(XrTime at_timestamp_ns)
+	{
+		std::lock_guard lock(mutex);
+
+		auto [before, after] = find(at_timestamp_ns);
+		if (not before or not after)
+			return {};
+
+		float t = float(after->at_timestamp_ns - at_timestamp_ns) /
+		          (after->at_timestamp_ns - before->at_timestamp_ns);
+		return Derived::interpolate(*before, *after, t);
+	}
+
 	void reset()
 	{
 		std::lock_guard lock(mutex);
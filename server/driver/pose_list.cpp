@@ -73,7 +73,10 @@ bool pose_list::update_tracking(const from_headset::tracking & tracking, const c
 		if (pose.device != device)
 			continue;
 
-		return add_sample(tracking.production_timestamp, tracking.timestamp, convert_pose(pose), offset);
+		bool active = add_sample(tracking.production_timestamp, tracking.timestamp, convert_pose(pose), offset);
+		if (offset)
+			errors.check(offset.from_headset(tracking.production_timestamp), [this](XrTime t) { return get_between(t); });
+		return active;
 	}
 	return true;
 }
@@ -107,7 +110,9 @@ std::tuple<std::chrono::nanoseconds, xrt_space_relation, device_id> pose_list::g
 		return res;
 	}
 
-	return std::tuple_cat(get_at(at_timestamp_ns), std::make_tuple(device));
+	auto [extrapolation, relation] = get_at(at_timestamp_ns);
+	errors.add(at_timestamp_ns, relation);
+	return {extrapolation, relation, device};
 }
 
 static xrt_space_relation_flags convert_flags(uint8_t flags)
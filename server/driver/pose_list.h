@@ -20,6 +20,7 @@
 #pragma once
 
 #include "history.h"
+#include "prediction_error.h"
 #include "wivrn_packets.h"
 #include "xrt/xrt_defines.h"
 
@@ -34,6 +35,7 @@ class pose_list : public history<pose_list, xrt_space_relation>
 	std::atomic<pose_list *> source = nullptr;
 	xrt_pose offset;
 	std::atomic_bool derive_forced = false;
+	prediction_error errors;
 
 public:
 	const wivrn::device_id device;
@@ -42,7 +44,7 @@ public:
 	static xrt_space_relation extrapolate(const xrt_space_relation & a, const xrt_space_relation & b, int64_t ta, int64_t tb, int64_t t);
 
 	pose_list(wivrn::device_id id) :
-	        device(id) {}
+	        errors(id), device(id) {}
 
 	bool update_tracking(const wivrn::from_headset::tracking &, const clock_offset & offset);
 	void set_derived(pose_list * source, xrt_pose offset, bool force = false);
@@ -0,0 +1,167 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "prediction_error.h"
+
+#include "os/os_time.h"
+#include "utils/quantile_sketch.h"
+#include "utils/tracing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <magic_enum.hpp>
+
+namespace wivrn
+{
+
+namespace
+{
+// Upper bounds of the horizon buckets, in ms
+const std::array<int, 7> horizon_buckets = {0, 10, 20, 30, 40, 60, 80};
+
+// Minimum time between two recorded predictions of a device
+const XrDuration record_period = 5'000'000;
+
+struct bucket
+{
+	utils::quantile_sketch position{0.02, 0.01, 10'000, 1000};
+	utils::quantile_sketch rotation{0.02, 0.001, 180, 1000};
+	uint64_t count = 0;
+};
+
+std::mutex stats_mutex;
+// Key: device, index in horizon_buckets (size() for larger horizons)
+std::map<std::pair<device_id, size_t>, bucket> stats;
+
+std::string device_name(device_id device)
+{
+	std::string name(magic_enum::enum_name(device));
+	std::ranges::transform(name, name.begin(), [](unsigned char c) { return std::tolower(c); });
+	return name;
+}
+
+size_t horizon_bucket(XrDuration horizon)
+{
+	return std::ranges::lower_bound(horizon_buckets, horizon, {}, [](int ms) { return ms * XrDuration(1'000'000); }) - horizon_buckets.begin();
+}
+
+std::string labels(device_id device, size_t bucket)
+{
+	return "device=\"" + device_name(device) + "\",horizon_ms=\"" +
+	       (bucket < horizon_buckets.size() ? std::to_string(horizon_buckets[bucket]) : "+Inf") + "\"";
+}
+} // namespace
+
+prediction_error::prediction_error(device_id device) :
+        device(device),
+        position_counter("pose_position_error_mm." + device_name(device)),
+        rotation_counter("pose_rotation_error_deg." + device_name(device))
+{
+}
+
+void prediction_error::add(XrTime at_timestamp_ns, const xrt_space_relation & relation)
+{
+	if (not(relation.relation_flags & (XRT_SPACE_RELATION_POSITION_VALID_BIT | XRT_SPACE_RELATION_ORIENTATION_VALID_BIT)))
+		return;
+
+	XrTime now = os_monotonic_get_ns();
+	std::lock_guard lock(mutex);
+	if (now < next_record)
+		return;
+	next_record = now + record_period;
+
+	// Overwrite the oldest prediction if they are not checked
+	auto & slot = *std::ranges::min_element(pending, {}, &prediction::at_timestamp_ns);
+	slot = {
+	        .at_timestamp_ns = at_timestamp_ns,
+	        .horizon = at_timestamp_ns - now,
+	        .relation = relation,
+	};
+}
+
+void prediction_error::report(const prediction & p, const xrt_space_relation & actual)
+{
+	auto flags = p.relation.relation_flags & actual.relation_flags;
+	std::optional<double> position;
+	std::optional<double> rotation;
+
+	if (flags & XRT_SPACE_RELATION_POSITION_VALID_BIT)
+	{
+		const auto & a = p.relation.pose.position;
+		const auto & b = actual.pose.position;
+		position = std::hypot(a.x - b.x, a.y - b.y, a.z - b.z) * 1000;
+		WIVRN_TRACE_COUNTER(position_counter.c_str(), *position, p.at_timestamp_ns);
+	}
+
+	if (flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT)
+	{
+		const auto & a = p.relation.pose.orientation;
+		const auto & b = actual.pose.orientation;
+		double dot = std::abs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+		rotation = 2 * std::acos(std::min(dot, 1.)) * 180 / M_PI;
+		WIVRN_TRACE_COUNTER(rotation_counter.c_str(), *rotation, p.at_timestamp_ns);
+	}
+
+	if (not position and not rotation)
+		return;
+
+	std::lock_guard lock(stats_mutex);
+	auto & b = stats[{device, horizon_bucket(p.horizon)}];
+	if (position)
+		b.position.add(*position);
+	if (rotation)
+		b.rotation.add(*rotation);
+	++b.count;
+}
+
+void prediction_error::snapshot(std::vector<from_monado::statistic> & out)
+{
+	std::lock_guard lock(stats_mutex);
+
+	// Samples of a metric are kept together
+	for (auto [name, member]: {
+	             std::pair{"pose_position_error_mm", &bucket::position},
+	             {"pose_rotation_error_deg", &bucket::rotation},
+	     })
+	{
+		for (const auto & [key, b]: stats)
+		{
+			if ((b.*member).size() == 0)
+				continue;
+			for (auto [label, q]: {std::pair{"0.5", 0.5}, {"0.9", 0.9}, {"0.99", 0.99}})
+			{
+				out.push_back({
+				        .name = std::string(name) + "{" + labels(key.first, key.second) + ",quantile=\"" + label + "\"}",
+				        .value = (b.*member).quantile(q),
+				});
+			}
+		}
+	}
+
+	for (const auto & [key, b]: stats)
+		out.push_back({"pose_predictions_total{" + labels(key.first, key.second) + "}", double(b.count)});
+}
+
+void prediction_error::reset()
+{
+	std::lock_guard lock(stats_mutex);
+	stats.clear();
+}
+
+} // namespace wivrn
@@ -0,0 +1,95 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_ipc.h"
+#include "wivrn_packets.h"
+#include "xrt/xrt_defines.h"
+
+#include <array>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <openxr/openxr.h>
+
+namespace wivrn
+{
+
+// Error of the poses given to the applications, compared to the pose received
+// later for the same time, once the headset has tracked past that time.
+// Errors are aggregated per device and per prediction horizon (time between
+// the request and the requested time), for the statistics and the traces.
+class prediction_error
+{
+	struct prediction
+	{
+		XrTime at_timestamp_ns = 0;
+		XrDuration horizon;
+		xrt_space_relation relation;
+	};
+
+	const device_id device;
+	const std::string position_counter;
+	const std::string rotation_counter;
+
+	std::mutex mutex;
+	std::array<prediction, 32> pending{};
+	XrTime next_record = 0;
+
+	void report(const prediction &, const xrt_space_relation & actual);
+
+public:
+	prediction_error(device_id device);
+
+	// Record a pose returned for at_timestamp_ns, only some of them are kept
+	void add(XrTime at_timestamp_ns, const xrt_space_relation & relation);
+
+	// Compare the predictions up to the time tracked by the headset with the
+	// received poses, get_actual returns an empty optional if it has no pose
+	template <typename F>
+	void check(XrTime tracked, F && get_actual)
+	{
+		decltype(pending) ready;
+		size_t count = 0;
+		{
+			std::lock_guard lock(mutex);
+			for (auto & p: pending)
+			{
+				if (p.at_timestamp_ns and p.at_timestamp_ns <= tracked)
+				{
+					ready[count++] = p;
+					p.at_timestamp_ns = 0;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (std::optional<xrt_space_relation> actual = get_actual(ready[i].at_timestamp_ns))
+				report(ready[i], *actual);
+		}
+	}
+
+	// Percentiles of the errors for all devices
+	static void snapshot(std::vector<from_monado::statistic> & out);
+	static void reset();
+};
+
+} // namespace wivrn
@@ -0,0 +1,124 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "session_stats.h"
+#include "prediction_error.h"
+
+#include <string>
+
+namespace wivrn
+{
+
+namespace
+{
+// Durations in ms
+utils::quantile_sketch make_sketch(size_t window)
+{
+	return utils::quantile_sketch(0.01, 0.01, 10'000, window);
+}
+
+void add_percentiles(std::vector<from_monado::statistic> & out, const char * name, const utils::quantile_sketch & sketch)
+{
+	for (auto [label, q]: {std::pair{"0.5", 0.5}, {"0.9", 0.9}, {"0.99", 0.99}})
+	{
+		out.push_back({
+		        .name = std::string(name) + "{quantile=\"" + label + "\"}",
+		        .value = sketch.quantile(q),
+		});
+	}
+}
+} // namespace
+
+session_stats::session_stats() :
+        encode(make_sketch(window)),
+        network(make_sketch(window)),
+        decode(make_sketch(window)),
+        latency(make_sketch(window)),
+        last_snapshot(std::chrono::steady_clock::now())
+{
+	prediction_error::reset();
+}
+
+void session_stats::on_feedback(const from_headset::feedback & feedback)
+{
+	// Feedback for a frame is sent when it is received, then when it is
+	// displayed or dropped
+	bool incomplete = feedback.received_first_packet and not feedback.received_last_packet;
+	bool skipped = feedback.received_from_decoder and not feedback.blitted;
+	if (incomplete or skipped)
+	{
+		++lost_frames;
+		return;
+	}
+
+	if (feedback.times_displayed == 0 or not feedback.blitted)
+		return;
+
+	++frames;
+	if (feedback.stream_index == 0)
+	{
+		++displays;
+		if (feedback.times_displayed > 1)
+			++repeated_frames;
+	}
+
+	auto ms = [](XrTime begin, XrTime end) { return (end - begin) / 1e6; };
+	if (feedback.encode_begin and feedback.encode_end)
+		encode.add(ms(feedback.encode_begin, feedback.encode_end));
+	if (feedback.send_begin and feedback.received_last_packet)
+		network.add(ms(feedback.send_begin, feedback.received_last_packet));
+	if (feedback.sent_to_decoder and feedback.received_from_decoder)
+		decode.add(ms(feedback.sent_to_decoder, feedback.received_from_decoder));
+	if (feedback.encode_begin)
+		latency.add(ms(feedback.encode_begin, feedback.blitted));
+}
+
+std::vector<from_monado::statistic> session_stats::snapshot(uint64_t bytes_sent, const pacing & p)
+{
+	auto now = std::chrono::steady_clock::now();
+	double period = std::chrono::duration<double>(now - last_snapshot).count();
+
+	std::vector<from_monado::statistic> result;
+	add_percentiles(result, "encode_ms", encode);
+	add_percentiles(result, "network_ms", network);
+	add_percentiles(result, "decode_ms", decode);
+	add_percentiles(result, "latency_ms", latency);
+
+	uint64_t new_frames = frames - last_frames;
+	uint64_t new_lost_frames = lost_frames - last_lost_frames;
+	result.push_back({"fps", period > 0 ? (displays - last_displays) / period : 0});
+	result.push_back({"loss_rate", new_frames + new_lost_frames ? double(new_lost_frames) / (new_frames + new_lost_frames) : 0});
+	result.push_back({"bitrate_mbps", period > 0 ? (bytes_sent - last_bytes_sent) * 8e-6 / period : 0});
+	result.push_back({"frames_total", double(frames)});
+	result.push_back({"lost_frames_total", double(lost_frames)});
+	result.push_back({"repeated_frames_total", double(repeated_frames)});
+	result.push_back({"idr_frames_total", double(idr_frames)});
+	result.push_back({"sent_bytes_total", double(bytes_sent)});
+	result.push_back({"pacer_miss_rate", p.miss_rate});
+	result.push_back({"pacer_margin_ms", p.margin_ns / 1e6});
+	prediction_error::snapshot(result);
+
+	last_snapshot = now;
+	last_frames = frames;
+	last_displays = displays;
+	last_lost_frames = lost_frames;
+	last_bytes_sent = bytes_sent;
+	return result;
+}
+
+} // namespace wivrn
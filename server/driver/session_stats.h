@@ -0,0 +1,81 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "utils/quantile_sketch.h"
+#include "wivrn_ipc.h"
+#include "wivrn_packets.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace wivrn
+{
+
+// Statistics of the stream, published on D-Bus about once per second.
+// Durations are percentiles over the last frames, counters are totals since
+// the session started, rates are computed over the last period.
+class session_stats
+{
+	static constexpr size_t window = 1000;
+
+	utils::quantile_sketch encode;
+	utils::quantile_sketch network;
+	utils::quantile_sketch decode;
+	utils::quantile_sketch latency;
+
+	// Frames displayed, on all streams and on the first one
+	uint64_t frames = 0;
+	uint64_t displays = 0;
+	uint64_t lost_frames = 0;
+	uint64_t repeated_frames = 0;
+	std::atomic<uint64_t> idr_frames = 0;
+
+	// Values at the previous snapshot, for rates
+	std::chrono::steady_clock::time_point last_snapshot;
+	uint64_t last_frames = 0;
+	uint64_t last_displays = 0;
+	uint64_t last_lost_frames = 0;
+	uint64_t last_bytes_sent = 0;
+
+public:
+	struct pacing
+	{
+		double miss_rate;
+		int64_t margin_ns;
+	};
+
+	session_stats();
+
+	// Called from the network thread
+	void on_feedback(const from_headset::feedback & feedback);
+
+	// Called from the encoder threads
+	void on_idr()
+	{
+		++idr_frames;
+	}
+
+	// Called from the network thread
+	std::vector<from_monado::statistic> snapshot(uint64_t bytes_sent, const pacing &);
+};
+
+} // namespace wivrn
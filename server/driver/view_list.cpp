@@ -56,8 +56,23 @@ bool view_list::update_tracking(const from_headset::tracking & tracking, const c
 			view.fovs[eye] = xrt_cast(tracking.views[eye].fov);
 		}
 
-		return add_sample(tracking.production_timestamp, tracking.timestamp, view, offset);
+		bool active = add_sample(tracking.production_timestamp, tracking.timestamp, view, offset);
+		if (offset)
+			errors.check(offset.from_headset(tracking.production_timestamp), [this](XrTime t) {
+				std::optional<xrt_space_relation> relation;
+				if (auto view = get_between(t))
+					relation = view->relation;
+				return relation;
+			});
+		return active;
 	}
 	return true;
 }
+
+std::pair<std::chrono::nanoseconds, tracked_views> view_list::get_view_at(XrTime at_timestamp_ns)
+{
+	auto res = get_at(at_timestamp_ns);
+	errors.add(at_timestamp_ns, res.second.relation);
+	return res;
+}
 } // namespace wivrn
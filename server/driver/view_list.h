@@ -37,10 +37,14 @@ struct tracked_views
 
 class view_list : public history<view_list, tracked_views>
 {
+	prediction_error errors{device_id::HEAD};
+
 public:
 	static tracked_views interpolate(const tracked_views & a, const tracked_views & b, float t);
 	static tracked_views extrapolate(const tracked_views & a, const tracked_views & b, int64_t ta, int64_t tb, int64_t t);
 
 	bool update_tracking(const from_headset::tracking & tracking, const clock_offset & offset);
+
+	std::pair<std::chrono::nanoseconds, tracked_views> get_view_at(XrTime at_timestamp_ns);
 };
 } // namespace wivrn
@@ -19,18 +19,24 @@
 
 #include "wivrn_comp_target.h"
 
+#include "driver/configuration.h"
 #include "driver/wivrn_session.h"
+#include "encoder/probe_cache.h"
 #include "encoder/video_encoder.h"
 #include "util/u_logging.h"
 #include "utils/scoped_lock.h"
+#include "utils/thread_profile.h"
+#include "utils/tracing.h"
 #include "wivrn_config.h"
 #include "wivrn_foveation.h"
 
 #include "main/comp_compositor.h"
 #include "math/m_space.h"
+#include "os/os_time.h"
 #include "xrt_cast.h"
 
 #include <algorithm>
+#include <cstring>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_core.h>
@@ -117,12 +123,14 @@ static void destroy_images(struct wivrn_comp_target * cn)
 	if (cn->wivrn_bundle)
 		cn->wivrn_bundle->device.waitIdle();
 
-	cn->psc.status = 1;
-	cn->psc.status.notify_all();
+	cn->psc.submitted |= 1;
+	cn->psc.submitted.notify_all();
 	cn->encoder_threads.clear();
 	cn->encoders.clear();
 
+	cn->psc.frames.reset();
 	cn->psc.images.clear();
+	cn->psc.blank = {};
 
 	free(cn->images);
 	cn->images = NULL;
@@ -130,7 +138,7 @@ static void destroy_images(struct wivrn_comp_target * cn)
 	target_fini_semaphores(cn);
 }
 
-static void comp_wivrn_present_thread(std::stop_token stop_token, wivrn_comp_target * cn, int index, std::vector<std::shared_ptr<video_encoder>> encoders);
+static void comp_wivrn_present_thread(std::stop_token stop_token, wivrn_comp_target * cn, int index, std::string name, std::vector<std::shared_ptr<video_encoder>> encoders);
 
 static void create_encoders(wivrn_comp_target * cn)
 {
@@ -138,7 +146,9 @@ static void create_encoders(wivrn_comp_target * cn)
 	assert(cn->encoders.empty());
 	assert(cn->encoder_threads.empty());
 	assert(cn->wivrn_bundle);
-	cn->psc.status = 0;
+	cn->psc.submitted = 0;
+	cn->psc.last_hash.reset();
+	cn->psc.repeated = 0;
 
 	to_headset::video_stream_description & desc = cn->desc;
 	desc.width = cn->width;
@@ -151,26 +161,35 @@ static void create_encoders(wivrn_comp_target * cn)
 
 	uint32_t bitrate = 0;
 
-	for (auto & settings: cn->settings)
+	try
 	{
-		bitrate += settings.bitrate;
-		uint8_t stream_index = cn->encoders.size();
-		auto & encoder = cn->encoders.emplace_back(
-		        video_encoder::create(*cn->wivrn_bundle, settings, stream_index, desc.width, desc.height, desc.fps));
-		desc.items.push_back(settings);
-
-		thread_params[settings.group].emplace_back(encoder);
+		for (auto & settings: cn->settings)
+		{
+			bitrate += settings.bitrate;
+			uint8_t stream_index = cn->encoders.size();
+			settings.pipeline_depth = cn->psc.depth;
+			auto & encoder = cn->encoders.emplace_back(
+			        video_encoder::create(*cn->wivrn_bundle, settings, stream_index, desc.width, desc.height, desc.fps));
+			desc.items.push_back(settings);
+
+			thread_params[settings.group].emplace_back(encoder);
+		}
+	}
+	catch (...)
+	{
+		// Encoders may have been selected from outdated probe results
+		probe_cache::clear();
+		throw;
 	}
 	wivrn_ipc_socket_monado->send(from_monado::bitrate_changed{bitrate});
 
 	for (auto & [group, params]: thread_params)
 	{
-		auto & thread = cn->encoder_threads.emplace_back(
-		        comp_wivrn_present_thread, cn, cn->encoder_threads.size(), std::move(params));
-		std::string name = "encoder " + std::to_string(group);
-		pthread_setname_np(thread.native_handle(), name.c_str());
+		cn->encoder_threads.emplace_back(
+		        comp_wivrn_present_thread, cn, cn->encoder_threads.size(), "encoder " + std::to_string(group), std::move(params));
 	}
 	cn->cnx.send_control(to_headset::video_stream_description{desc});
+	cn->cnx.startup_step("encoders created");
 }
 
 static VkResult create_images(struct wivrn_comp_target * cn, vk::ImageUsageFlags flags)
@@ -227,6 +246,8 @@ static VkResult create_images(struct wivrn_comp_target * cn, vk::ImageUsageFlags
 		image_info.get().usage |= vk::ImageUsageFlagBits::eVideoEncodeSrcKHR;
 	}
 #endif
+	if (cn->hidden.enabled or configuration().synthetic_source)
+		image_info.get().usage |= vk::ImageUsageFlagBits::eTransferDst;
 
 	cn->psc.images.resize(cn->image_count);
 	for (uint32_t i = 0; i < cn->image_count; i++)
@@ -276,13 +297,111 @@ static VkResult create_images(struct wivrn_comp_target * cn, vk::ImageUsageFlags
 		cn->wivrn_bundle->name(item.image_view_cbcr, "comp target image view (CbCr)");
 	}
 
-	cn->psc.fence = vk::raii::Fence(device, vk::FenceCreateInfo{.flags = vk::FenceCreateFlagBits::eSignaled});
-	cn->wivrn_bundle->name(cn->psc.fence, "comp target fence");
-
-	cn->psc.command_buffer = std::move(device.allocateCommandBuffers(
+	cn->psc.frames = std::make_unique<pseudo_swapchain::frame[]>(cn->psc.depth);
+	auto command_buffers = device.allocateCommandBuffers(
 	        {.commandPool = *cn->command_pool,
-	         .commandBufferCount = 1})[0]);
-	cn->wivrn_bundle->name(cn->psc.command_buffer, "comp target command buffer");
+	         .commandBufferCount = cn->psc.depth});
+	for (uint32_t i = 0; i < cn->psc.depth; i++)
+	{
+		auto & frame = cn->psc.frames[i];
+		frame.status = 0;
+		frame.fence = vk::raii::Fence(device, vk::FenceCreateInfo{.flags = vk::FenceCreateFlagBits::eSignaled});
+		cn->wivrn_bundle->name(frame.fence, std::format("comp target fence {}", i));
+		frame.command_buffer = std::move(command_buffers[i]);
+		cn->wivrn_bundle->name(frame.command_buffer, std::format("comp target command buffer {}", i));
+	}
+
+	// Sample small tiles of the luma plane on a regular grid to detect unchanged frames
+	const uint32_t grid_x = 64;
+	const uint32_t grid_y = 32;
+	const vk::Extent3D tile{16, 2, 1};
+	const vk::DeviceSize tile_size = tile.width * tile.height * (is_10bit ? 2 : 1);
+	for (auto & regions: cn->psc.sample_regions)
+		regions.clear();
+	cn->psc.sample_layer_size = 0;
+	if (cn->max_repeated_frames > 0 and cn->width >= grid_x * tile.width and cn->height >= grid_y * tile.height)
+	{
+		for (uint32_t layer = 0; layer < 2; ++layer)
+		{
+			auto & regions = cn->psc.sample_regions[layer];
+			for (uint32_t y = 0; y < grid_y; ++y)
+			{
+				for (uint32_t x = 0; x < grid_x; ++x)
+				{
+					regions.push_back(vk::BufferImageCopy{
+					        .bufferOffset = ((layer * grid_y + y) * grid_x + x) * tile_size,
+					        .imageSubresource = {
+					                .aspectMask = vk::ImageAspectFlagBits::ePlane0,
+					                .baseArrayLayer = layer,
+					                .layerCount = 1,
+					        },
+					        .imageOffset = {
+					                .x = int32_t(((2 * x + 1) * cn->width / grid_x - tile.width) / 2),
+					                .y = int32_t(((2 * y + 1) * cn->height / grid_y - tile.height) / 2),
+					        },
+					        .imageExtent = tile,
+					});
+				}
+			}
+		}
+		cn->psc.sample_layer_size = grid_x * grid_y * tile_size;
+
+		for (uint32_t i = 0; i < cn->psc.depth; i++)
+		{
+			cn->psc.frames[i].samples = buffer_allocation(
+			        device,
+			        {
+			                .size = 2 * cn->psc.sample_layer_size,
+			                .usage = vk::BufferUsageFlagBits::eTransferDst,
+			        },
+			        {
+			                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+			                .usage = VMA_MEMORY_USAGE_AUTO,
+			        },
+			        std::format("comp target samples {}", i));
+		}
+	}
+
+	if (cn->hidden.enabled)
+	{
+		// Black, with full range: luma 0, chroma at the middle of the range
+		const vk::DeviceSize bytes = is_10bit ? 2 : 1;
+		const vk::DeviceSize luma_size = cn->width * hidden_area::tile_size * bytes;
+		const vk::DeviceSize chroma_size = (cn->width / 2) * (hidden_area::tile_size / 2) * 2 * bytes;
+		cn->psc.blank = buffer_allocation(
+		        device,
+		        {
+		                .size = luma_size + chroma_size,
+		                .usage = vk::BufferUsageFlagBits::eTransferSrc,
+		        },
+		        {
+		                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+		                .usage = VMA_MEMORY_USAGE_AUTO,
+		        },
+		        "comp target blank");
+		auto data = (uint8_t *)cn->psc.blank.map();
+		std::fill_n(data, luma_size, 0);
+		if (is_10bit)
+			std::fill_n((uint16_t *)(data + luma_size), chroma_size / 2, 512 << 6);
+		else
+			std::fill_n(data + luma_size, chroma_size, 128);
+		cn->psc.blank_chroma_offset = luma_size;
+		// Image size may have changed
+		cn->hidden.mask_version = -1;
+	}
+
+	cn->generator.reset();
+	if (const auto & synthetic = configuration().synthetic_source)
+	{
+		try
+		{
+			cn->generator.emplace(*cn->wivrn_bundle, *synthetic, cn->width, cn->height, format, cn->psc.depth);
+		}
+		catch (std::exception & e)
+		{
+			U_LOG_E("Failed to create synthetic source: %s", e.what());
+		}
+	}
 
 	return VK_SUCCESS;
 }
@@ -323,6 +442,7 @@ static bool comp_wivrn_init_post_vulkan(struct comp_target * ct, uint32_t prefer
 		        cn->c->settings.preferred.height,
 		        cn->cnx.get_info());
 		print_encoders(cn->settings);
+		cn->cnx.startup_step("encoder settings selected");
 	}
 	catch (const std::exception & e)
 	{
@@ -423,7 +543,11 @@ static void comp_wivrn_create_images(struct comp_target * ct, const struct comp_
 	ct->height = create_info->extent.height;
 	ct->surface_transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 
-	cn->image_count = 3;
+	// Number of frames that can be submitted before encoders are done with the oldest one
+	cn->psc.depth = std::clamp<int>(configuration().pipeline_depth, 1, video_encoder::max_slots);
+	// One more image for the compositor to render into
+	cn->image_count = cn->psc.depth + 1;
+	U_LOG_I("Encoder pipeline depth: %u", cn->psc.depth);
 	cn->color_space = create_info->color_space;
 
 	VkResult res = create_images(cn, vk::ImageUsageFlags(create_info->image_usage));
@@ -459,40 +583,161 @@ static VkResult comp_wivrn_acquire(struct comp_target * ct, uint32_t * out_index
 	};
 }
 
-static void comp_wivrn_present_thread(std::stop_token stop_token, wivrn_comp_target * cn, int index, std::vector<std::shared_ptr<video_encoder>> encoders)
+static uint64_t hash_samples(pseudo_swapchain::frame & frame, size_t layer_size, bool alpha)
+{
+	auto data = (const uint64_t *)frame.samples.map();
+	size_t size = (alpha ? 2 : 1) * layer_size / sizeof(uint64_t);
+
+	uint64_t hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ data[i]) * 0x100000001b3;
+	return hash;
+}
+
+// True if an image rendered for a can be displayed with b
+static bool same_projection(const to_headset::video_stream_data_shard::view_info_t & a,
+                            const to_headset::video_stream_data_shard::view_info_t & b)
+{
+	if (a.alpha != b.alpha)
+		return false;
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		if (std::memcmp(&a.fov[eye], &b.fov[eye], sizeof(XrFovf)))
+			return false;
+		if (a.foveation[eye].x != b.foveation[eye].x or a.foveation[eye].y != b.foveation[eye].y)
+			return false;
+	}
+	return true;
+}
+
+static void update_hidden_regions(wivrn_comp_target * cn, const to_headset::video_stream_data_shard::view_info_t & view_info)
+{
+	auto & hidden = cn->hidden;
+	auto & hmd = cn->cnx.get_hmd();
+
+	bool changed = false;
+	if (auto version = hmd.get_visibility_mask_version();
+	    version != hidden.mask_version or std::memcmp(hidden.fov.data(), view_info.fov.data(), sizeof(hidden.fov)))
+	{
+		auto masks = hmd.get_visible_triangles();
+		for (int eye = 0; eye < 2; ++eye)
+			hidden.area.set_mask(eye, masks[eye], view_info.fov[eye]);
+		hidden.mask_version = version;
+		hidden.fov = view_info.fov;
+		changed = true;
+	}
+
+	for (int eye = 0; eye < 2; ++eye)
+		changed |= hidden.foveation[eye].x != view_info.foveation[eye].x or hidden.foveation[eye].y != view_info.foveation[eye].y;
+
+	if (not changed)
+		return;
+
+	hidden.foveation = view_info.foveation;
+	hidden.regions.clear();
+	for (const auto & rect: hidden.area.hidden_rects(view_info.foveation))
+	{
+		if (uint32_t(rect.offset.x) + rect.extent.width > cn->width or uint32_t(rect.offset.y) + rect.extent.height > cn->height)
+			continue;
+		hidden.regions.push_back(vk::BufferImageCopy{
+		        .imageSubresource = {
+		                .aspectMask = vk::ImageAspectFlagBits::ePlane0,
+		                .layerCount = 1,
+		        },
+		        .imageOffset = {
+		                .x = rect.offset.x,
+		                .y = rect.offset.y,
+		        },
+		        .imageExtent = {
+		                .width = rect.extent.width,
+		                .height = rect.extent.height,
+		                .depth = 1,
+		        },
+		});
+		hidden.regions.push_back(vk::BufferImageCopy{
+		        .bufferOffset = cn->psc.blank_chroma_offset,
+		        .imageSubresource = {
+		                .aspectMask = vk::ImageAspectFlagBits::ePlane1,
+		                .layerCount = 1,
+		        },
+		        .imageOffset = {
+		                .x = rect.offset.x / 2,
+		                .y = rect.offset.y / 2,
+		        },
+		        .imageExtent = {
+		                .width = rect.extent.width / 2,
+		                .height = rect.extent.height / 2,
+		                .depth = 1,
+		        },
+		});
+	}
+}
+
+static void comp_wivrn_present_thread(std::stop_token stop_token, wivrn_comp_target * cn, int index, std::string name, std::vector<std::shared_ptr<video_encoder>> encoders)
 {
 	auto & vk = *cn->wivrn_bundle;
+	pthread_setname_np(pthread_self(), name.c_str());
 	U_LOG_I("Starting encoder thread %d", index);
+	apply_thread_profile(thread_role::encoder);
 
-	const uint8_t status_bit = 1 << (index + 1);
+	const uint64_t status_bit = uint64_t(1) << index;
+	// Sequence number of the next frame to encode
+	uint64_t next = 0;
 
 	while (not stop_token.stop_requested())
 	{
 		{
-			auto status = cn->psc.status.load();
+			auto submitted = cn->psc.submitted.load();
 			// Bit 0 to request exit
-			if (status & 1)
+			if (submitted & 1)
 				return;
 
-			if (not(status & status_bit))
+			if ((submitted >> 1) <= next)
 			{
-				cn->psc.status.wait(status);
+				cn->psc.submitted.wait(submitted);
 				continue;
 			}
 		}
 
-		// Get local copies before releasing the image
-		auto view_info = cn->psc.view_info;
-		auto frame_index = cn->psc.frame_index;
+		auto & frame = cn->psc.frames[next++ % cn->psc.depth];
+		assert(frame.status & status_bit);
 
-		auto res = vk.device.waitForFences(*cn->psc.fence, true, UINT64_MAX);
+		// Get local copies, the compositor may not reuse the frame until we are done
+		auto view_info = frame.view_info;
+		auto frame_index = frame.frame_index;
+
+		auto res = vk.device.waitForFences(*frame.fence, true, UINT64_MAX);
+
+		bool unchanged = false;
+		if (frame.samples)
+		{
+			// Frames are handled in order by each thread, so the previous
+			// frame was already hashed by the first thread that got it
+			auto & psc = cn->psc;
+			std::lock_guard lock(psc.unchanged_mutex);
+			if (not frame.unchanged)
+			{
+				uint64_t hash = hash_samples(frame, psc.sample_layer_size, view_info.alpha);
+				frame.unchanged = psc.last_hash == hash and
+				                  psc.repeated < cn->max_repeated_frames and
+				                  same_projection(view_info, psc.last_view_info);
+				psc.repeated = *frame.unchanged ? psc.repeated + 1 : 0;
+				psc.last_hash = hash;
+				psc.last_view_info = view_info;
+			}
+			unchanged = *frame.unchanged;
+		}
 
 		try
 		{
 			for (auto & encoder: encoders)
 			{
 				if (encoder->channels == to_headset::video_stream_description::channels_t::colour or view_info.alpha)
-					encoder->encode(cn->cnx, view_info, frame_index);
+				{
+					bool repeat = encoder->encode(cn->cnx, view_info, frame_index, unchanged);
+					if (repeat and encoder->stream_idx == 0)
+						cn->pacer.on_repeated_frame(frame_index);
+				}
 			}
 		}
 		catch (std::exception & e)
@@ -505,17 +750,10 @@ static void comp_wivrn_present_thread(std::stop_token stop_token, wivrn_comp_tar
 		}
 
 		// Update encoder status, release image
-		if ((cn->psc.status &= ~status_bit) == 0)
+		if ((frame.status &= ~status_bit) == 0)
 		{
-			cn->psc.status.notify_all();
-			for (auto & img: cn->psc.images)
-			{
-				if (img.status == pseudo_swapchain::status_t::encoding)
-				{
-					img.status = pseudo_swapchain::status_t::free;
-					break;
-				}
-			}
+			cn->psc.images[frame.image_index].status = pseudo_swapchain::status_t::free;
+			frame.status.notify_all();
 		}
 	}
 }
@@ -528,12 +766,12 @@ static VkResult comp_wivrn_present(struct comp_target * ct,
                                    int64_t present_slop_ns)
 {
 	struct wivrn_comp_target * cn = (struct wivrn_comp_target *)ct;
+	WIVRN_TRACE_SCOPE("present");
 
 	assert(index < cn->image_count);
 	assert(cn->psc.images[index].status == pseudo_swapchain::status_t::acquired);
 
 	struct vk_bundle * vk = get_vk(cn);
-	auto res = cn->wivrn_bundle->device.waitForFences(*cn->psc.fence, true, UINT64_MAX);
 
 	vk::Semaphore wait_semaphore(cn->semaphores.render_complete);
 	vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTransfer;
@@ -543,7 +781,8 @@ static VkResult comp_wivrn_present(struct comp_target * ct,
 	        .pWaitDstStageMask = &wait_stage,
 	};
 
-	if (cn->c->base.layer_accum.layer_count == 0 or not cn->cnx.get_offset())
+	// Without an application the compositor output is not sent, unless it is replaced by generated frames
+	if ((cn->c->base.layer_accum.layer_count == 0 and not cn->generator) or not cn->cnx.get_offset())
 	{
 		scoped_lock lock(vk->main_queue->mutex);
 		cn->wivrn_bundle->queue.submit(submit_info);
@@ -551,22 +790,94 @@ static VkResult comp_wivrn_present(struct comp_target * ct,
 		return VK_SUCCESS;
 	}
 
-	auto & command_buffer = cn->psc.command_buffer;
+	// Only the compositor thread increments the counter
+	const uint64_t sequence = cn->psc.submitted.load() >> 1;
+	auto & frame = cn->psc.frames[sequence % cn->psc.depth];
+	const auto & previous_frame = cn->psc.frames[(sequence + cn->psc.depth - 1) % cn->psc.depth];
+	auto & command_buffer = frame.command_buffer;
 	auto & psc_image = cn->psc.images[index];
+	auto info = cn->pacer.present_to_info(desired_present_time_ns);
 
-	// Wait for encoders to be done with previous frame
-	for (auto status = cn->psc.status.load(); status != 0; status = cn->psc.status)
-		cn->psc.status.wait(status);
+	// Wait for encoders to be done with the frame that last used this slot,
+	// with a single slot this is the previous frame.
+	for (auto status = frame.status.load(); status != 0; status = frame.status)
+		frame.status.wait(status);
+	auto res = cn->wivrn_bundle->device.waitForFences(*frame.fence, true, UINT64_MAX);
+	// Time spent here is the lack of headroom in the encoders
+	cn->cnx.dump_time(flight_recorder::event::slot_ready, info.frame_id, os_monotonic_get_ns());
 
 	command_buffer.reset();
 	command_buffer.begin(vk::CommandBufferBeginInfo{
 	        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
 	});
 
-	cn->wivrn_bundle->device.resetFences(*cn->psc.fence);
+	cn->wivrn_bundle->device.resetFences(*frame.fence);
 	psc_image.status = pseudo_swapchain::status_t::encoding;
-	auto info = cn->pacer.present_to_info(desired_present_time_ns);
-	const bool do_alpha = cn->c->base.layer_accum.data.env_blend_mode == XRT_BLEND_MODE_ALPHA_BLEND;
+	const bool do_alpha = cn->c->base.layer_accum.data.env_blend_mode == XRT_BLEND_MODE_ALPHA_BLEND and not cn->generator;
+
+	auto & view_info = frame.view_info;
+	view_info.foveation = cn->foveation->get_parameters();
+	view_info.display_time = cn->cnx.get_offset().to_headset(info.predicted_display_time);
+	if (previous_frame.view_info.alpha != do_alpha)
+		cn->pacer.reset();
+	view_info.alpha = do_alpha;
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		const auto & frame_params = cn->c->base.frame_params;
+		view_info.fov[eye] = xrt_cast(frame_params.fovs[eye]);
+		view_info.pose[eye] = xrt_cast(frame_params.poses[eye]);
+		if (cn->c->debug.atw_off and not cn->generator)
+		{
+			const auto & proj = cn->c->base.layer_accum.layers[0].data.proj;
+			view_info.pose[eye] = xrt_cast(proj.v[eye].pose);
+			view_info.fov[eye] = xrt_cast(proj.v[eye].fov);
+		}
+		else
+		{
+			xrt_relation_chain xrc{};
+			xrt_space_relation result{};
+			m_relation_chain_push_pose_if_not_identity(&xrc, &frame_params.poses[eye]);
+			m_relation_chain_resolve(&xrc, &result);
+			view_info.pose[eye] = xrt_cast(result.pose);
+		}
+	}
+
+	if (cn->generator)
+		cn->generator->record(command_buffer, psc_image.image, sequence % cn->psc.depth);
+
+	if (cn->hidden.enabled)
+		update_hidden_regions(cn, view_info);
+
+	if (not cn->hidden.regions.empty())
+	{
+		// Overwrite pixels that are not visible with a flat colour, cheap to encode
+		vk::ImageMemoryBarrier barrier{
+		        .srcAccessMask = vk::AccessFlagBits::eNone,
+		        .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+		        .oldLayout = vk::ImageLayout::eTransferSrcOptimal,
+		        .newLayout = vk::ImageLayout::eTransferDstOptimal,
+		        .image = psc_image.image,
+		        .subresourceRange = {
+		                .aspectMask = vk::ImageAspectFlagBits::eColor,
+		                .levelCount = 1,
+		                .layerCount = 1,
+		        },
+		};
+		command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+		command_buffer.copyBufferToImage(cn->psc.blank, psc_image.image, vk::ImageLayout::eTransferDstOptimal, cn->hidden.regions);
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+		command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+	}
+
+	if (frame.samples)
+	{
+		command_buffer.copyImageToBuffer(psc_image.image, vk::ImageLayout::eTransferSrcOptimal, frame.samples, cn->psc.sample_regions[0]);
+		if (do_alpha)
+			command_buffer.copyImageToBuffer(psc_image.image, vk::ImageLayout::eTransferSrcOptimal, frame.samples, cn->psc.sample_regions[1]);
+	}
 
 	bool need_queue_transfer = false;
 	std::vector<vk::Semaphore> present_done_sem;
@@ -612,7 +923,7 @@ static VkResult comp_wivrn_present(struct comp_target * ct,
 
 	{
 		scoped_lock lock(vk->main_queue->mutex);
-		cn->wivrn_bundle->queue.submit(submit_info, *cn->psc.fence);
+		cn->wivrn_bundle->queue.submit(submit_info, *frame.fence);
 		for (auto & encoder: cn->encoders)
 		{
 			if (encoder->channels == to_headset::video_stream_description::channels_t::alpha and not do_alpha)
@@ -626,36 +937,13 @@ static VkResult comp_wivrn_present(struct comp_target * ct,
 		r->EndFrameCapture(NULL, NULL);
 #endif
 
-	auto & view_info = cn->psc.view_info;
-	view_info.foveation = cn->foveation->get_parameters();
-	view_info.display_time = cn->cnx.get_offset().to_headset(info.predicted_display_time);
-	if (view_info.alpha != do_alpha)
-		cn->pacer.reset();
-	view_info.alpha = do_alpha;
-	for (int eye = 0; eye < 2; ++eye)
-	{
-		const auto & frame_params = cn->c->base.frame_params;
-		view_info.fov[eye] = xrt_cast(frame_params.fovs[eye]);
-		view_info.pose[eye] = xrt_cast(frame_params.poses[eye]);
-		if (cn->c->debug.atw_off)
-		{
-			const auto & proj = cn->c->base.layer_accum.layers[0].data.proj;
-			view_info.pose[eye] = xrt_cast(proj.v[eye].pose);
-			view_info.fov[eye] = xrt_cast(proj.v[eye].fov);
-		}
-		else
-		{
-			xrt_relation_chain xrc{};
-			xrt_space_relation result{};
-			m_relation_chain_push_pose_if_not_identity(&xrc, &frame_params.poses[eye]);
-			m_relation_chain_resolve(&xrc, &result);
-			view_info.pose[eye] = xrt_cast(result.pose);
-		}
-	}
-	// set bits to 1 for index 1..num encoder threads + 1
-	cn->psc.status = (1 << (cn->encoder_threads.size() + 1)) - 2;
-	cn->psc.frame_index = info.frame_id;
-	cn->psc.status.notify_all();
+	frame.image_index = index;
+	frame.frame_index = info.frame_id;
+	frame.unchanged.reset();
+	// set bits to 1 for index 0..num encoder threads
+	frame.status = (1 << cn->encoder_threads.size()) - 1;
+	cn->psc.submitted += 2;
+	cn->psc.submitted.notify_all();
 
 	return VK_SUCCESS;
 }
@@ -749,15 +1037,18 @@ static void comp_wivrn_mark_timing_point(struct comp_target * ct,
 	switch (point)
 	{
 		case COMP_TARGET_TIMING_POINT_WAKE_UP:
-			cn->cnx.dump_time("wake_up", frame_id, when_ns);
+			cn->cnx.dump_time(flight_recorder::event::wake_up, frame_id, when_ns);
+			WIVRN_TRACE_INSTANT("wake_up", when_ns);
 			break;
 		case COMP_TARGET_TIMING_POINT_BEGIN:
-			cn->cnx.dump_time("begin", frame_id, when_ns);
+			cn->cnx.dump_time(flight_recorder::event::begin, frame_id, when_ns);
+			WIVRN_TRACE_INSTANT("begin", when_ns);
 			break;
 		case COMP_TARGET_TIMING_POINT_SUBMIT_BEGIN:
 			break;
 		case COMP_TARGET_TIMING_POINT_SUBMIT_END:
-			cn->cnx.dump_time("submit", frame_id, when_ns);
+			cn->cnx.dump_time(flight_recorder::event::submit, frame_id, when_ns);
+			WIVRN_TRACE_INSTANT("submit", when_ns);
 			break;
 		default:
 			assert(false);
@@ -822,7 +1113,7 @@ void wivrn_comp_target::on_feedback(const from_headset::feedback & feedback, con
 	if (not o)
 		return;
 	uint8_t stream = feedback.stream_index;
-	if (psc.status & 1)
+	if (psc.submitted & 1)
 		return;
 	if (encoders.size() <= stream)
 		return;
@@ -885,5 +1176,9 @@ wivrn_comp_target::wivrn_comp_target(wivrn::wivrn_session & cnx, struct comp_com
         cnx(cnx)
 {
 	c->frame_interval_ns = U_TIME_1S_IN_NS / desc.fps;
+	configuration config;
+	pacer.set_target_miss_rate(cnx.get_target_miss_rate());
+	max_repeated_frames = config.max_repeated_frames;
+	hidden.enabled = config.blank_hidden_area;
 }
 } // namespace wivrn
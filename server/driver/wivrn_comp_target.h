@@ -22,14 +22,19 @@
 #include "main/comp_target.h"
 
 #include "encoder/encoder_settings.h"
+#include "frame_generator.h"
 #include "utils/wivrn_vk_bundle.h"
+#include "hidden_area.h"
 #include "vk/allocation.h"
 #include "wivrn_foveation.h"
 #include "wivrn_pacer.h"
 #include "wivrn_packets.h"
 
+#include <array>
+#include <atomic>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <thread>
 #include <vector>
@@ -63,17 +68,46 @@ struct pseudo_swapchain
 	};
 	std::vector<item> images;
 
-	// bitmask of encoder status, first bit to request exit, then one bit per thread:
-	// 0 when encoder is done
-	// 1 when busy/image to be encoded
-	status_type status;
+	// Data to be encoded, one per frame in flight
+	struct frame
+	{
+		// bitmask of encoder threads which have not encoded this frame yet
+		status_type status;
+
+		vk::raii::Fence fence = nullptr;
+		vk::raii::CommandBuffer command_buffer = nullptr;
 
-	// Data to be encoded
-	vk::raii::Fence fence = nullptr;
-	vk::raii::CommandBuffer command_buffer = nullptr;
+		uint32_t image_index;
+		int64_t frame_index;
+		to_headset::video_stream_data_shard::view_info_t view_info{};
 
-	int64_t frame_index;
-	to_headset::video_stream_data_shard::view_info_t view_info{};
+		// Pixels sampled from the image, to detect unchanged frames
+		buffer_allocation samples;
+		// Set by the first encoder thread that gets the frame
+		std::optional<bool> unchanged;
+	};
+	// ring buffer of frames, encoders process them in order
+	std::unique_ptr<frame[]> frames;
+	uint32_t depth = 0;
+
+	// first bit to request exit, then number of frames submitted by the compositor
+	// 64 bits so that the counter does not wrap, frames are indexed by counter % depth
+	std::atomic_uint64_t submitted;
+
+	// Previous frame, to detect unchanged frames, shared by the encoder threads
+	std::mutex unchanged_mutex;
+	std::optional<uint64_t> last_hash;
+	to_headset::video_stream_data_shard::view_info_t last_view_info{};
+	int repeated = 0;
+
+	// Regions of the images copied to frame::samples, for each layer
+	std::array<std::vector<vk::BufferImageCopy>, 2> sample_regions;
+	size_t sample_layer_size = 0;
+
+	// Flat colour copied over the areas hidden by the lenses,
+	// luma for a row of tiles, then chroma
+	buffer_allocation blank;
+	vk::DeviceSize blank_chroma_offset = 0;
 };
 
 struct wivrn_comp_target : public comp_target
@@ -100,8 +134,25 @@ struct wivrn_comp_target : public comp_target
 	wivrn::wivrn_session & cnx;
 	std::optional<wivrn_foveation> foveation;
 
+	// Replaces the compositor output when synthetic-source is set
+	std::optional<frame_generator> generator;
+
 	std::atomic<float> requested_refresh_rate;
 
+	// Maximum number of consecutive unchanged frames that are not encoded, 0 to disable
+	int max_repeated_frames = 0;
+
+	// Areas of the image not visible through the lenses, and values used to compute them
+	struct
+	{
+		bool enabled = false;
+		hidden_area area;
+		uint64_t mask_version = -1;
+		std::array<XrFovf, 2> fov{};
+		std::array<to_headset::foveation_parameter, 2> foveation;
+		std::vector<vk::BufferImageCopy> regions;
+	} hidden;
+
 	wivrn_comp_target(wivrn::wivrn_session & cnx, struct comp_compositor * c);
 	~wivrn_comp_target();
 
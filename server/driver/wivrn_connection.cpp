@@ -44,6 +44,16 @@ static void handle_event_from_main_loop(to_monado::set_bitrate)
 	// Ignore bitrate request when no headset is connected
 }
 
+static void handle_event_from_main_loop(to_monado::set_target_miss_rate)
+{
+	// Ignore latency target when no headset is connected
+}
+
+static void handle_event_from_main_loop(to_monado::dump_flight_recorder)
+{
+	// Nothing recorded when no headset is connected
+}
+
 static std::string clean_key(std::string key)
 {
 	static const std::regex header{"^-+BEGIN .*-+$", std::regex_constants::multiline};
@@ -71,6 +81,7 @@ wivrn::wivrn_connection::wivrn_connection(std::stop_token stop_token, encryption
 
 void wivrn::wivrn_connection::init(std::stop_token stop_token, std::function<void()> tick)
 {
+	connection_time = std::chrono::steady_clock::now();
 	active = false;
 
 	sockaddr_in6 server_address;
@@ -24,6 +24,7 @@
 #include "wivrn_sockets.h"
 
 #include <atomic>
+#include <chrono>
 #include <optional>
 #include <poll.h>
 #include <stdexcept>
@@ -56,6 +57,8 @@ private:
 	encryption_state state;
 
 	wivrn::from_headset::headset_info_packet info_packet;
+	// when the headset connection was accepted
+	std::chrono::steady_clock::time_point connection_time;
 
 	void init(std::stop_token stop_token, std::function<void()> tick = []() {});
 
@@ -118,6 +121,16 @@ public:
 		return info_packet;
 	}
 
+	std::chrono::steady_clock::time_point connected_at() const
+	{
+		return connection_time;
+	}
+
+	uint64_t bytes_sent() const
+	{
+		return control.bytes_sent() + stream.bytes_sent();
+	}
+
 	template <typename T>
 	int poll(T && visitor, int timeout)
 	{
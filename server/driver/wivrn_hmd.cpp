@@ -129,7 +129,7 @@ xrt_result_t wivrn_hmd::get_tracked_pose(xrt_input_name name, int64_t at_timesta
 		return XRT_ERROR_INPUT_UNSUPPORTED;
 	}
 
-	auto [extrapolation_time, view] = views.get_at(at_timestamp_ns);
+	auto [extrapolation_time, view] = views.get_view_at(at_timestamp_ns);
 	*res = view.relation;
 	cnx->add_predict_offset(extrapolation_time);
 	return XRT_SUCCESS;
@@ -162,7 +162,7 @@ xrt_result_t wivrn_hmd::get_view_poses(const xrt_vec3 * default_eye_relation,
                                        xrt_fov * out_fovs,
                                        xrt_pose * out_poses)
 {
-	auto [extrapolation_time, view] = views.get_at(at_timestamp_ns);
+	auto [extrapolation_time, view] = views.get_view_at(at_timestamp_ns);
 	cnx->add_predict_offset(extrapolation_time);
 
 	int flags = view.relation.relation_flags;
@@ -229,6 +229,19 @@ void wivrn_hmd::update_visibility_mask(const from_headset::visibility_mask_chang
 	assert(mask.view_index < 2);
 	auto m = visibility_mask.lock();
 	m->at(mask.view_index) = mask.data;
+	++visibility_mask_version;
+}
+
+std::array<from_headset::visibility_mask_changed::mask, 2> wivrn_hmd::get_visible_triangles()
+{
+	std::array<from_headset::visibility_mask_changed::mask, 2> res;
+	auto m = visibility_mask.lock();
+	for (size_t view = 0; view < 2; ++view)
+	{
+		if ((*m)[view])
+			res[view] = (*(*m)[view])[XR_VISIBILITY_MASK_TYPE_VISIBLE_TRIANGLE_MESH_KHR - 1];
+	}
+	return res;
 }
 
 bool wivrn_hmd::update_presence(bool new_presence)
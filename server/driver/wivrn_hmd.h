@@ -55,6 +55,8 @@ class wivrn_hmd : public xrt_device
 
 	std::atomic<bool> presence{true};
 	thread_safe<std::array<std::optional<from_headset::visibility_mask_changed::masks>, 2>> visibility_mask;
+	// incremented when visibility_mask changes
+	std::atomic<uint64_t> visibility_mask_version{0};
 
 	wivrn::wivrn_session * cnx;
 
@@ -82,6 +84,12 @@ public:
 	void update_battery(const from_headset::battery &);
 	void update_tracking(const from_headset::tracking &, const clock_offset &);
 	void update_visibility_mask(const from_headset::visibility_mask_changed &);
+	uint64_t get_visibility_mask_version() const
+	{
+		return visibility_mask_version;
+	}
+	// visible triangle mesh for each view, empty if the headset did not send it
+	std::array<from_headset::visibility_mask_changed::mask, 2> get_visible_triangles();
 	bool update_presence(bool);
 };
 } // namespace wivrn
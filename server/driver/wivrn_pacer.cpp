@@ -20,6 +20,7 @@
 #include "wivrn_pacer.h"
 #include "driver/clock_offset.h"
 #include "os/os_time.h"
+#include "utils/tracing.h"
 #include <algorithm>
 #include <cmath>
 
@@ -28,6 +29,16 @@ namespace wivrn
 
 static const int64_t margin_ns = 3'000'000;
 static const int64_t slop_ns = 500'000;
+static const double present_to_decoded_quantile = 0.995;
+// Number of samples required before trusting the quantile
+static const size_t min_samples = 100;
+
+// Margin on top of the present to decoded quantile when latency control is disabled
+static const int64_t default_latency_margin_ns = 1'000'000;
+static const int64_t min_latency_margin_ns = -10'000'000;
+static const int64_t max_latency_margin_ns = 20'000'000;
+// Margin increase for a late frame, decrease for an on time frame is scaled by the target miss rate
+static const double latency_controller_gain_ns = 1'000'000;
 
 template <typename T>
 static T lerp_mod(T a, T b, double t, T mod)
@@ -43,39 +54,10 @@ static T lerp_mod(T a, T b, double t, T mod)
 
 wivrn_pacer::wivrn_pacer(uint64_t frame_duration) :
         frame_duration_ns(frame_duration),
-        frame_times(5000),
-        frame_times_compute(frame_times),
-        worker([this](std::stop_token t) {
-	        std::vector<XrDuration> samples;
-	        while (not t.stop_requested())
-	        {
-		        samples.clear();
-		        {
-			        std::unique_lock lock(compute_mutex);
-			        compute_cv.wait(lock);
-			        for (const auto & time: frame_times_compute)
-			        {
-				        if (time.decoded > time.present)
-					        samples.push_back(time.decoded - time.present);
-			        }
-		        }
-		        if (samples.empty())
-			        continue;
-		        auto it = samples.begin() + (samples.size() * 995) / 1000;
-		        std::ranges::nth_element(samples, it);
-
-		        std::unique_lock lock(mutex);
-		        safe_present_to_decoded_ns = *it + 1'000'000;
-	        }
-        })
+        latency_margin_ns(default_latency_margin_ns),
+        present_to_decoded(0.01, 100'000, 1'000'000'000, 5000)
 {}
 
-wivrn_pacer::~wivrn_pacer()
-{
-	worker.request_stop();
-	compute_cv.notify_all();
-}
-
 void wivrn_pacer::set_frame_duration(uint64_t frame_duration_ns)
 {
 	std::lock_guard lock(mutex);
@@ -114,14 +96,24 @@ void wivrn_pacer::predict(
 	};
 
 	out_present_slop_ns = slop_ns;
+
+	WIVRN_TRACE_COUNTER("present_to_decoded_ms", safe_present_to_decoded_ns / 1e6, now);
+	WIVRN_TRACE_COUNTER("latency_margin_ms", latency_margin_ns / 1e6, now);
 }
 
 void wivrn_pacer::on_feedback(const wivrn::from_headset::feedback & feedback, const clock_offset & offset)
 {
-	if (feedback.times_displayed > 1 or not feedback.blitted)
+	if (not feedback.blitted)
 		return;
 
 	std::lock_guard lock(mutex);
+	// A frame is displayed more than once when the next one is late
+	if (feedback.stream_index == 0)
+		update_latency_margin(feedback.times_displayed > 1);
+
+	if (feedback.times_displayed > 1)
+		return;
+
 	auto & when = in_flight_frames[feedback.frame_index % in_flight_frames.size()];
 	if (when.frame_id != feedback.frame_index)
 		return;
@@ -129,20 +121,20 @@ void wivrn_pacer::on_feedback(const wivrn::from_headset::feedback & feedback, co
 	auto & times = frame_times[feedback.frame_index % frame_times.size()];
 	if (times.frame_id != feedback.frame_index)
 	{
+		commit(times);
 		times.frame_id = feedback.frame_index;
 		times.present = when.present_ns;
 		times.decoded = 0;
+		times.repeated = false;
 	}
 	times.decoded = std::max(times.decoded, offset.from_headset(feedback.received_from_decoder));
 
 	if (feedback.stream_index == 0)
 	{
-		if (feedback.frame_index % 100 == 0)
-		{
-			std::unique_lock lock(compute_mutex);
-			std::swap(frame_times, frame_times_compute);
-			compute_cv.notify_all();
-		}
+		if (present_to_decoded.size() >= min_samples)
+			safe_present_to_decoded_ns = std::max(
+			        present_to_decoded.quantile(present_to_decoded_quantile) + latency_margin_ns,
+			        present_to_decoded.quantile(0.5));
 
 		client_render_phase_ns = lerp_mod<int64_t>(client_render_phase_ns, offset.from_headset(feedback.blitted) % frame_duration_ns, 0.1, frame_duration_ns);
 	}
@@ -150,6 +142,18 @@ void wivrn_pacer::on_feedback(const wivrn::from_headset::feedback & feedback, co
 	if (feedback.displayed and feedback.displayed > feedback.blitted and feedback.displayed < feedback.blitted + 100'000'000)
 		mean_render_to_display_ns = std::lerp(mean_render_to_display_ns, feedback.displayed - feedback.blitted, 0.1);
 }
+void wivrn_pacer::on_repeated_frame(int64_t frame_id)
+{
+	std::lock_guard lock(mutex);
+	auto & times = frame_times[frame_id % frame_times.size()];
+	if (times.frame_id != frame_id)
+	{
+		commit(times);
+		times = {.frame_id = frame_id};
+	}
+	times.repeated = true;
+}
+
 void wivrn_pacer::mark_timing_point(
         comp_target_timing_point point,
         int64_t frame_id,
@@ -179,6 +183,44 @@ void wivrn_pacer::mark_timing_point(
 	}
 }
 
+void wivrn_pacer::update_latency_margin(bool missed)
+{
+	miss_rate = std::lerp(miss_rate, missed ? 1. : 0., 0.001);
+
+	if (target_miss_rate <= 0)
+		return;
+
+	// At equilibrium, increases on late frames compensate decreases on the
+	// others when the miss rate matches the target.
+	latency_margin_ns += latency_controller_gain_ns * ((missed ? 1. : 0.) - target_miss_rate);
+	latency_margin_ns = std::clamp(latency_margin_ns, min_latency_margin_ns, max_latency_margin_ns);
+}
+
+void wivrn_pacer::set_target_miss_rate(double target)
+{
+	std::lock_guard lock(mutex);
+	target_miss_rate = std::clamp(target, 0., 1.);
+	if (target_miss_rate == 0)
+		latency_margin_ns = default_latency_margin_ns;
+}
+
+wivrn_pacer::latency_control wivrn_pacer::get_latency_control()
+{
+	std::lock_guard lock(mutex);
+	return {
+	        .target_miss_rate = target_miss_rate,
+	        .miss_rate = miss_rate,
+	        .margin_ns = latency_margin_ns,
+	};
+}
+
+void wivrn_pacer::commit(frame_time & time)
+{
+	if (time.frame_id >= 0 and not time.repeated and time.decoded > time.present)
+		present_to_decoded.add(time.decoded - time.present);
+	time.frame_id = -1;
+}
+
 wivrn_pacer::frame_info wivrn_pacer::present_to_info(int64_t present)
 {
 	std::lock_guard lock(mutex);
@@ -195,5 +237,6 @@ void wivrn_pacer::reset()
 {
 	std::lock_guard lock(mutex);
 	std::ranges::fill(frame_times, frame_time{});
+	present_to_decoded.reset();
 }
 } // namespace wivrn
@@ -19,14 +19,13 @@
 
 #pragma once
 
+#include "utils/quantile_sketch.h"
 #include "wivrn_packets.h"
 
-#include <condition_variable>
+#include <array>
 #include <cstdint>
 #include <main/comp_target.h>
 #include <mutex>
-#include <thread>
-#include <vector>
 
 namespace wivrn
 {
@@ -43,6 +42,16 @@ public:
 		int64_t predicted_display_time;
 	};
 
+	struct latency_control
+	{
+		// Target ratio of displayed frames that were late, 0 when disabled
+		double target_miss_rate;
+		// Measured ratio of displayed frames that were late
+		double miss_rate;
+		// Margin added to the present to decoded time
+		int64_t margin_ns;
+	};
+
 private:
 	std::mutex mutex;
 	uint64_t frame_duration_ns;
@@ -57,24 +66,31 @@ private:
 
 	int64_t last_wake_up_ns = 0;
 
+	// Closed loop control of the latency margin
+	double target_miss_rate = 0;
+	double miss_rate = 0;
+	int64_t latency_margin_ns;
+
+	// Frames for which feedback is still being received, the sample is
+	// committed when the slot is reused, all streams should be decoded by then.
 	struct frame_time
 	{
 		int64_t frame_id = -1;
 		XrTime present = 0;
 		XrTime decoded = 0;
+		// Frame was not encoded, its decode time is meaningless
+		bool repeated = false;
 	};
-	std::vector<frame_time> frame_times;
-
-	std::mutex compute_mutex;
-	std::condition_variable compute_cv;
-	std::vector<frame_time> frame_times_compute;
-	std::jthread worker;
+	std::array<frame_time, 32> frame_times;
+	utils::quantile_sketch present_to_decoded;
 
 	std::array<frame_info, 8> in_flight_frames;
 
+	void commit(frame_time &);
+	void update_latency_margin(bool missed);
+
 public:
 	wivrn_pacer(uint64_t frame_duration);
-	~wivrn_pacer();
 
 	void set_frame_duration(uint64_t frame_duration);
 
@@ -86,6 +102,11 @@ public:
 	        int64_t & out_predicted_display_time_ns);
 
 	void on_feedback(const wivrn::from_headset::feedback &, const clock_offset &);
+	void on_repeated_frame(int64_t frame_id);
+
+	// 0 to use a fixed margin
+	void set_target_miss_rate(double);
+	latency_control get_latency_control();
 
 	void mark_timing_point(
 	        comp_target_timing_point point,
@@ -26,12 +26,15 @@
 #include "main/comp_main_interface.h"
 #include "main/comp_target.h"
 #include "server/ipc_server.h"
+#include "standby.h"
 #include "target_instance_wivrn.h"
 #include "util/u_builders.h"
 #include "util/u_logging.h"
 #include "util/u_system.h"
 #include "utils/load_icon.h"
 #include "utils/scoped_lock.h"
+#include "utils/thread_profile.h"
+#include "utils/tracing.h"
 
 #include "audio/audio_setup.h"
 #include "wivrn_comp_target.h"
@@ -155,8 +158,12 @@ wivrn::wivrn_session::wivrn_session(std::unique_ptr<wivrn_connection> connection
         left_controller(0, &hmd, this),
         left_hand_interaction(0, &hmd, this),
         right_controller(1, &hmd, this),
-        right_hand_interaction(1, &hmd, this)
+        right_hand_interaction(1, &hmd, this),
+        target_miss_rate(configuration().target_miss_rate.value_or(0))
 {
+	startup_last = this->connection->connected_at();
+	startup_step("server started");
+
 	try
 	{
 		audio_handle = audio_device::create(
@@ -295,6 +302,7 @@ wivrn::wivrn_session::wivrn_session(std::unique_ptr<wivrn_connection> connection
 		system_name += " on WiVRn";
 		strlcpy(xrt_system.base.properties.name, system_name.c_str(), std::size(xrt_system.base.properties.name));
 	}
+	startup_step("devices created");
 }
 
 wivrn_session::~wivrn_session()
@@ -305,6 +313,9 @@ wivrn_session::~wivrn_session()
 	}
 
 	connection->shutdown();
+#if WIVRN_FEATURE_TRACING
+	tracing::stop();
+#endif
 }
 
 xrt_result_t wivrn::wivrn_session::create_session(std::unique_ptr<wivrn_connection> connection,
@@ -335,6 +346,8 @@ xrt_result_t wivrn::wivrn_session::create_session(std::unique_ptr<wivrn_connecti
 		return xret;
 	}
 	self->system_compositor = *out_xsysc;
+	self->startup_step("system compositor created");
+	standby::release();
 
 	u_builder_create_space_overseer_legacy(
 	        &self->xrt_system.broadcast,
@@ -355,6 +368,20 @@ xrt_result_t wivrn::wivrn_session::create_session(std::unique_ptr<wivrn_connecti
 		self->feedback_csv.open(dump_file);
 	}
 
+#if WIVRN_FEATURE_TRACING
+	if (auto trace_file = std::getenv("WIVRN_TRACE"))
+	{
+		try
+		{
+			tracing::start(trace_file, "wivrn-server", "headset (reported)");
+		}
+		catch (std::exception & e)
+		{
+			U_LOG_W("Cannot write trace to %s: %s", trace_file, e.what());
+		}
+	}
+#endif
+
 	self->thread = std::jthread([s = self.get()](auto stop_token) { return s->run(stop_token); });
 	*out_xsysd = self.release();
 	return XRT_SUCCESS;
@@ -638,18 +665,34 @@ void wivrn_session::operator()(from_headset::feedback && feedback)
 			comp_target->on_feedback(feedback, o);
 	}
 
+	recorder.on_feedback(feedback);
+	stats.on_feedback(feedback);
+
 	if (feedback.received_first_packet)
-		dump_time("receive_begin", feedback.frame_index, o.from_headset(feedback.received_first_packet), feedback.stream_index);
+		dump_time(flight_recorder::event::receive_begin, feedback.frame_index, o.from_headset(feedback.received_first_packet), feedback.stream_index);
 	if (feedback.received_last_packet)
-		dump_time("receive_end", feedback.frame_index, o.from_headset(feedback.received_last_packet), feedback.stream_index);
+		dump_time(flight_recorder::event::receive_end, feedback.frame_index, o.from_headset(feedback.received_last_packet), feedback.stream_index);
 	if (feedback.sent_to_decoder)
-		dump_time("decode_begin", feedback.frame_index, o.from_headset(feedback.sent_to_decoder), feedback.stream_index);
+		dump_time(flight_recorder::event::decode_begin, feedback.frame_index, o.from_headset(feedback.sent_to_decoder), feedback.stream_index);
 	if (feedback.received_from_decoder)
-		dump_time("decode_end", feedback.frame_index, o.from_headset(feedback.received_from_decoder), feedback.stream_index);
+		dump_time(flight_recorder::event::decode_end, feedback.frame_index, o.from_headset(feedback.received_from_decoder), feedback.stream_index);
 	if (feedback.blitted)
-		dump_time("blit", feedback.frame_index, o.from_headset(feedback.blitted), feedback.stream_index);
+		dump_time(flight_recorder::event::blit, feedback.frame_index, o.from_headset(feedback.blitted), feedback.stream_index);
 	if (feedback.displayed)
-		dump_time("display", feedback.frame_index, o.from_headset(feedback.displayed), feedback.stream_index);
+		dump_time(flight_recorder::event::display, feedback.frame_index, o.from_headset(feedback.displayed), feedback.stream_index);
+
+#if WIVRN_FEATURE_TRACING
+	// Frame spans as reported by the headset, for a trace of the server alone
+	auto id = tracing::frame_id(feedback.stream_index, feedback.frame_index);
+	if (feedback.received_first_packet and feedback.received_last_packet)
+		WIVRN_TRACE_STREAM_SLICE("receive", feedback.stream_index, o.from_headset(feedback.received_first_packet), o.from_headset(feedback.received_last_packet), tracing::flow::step, id);
+	if (feedback.sent_to_decoder and feedback.received_from_decoder)
+		WIVRN_TRACE_STREAM_SLICE("decode", feedback.stream_index, o.from_headset(feedback.sent_to_decoder), o.from_headset(feedback.received_from_decoder), tracing::flow::step, id);
+	if (feedback.received_from_decoder and feedback.blitted)
+		WIVRN_TRACE_STREAM_SLICE("blit", feedback.stream_index, o.from_headset(feedback.received_from_decoder), o.from_headset(feedback.blitted), tracing::flow::step, id);
+	if (feedback.blitted and feedback.displayed)
+		WIVRN_TRACE_STREAM_SLICE("display", feedback.stream_index, o.from_headset(feedback.blitted), o.from_headset(feedback.displayed), tracing::flow::end, id);
+#endif
 }
 
 void wivrn_session::operator()(from_headset::battery && battery)
@@ -850,6 +893,21 @@ void wivrn_session::operator()(to_monado::set_bitrate && data)
 		comp_target->set_bitrate(data.bitrate_bps);
 }
 
+void wivrn_session::operator()(to_monado::dump_flight_recorder &&)
+{
+	recorder.dump("request");
+}
+
+void wivrn_session::operator()(to_monado::set_target_miss_rate && data)
+{
+	if (target_miss_rate.exchange(data.target_miss_rate) != data.target_miss_rate)
+		U_LOG_I("Target miss rate: %f", data.target_miss_rate);
+
+	std::shared_lock lock(comp_target_mutex);
+	if (comp_target)
+		comp_target->pacer.set_target_miss_rate(data.target_miss_rate);
+}
+
 struct refresh_rate_adjuster
 {
 	std::chrono::seconds period{10};
@@ -900,7 +958,10 @@ struct refresh_rate_adjuster
 
 void wivrn_session::run(std::stop_token stop)
 {
+	pthread_setname_np(pthread_self(), "session");
+	apply_thread_profile(thread_role::network);
 	refresh_rate_adjuster refresh(get_info(), app_pacers);
+	auto next_latency_report = std::chrono::steady_clock::now();
 	while (not stop.stop_requested())
 	{
 		try
@@ -913,6 +974,26 @@ void wivrn_session::run(std::stop_token stop)
 				{
 					if (comp_target->requested_refresh_rate == 0)
 						refresh.adjust(*connection);
+
+					if (auto now = std::chrono::steady_clock::now(); now >= next_latency_report)
+					{
+						auto control = comp_target->pacer.get_latency_control();
+						send_to_main(from_monado::latency_control{
+						        .target_miss_rate = control.target_miss_rate,
+						        .miss_rate = control.miss_rate,
+						        .margin_ns = control.margin_ns,
+						});
+						send_to_main(from_monado::statistics{
+						        .values = stats.snapshot(connection->bytes_sent(),
+						                                 {
+						                                         .miss_rate = control.miss_rate,
+						                                         .margin_ns = control.margin_ns,
+						                                 }),
+						});
+						next_latency_report = now + std::chrono::seconds(1);
+						if (auto o = offset_est.get_offset())
+							WIVRN_TRACE_CLOCK_OFFSET(o.b);
+					}
 				}
 			}
 			poll_session_loss();
@@ -937,15 +1018,40 @@ void wivrn_session::set_foveated_size(uint32_t width, uint32_t height)
 	hmd.set_foveated_size(width, height);
 }
 
-void wivrn_session::dump_time(const std::string & event, uint64_t frame, int64_t time, uint8_t stream, const char * extra)
+void wivrn_session::dump_time(flight_recorder::event event, uint64_t frame, int64_t time, uint8_t stream, flight_recorder::frame_type type)
 {
+	recorder.push(event, frame, time, stream, type);
+	if (event == flight_recorder::event::encode_begin and type == flight_recorder::frame_type::idr)
+		stats.on_idr();
+
 	if (feedback_csv)
 	{
 		std::lock_guard lock(csv_mutex);
-		feedback_csv << std::quoted(event) << "," << frame << "," << time << "," << (int)stream << extra << std::endl;
+		feedback_csv << std::quoted(magic_enum::enum_name(event)) << "," << frame << "," << time << "," << (int)stream;
+		if (type != flight_recorder::frame_type::none)
+			feedback_csv << "," << magic_enum::enum_name(type);
+		feedback_csv << "\n";
 	}
 }
 
+void wivrn_session::startup_step(const char * step, bool last)
+{
+	// Called on every frame by encoders, avoid taking the lock
+	if (startup_done)
+		return;
+	std::lock_guard lock(startup_mutex);
+	if (startup_done)
+		return;
+	using ms = std::chrono::duration<double, std::milli>;
+	auto now = std::chrono::steady_clock::now();
+	U_LOG_I("Session startup: %s at %.1fms (+%.1fms)",
+	        step,
+	        ms(now - connection->connected_at()).count(),
+	        ms(now - startup_last).count());
+	startup_last = now;
+	startup_done = last;
+}
+
 static bool quit_if_no_client(u_system & xrt_system)
 {
 	{
@@ -988,6 +1094,12 @@ void wivrn_session::reconnect()
 			if (quit_if_no_client(xrt_system))
 				throw no_client_connected{};
 		});
+		{
+			std::lock_guard lock(startup_mutex);
+			startup_done = false;
+			startup_last = connection->connected_at();
+		}
+		startup_step("headset reconnected");
 
 		// const auto & info = connection->info();
 		// FIXME: ensure new client is compatible
@@ -21,6 +21,8 @@
 
 #include "clock_offset.h"
 #include "driver/app_pacer.h"
+#include "flight_recorder.h"
+#include "session_stats.h"
 #include "utils/thread_safe.h"
 #include "wivrn_connection.h"
 #include "wivrn_controller.h"
@@ -129,10 +131,20 @@ class wivrn_session : public xrt_system_devices
 	std::shared_mutex comp_target_mutex;
 	wivrn_comp_target * comp_target;
 
+	// Last value requested over D-Bus, kept for the next compositor targets
+	std::atomic<double> target_miss_rate;
+
 	clock_offset_estimator offset_est;
 
 	std::mutex csv_mutex;
 	std::ofstream feedback_csv;
+	flight_recorder recorder;
+	session_stats stats;
+
+	// Startup steps are logged until the first frame is sent
+	std::mutex startup_mutex;
+	std::atomic_bool startup_done = false;
+	std::chrono::steady_clock::time_point startup_last;
 
 	std::shared_ptr<audio_device> audio_handle;
 
@@ -162,6 +174,11 @@ public:
 
 	void unset_comp_target();
 
+	double get_target_miss_rate() const
+	{
+		return target_miss_rate;
+	}
+
 	wivrn_hmd & get_hmd()
 	{
 		return hmd;
@@ -204,6 +221,8 @@ public:
 
 	void operator()(to_monado::disconnect &&);
 	void operator()(to_monado::set_bitrate &&);
+	void operator()(to_monado::set_target_miss_rate &&);
+	void operator()(to_monado::dump_flight_recorder &&);
 
 	bool has_stream()
 	{
@@ -225,7 +244,13 @@ public:
 
 	void set_foveated_size(uint32_t width, uint32_t height);
 
-	void dump_time(const std::string & event, uint64_t frame, int64_t time, uint8_t stream = -1, const char * extra = "");
+	// Events are always kept by the flight recorder, and written to the
+	// WIVRN_DUMP_TIMINGS file if it is set
+	void dump_time(flight_recorder::event event, uint64_t frame, int64_t time, uint8_t stream = -1, flight_recorder::frame_type type = flight_recorder::frame_type::none);
+
+	// Log the time spent since the headset connected and since the previous step
+	// last: this is the final step of the startup
+	void startup_step(const char * step, bool last = false);
 
 private:
 	void run(std::stop_token stop);
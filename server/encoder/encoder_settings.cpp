@@ -19,6 +19,7 @@
 
 #include "encoder_settings.h"
 #include "driver/configuration.h"
+#include "probe_cache.h"
 #include "util/u_logging.h"
 #include "utils/wivrn_vk_bundle.h"
 #include "video_encoder.h"
@@ -26,8 +27,10 @@
 #include "wivrn_packets.h"
 #include <charconv>
 #include <cmath>
+#include <format>
 #include <magic_enum.hpp>
 #include <string>
+#include <thread>
 #include <vulkan/vulkan.h>
 
 #include "wivrn_config.h"
@@ -144,7 +147,7 @@ static constexpr auto ffmpeg_version()
 	return result;
 }
 
-static std::optional<wivrn::video_codec> filter_codecs_vaapi(wivrn_vk_bundle & bundle, const std::vector<wivrn::video_codec> & codecs, int bit_depth)
+static std::optional<wivrn::video_codec> filter_codecs_vaapi(wivrn_vk_bundle & bundle, probe_cache & cache, const std::vector<wivrn::video_codec> & codecs, int bit_depth)
 {
 	video_encoder_ffmpeg::mute_logs mute;
 	encoder_settings s{
@@ -174,14 +177,21 @@ static std::optional<wivrn::video_codec> filter_codecs_vaapi(wivrn_vk_bundle & b
 				continue;
 			}
 		}
-		try
-		{
-			s.codec = codec;
-			video_encoder_va test(bundle, s, 60, 0);
+		s.codec = codec;
+		auto name = std::format("vaapi-{}-{}bit", magic_enum::enum_name(codec), bit_depth);
+		bool supported = cache.get(name, [&]() {
+			try
+			{
+				video_encoder_va test(bundle, s, 60, 0);
+				return true;
+			}
+			catch (...)
+			{
+				return false;
+			}
+		});
+		if (supported)
 			return codec;
-		}
-		catch (...)
-		{}
 
 		U_LOG_I("Video codec %s not supported", std::string(magic_enum::enum_name(codec)).c_str());
 	}
@@ -191,43 +201,43 @@ static std::optional<wivrn::video_codec> filter_codecs_vaapi(wivrn_vk_bundle & b
 #endif
 
 #if WIVRN_USE_NVENC
-static bool probe_nvenc(wivrn_vk_bundle & bundle, int bit_depth)
+static bool probe_nvenc(wivrn_vk_bundle & bundle, probe_cache & cache, int bit_depth)
 {
-	static bool res = [&]() {
-	encoder_settings s{
-	        {
-	                .width = 800,
-	                .height = 608,
-	                .video_width = 800,
-	                .video_height = 608,
-	                .codec = h264,
-	        },
-	        encoder_nvenc,
-	        default_bitrate,
-	};
-	s.bit_depth = bit_depth;
-	try
-	{
-		video_encoder_nvenc test(bundle, s, 60, 0);
-		return true;
-	}
-	catch (std::exception & e)
-	{
-		U_LOG_W("nvenc not supported: %s", e.what());
-		return false;
-	} }();
-	return res;
+	return cache.get(std::format("nvenc-{}bit", bit_depth), [&]() {
+		encoder_settings s{
+		        {
+		                .width = 800,
+		                .height = 608,
+		                .video_width = 800,
+		                .video_height = 608,
+		                .codec = h264,
+		        },
+		        encoder_nvenc,
+		        default_bitrate,
+		};
+		s.bit_depth = bit_depth;
+		try
+		{
+			video_encoder_nvenc test(bundle, s, 60, 0);
+			return true;
+		}
+		catch (std::exception & e)
+		{
+			U_LOG_W("nvenc not supported: %s", e.what());
+			return false;
+		}
+	});
 }
 #endif
 
-static void fill_defaults(wivrn_vk_bundle & bundle, const std::vector<wivrn::video_codec> & headset_codecs, configuration::encoder & config, int bit_depth)
+static void fill_defaults(wivrn_vk_bundle & bundle, probe_cache & cache, const std::vector<wivrn::video_codec> & headset_codecs, configuration::encoder & config, int bit_depth)
 {
 	if (config.name.empty())
 	{
 		if (is_nvidia(*bundle.physical_device))
 		{
 #if WIVRN_USE_NVENC
-			if (probe_nvenc(bundle, bit_depth))
+			if (probe_nvenc(bundle, cache, bit_depth))
 				config.name = encoder_nvenc;
 			else
 #else
@@ -269,7 +279,7 @@ static void fill_defaults(wivrn_vk_bundle & bundle, const std::vector<wivrn::vid
 #if WIVRN_USE_VAAPI
 	if (config.name == encoder_vaapi and not config.codec)
 	{
-		config.codec = filter_codecs_vaapi(bundle, headset_codecs, bit_depth);
+		config.codec = filter_codecs_vaapi(bundle, cache, headset_codecs, bit_depth);
 		if (not config.codec)
 		{
 #if WIVRN_USE_X264
@@ -296,6 +306,11 @@ static void fill_defaults(wivrn_vk_bundle & bundle, const std::vector<wivrn::vid
 		config.codec = h264; // this will fail if 10-bit is enabled
 #endif
 
+#if WIVRN_USE_X265
+	if (config.name == encoder_x265)
+		config.codec = h265; // this will fail if 10-bit is enabled
+#endif
+
 	if (config.name == encoder_raw)
 		config.codec = raw;
 
@@ -303,10 +318,10 @@ static void fill_defaults(wivrn_vk_bundle & bundle, const std::vector<wivrn::vid
 		config.codec = bit_depth == 10 ? h265 : h264;
 }
 
-static std::vector<configuration::encoder> get_encoder_default_settings(wivrn_vk_bundle & bundle, const std::vector<wivrn::video_codec> & headset_codecs, int bit_depth)
+static std::vector<configuration::encoder> get_encoder_default_settings(wivrn_vk_bundle & bundle, probe_cache & cache, const std::vector<wivrn::video_codec> & headset_codecs, int bit_depth)
 {
 	configuration::encoder base;
-	fill_defaults(bundle, headset_codecs, base, bit_depth);
+	fill_defaults(bundle, cache, headset_codecs, base, bit_depth);
 
 #ifdef WIVRN_SPLIT_ENCODERS
 	if (base.name != encoder_x264)
@@ -348,6 +363,50 @@ static uint16_t align(uint16_t value, uint16_t alignment)
 	return ((value + alignment - 1) / alignment) * alignment;
 }
 
+// Number of horizontal stripes per eye for software encoding
+static int stripe_count(uint32_t width, uint32_t height, std::optional<int> stripes)
+{
+	int n;
+	if (stripes)
+		n = *stripes;
+	else
+	{
+		// Give about 4 threads to each stripe, and no less than 1 megapixel
+		double pixels = width / 2. * height;
+		n = std::min<int>(std::thread::hardware_concurrency() / 8, std::ceil(pixels / 1'000'000));
+	}
+	// Each stripe is a stream on the headset, with its own decoder
+	return std::clamp<int>(n, 0, std::min<int>(4, height / 256));
+}
+
+static std::vector<configuration::encoder> split_stripes(const configuration::encoder & base, int n)
+{
+	/* Split each eye in n stripes, each one is a separate group:
+	 *  +--------+--------+
+	 *  |   0    |   n    |
+	 *  +--------+--------+
+	 *  |  ...   |  ...   |
+	 *  +--------+--------+
+	 *  |  n-1   |  2n-1  |
+	 *  +--------+--------+
+	 * All stripes are encoded concurrently, the headset puts them back together.
+	 */
+	std::vector<configuration::encoder> res;
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			auto & item = res.emplace_back(base);
+			item.width = 0.5;
+			item.height = 1. / n;
+			item.offset_x = 0.5 * eye;
+			item.offset_y = double(i) / n;
+			item.group = res.size() - 1;
+		}
+	}
+	return res;
+}
+
 std::vector<encoder_settings> get_encoder_settings(wivrn_vk_bundle & bundle, uint32_t & width, uint32_t & height, const from_headset::headset_info_packet & info)
 {
 	configuration config;
@@ -355,8 +414,11 @@ std::vector<encoder_settings> get_encoder_settings(wivrn_vk_bundle & bundle, uin
 	if (config.bit_depth != 8 && config.bit_depth != 10)
 		throw std::runtime_error("invalid bit-depth setting. supported values: 8, 10");
 
-	if (config.encoders.empty())
-		config.encoders = get_encoder_default_settings(bundle, info.supported_codecs, config.bit_depth);
+	probe_cache cache(bundle);
+
+	const bool default_encoders = config.encoders.empty();
+	if (default_encoders)
+		config.encoders = get_encoder_default_settings(bundle, cache, info.supported_codecs, config.bit_depth);
 	if (not config.encoder_passthrough)
 		config.encoder_passthrough = config.encoders.front();
 
@@ -364,7 +426,7 @@ std::vector<encoder_settings> get_encoder_settings(wivrn_vk_bundle & bundle, uin
 	config.encoder_passthrough->height = 1;
 	config.encoder_passthrough->offset_x = 0;
 	config.encoder_passthrough->offset_y = 0;
-	fill_defaults(bundle, info.supported_codecs, *config.encoder_passthrough, config.bit_depth);
+	fill_defaults(bundle, cache, info.supported_codecs, *config.encoder_passthrough, config.bit_depth);
 
 	uint64_t bitrate = config.bitrate.value_or(default_bitrate);
 	std::array<double, 2> default_scale;
@@ -380,7 +442,7 @@ std::vector<encoder_settings> get_encoder_settings(wivrn_vk_bundle & bundle, uin
 
 	for (auto & encoder: config.encoders)
 	{
-		fill_defaults(bundle, info.supported_codecs, encoder, config.bit_depth);
+		fill_defaults(bundle, cache, info.supported_codecs, encoder, config.bit_depth);
 		assert(encoder.codec);
 		check_scale(encoder.name,
 		            *encoder.codec,
@@ -392,6 +454,17 @@ std::vector<encoder_settings> get_encoder_settings(wivrn_vk_bundle & bundle, uin
 	width = align(width * scale[0], 64);
 	height = align(height * scale[1], 64);
 
+	// Software encoder is too slow for large images, split them for parallel encoding
+	int software_threads = 0;
+	if (default_encoders and config.encoders.size() == 1 and config.encoders[0].name == encoder_x264)
+	{
+		if (int n = stripe_count(width, height, config.stripes); n > 0)
+		{
+			config.encoders = split_stripes(config.encoders[0], n);
+			software_threads = std::max<int>(1, std::thread::hardware_concurrency() / config.encoders.size());
+		}
+	}
+
 	std::vector<wivrn::encoder_settings> res;
 	std::unordered_map<std::string, int> groups;
 	int next_group = 0;
@@ -431,6 +504,11 @@ std::vector<encoder_settings> get_encoder_settings(wivrn_vk_bundle & bundle, uin
 		}
 		settings.options = encoder.options;
 		settings.device = encoder.device;
+		settings.intra_refresh = encoder.intra_refresh.value_or(0);
+		settings.foveation_qp = encoder.foveation_qp.value_or(0);
+		settings.compression = encoder.compression.value_or(raw_chunk_header::compression_t::none);
+		settings.delta = encoder.delta.value_or(false);
+		settings.threads = software_threads;
 
 		res.push_back(settings);
 	}
@@ -462,6 +540,10 @@ std::vector<encoder_settings> get_encoder_settings(wivrn_vk_bundle & bundle, uin
 		}
 		settings.options = encoder.options;
 		settings.device = encoder.device;
+		settings.intra_refresh = encoder.intra_refresh.value_or(0);
+		settings.foveation_qp = encoder.foveation_qp.value_or(0);
+		settings.compression = encoder.compression.value_or(raw_chunk_header::compression_t::none);
+		settings.delta = encoder.delta.value_or(false);
 		settings.bitrate = bitrate * passthrough_bitrate_factor;
 		res.push_back(settings);
 	}
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "raw_chunk.h"
 #include "wivrn_packets.h"
 
 #include <map>
@@ -41,6 +42,13 @@ struct encoder_settings : public to_headset::video_stream_description::item
 	int group = 0;
 	int bit_depth;
 	std::optional<std::string> device;
+	int intra_refresh = 0; // frames in an intra refresh cycle, 0 to sync with IDR frames
+	float foveation_qp = 0; // QP offset per doubling of the foveation pixel ratio
+	int threads = 0;        // for software encoders, 0 for automatic
+	uint8_t pipeline_depth = 1; // frames in flight, set from the pipeline-depth configuration
+	// for raw encoder
+	raw_chunk_header::compression_t compression = raw_chunk_header::compression_t::none;
+	bool delta = false; // xor with the previous frame before compression
 };
 
 std::vector<encoder_settings> get_encoder_settings(wivrn_vk_bundle &, uint32_t & width, uint32_t & height, const from_headset::headset_info_packet & info);
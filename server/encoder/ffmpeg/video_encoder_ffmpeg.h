@@ -38,8 +38,8 @@ public:
 	};
 
 protected:
-	video_encoder_ffmpeg(uint8_t stream_idx, to_headset::video_stream_description::channels_t channels, double bitrate_multiplier) :
-	        wivrn::video_encoder(stream_idx, channels, bitrate_multiplier, true) {}
+	video_encoder_ffmpeg(uint8_t stream_idx, to_headset::video_stream_description::channels_t channels, double bitrate_multiplier, uint8_t num_slots) :
+	        wivrn::video_encoder(stream_idx, channels, bitrate_multiplier, num_slots, true) {}
 
 	virtual void push_frame(bool idr, std::chrono::steady_clock::time_point pts, uint8_t slot) = 0;
 
@@ -43,7 +43,7 @@ class video_encoder_va : public video_encoder_ffmpeg
 		std::vector<vk::raii::DeviceMemory> mem;
 	};
 	av_buffer_ptr drm_frame_ctx;
-	std::array<in_t, num_slots> in;
+	std::vector<in_t> in;
 	vk::Rect2D rect;
 	bool synchronization2 = false;
 
@@ -0,0 +1,131 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "probe_cache.h"
+
+#include "util/u_logging.h"
+#include "utils/wivrn_vk_bundle.h"
+#include "utils/xdg_base_directory.h"
+#include "version.h"
+#include "wivrn_config.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <nlohmann/json.hpp>
+#include <sstream>
+
+#if WIVRN_USE_VAAPI
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+#endif
+
+namespace wivrn
+{
+
+static std::filesystem::path cache_file()
+{
+	return xdg_cache_home() / "wivrn" / "encoder_probes.json";
+}
+
+probe_cache::probe_cache(wivrn_vk_bundle & bundle)
+{
+	auto [props, id_props] = bundle.physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+
+	std::stringstream str;
+	str << std::hex << std::setfill('0');
+	for (auto byte: id_props.deviceUUID)
+		str << std::setw(2) << int(byte);
+	str << "-" << props.properties.driverVersion;
+#if WIVRN_USE_VAAPI
+	str << "-" << avcodec_version();
+#endif
+	str << "-" << git_version;
+	key = str.str();
+
+	try
+	{
+		std::ifstream file(cache_file());
+		if (not file)
+			return;
+		auto json = nlohmann::json::parse(file);
+		if (json.value("key", "") != key)
+		{
+			U_LOG_I("GPU, driver or encoders changed, encoders will be probed again");
+			return;
+		}
+		results = json.at("results").get<std::map<std::string, bool>>();
+		std::erase_if(results, [](const auto & item) { return not item.second; });
+	}
+	catch (std::exception & e)
+	{
+		U_LOG_W("Failed to read encoder probe cache: %s", e.what());
+		results.clear();
+	}
+}
+
+probe_cache::~probe_cache()
+{
+	if (not modified)
+		return;
+
+	try
+	{
+		auto path = cache_file();
+		std::filesystem::create_directories(path.parent_path());
+		std::ofstream(path) << nlohmann::json{{"key", key}, {"results", results}};
+	}
+	catch (std::exception & e)
+	{
+		U_LOG_W("Failed to save encoder probe cache: %s", e.what());
+	}
+}
+
+bool probe_cache::get(const std::string & name, const std::function<bool()> & probe)
+{
+	if (auto it = results.find(name); it != results.end())
+	{
+		U_LOG_D("Encoder probe %s: supported (cached)", name.c_str());
+		return it->second;
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	bool res = probe();
+	U_LOG_I("Encoder probe %s: %s in %.1fms",
+	        name.c_str(),
+	        res ? "supported" : "not supported",
+	        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+	// A failure may be transient (device busy, driver not loaded yet),
+	// only successful probes are saved so that failed ones run again
+	if (res)
+	{
+		results[name] = res;
+		modified = true;
+	}
+	return res;
+}
+
+void probe_cache::clear()
+{
+	std::error_code ec;
+	std::filesystem::remove(cache_file(), ec);
+}
+} // namespace wivrn
@@ -0,0 +1,48 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+namespace wivrn
+{
+struct wivrn_vk_bundle;
+
+// Successful encoder probes, saved between sessions.
+// They are discarded when the GPU, its driver or the encoding libraries change.
+class probe_cache
+{
+	std::string key;
+	std::map<std::string, bool> results;
+	bool modified = false;
+
+public:
+	explicit probe_cache(wivrn_vk_bundle &);
+	~probe_cache();
+
+	// Return true if name is known to be supported, or run the probe and save
+	// its result if it succeeds
+	bool get(const std::string & name, const std::function<bool()> & probe);
+
+	// Forget all results, for instance when a probed encoder failed
+	static void clear();
+};
+} // namespace wivrn
@@ -25,6 +25,8 @@
 #include "encoder_settings.h"
 #include "os/os_time.h"
 #include "util/u_logging.h"
+#include "utils/thread_profile.h"
+#include "utils/tracing.h"
 #include "wivrn_config.h"
 
 #include <string>
@@ -38,6 +40,9 @@
 #if WIVRN_USE_X264
 #include "video_encoder_x264.h"
 #endif
+#if WIVRN_USE_X265
+#include "video_encoder_x265.h"
+#endif
 #if WIVRN_USE_VULKAN_ENCODE
 #include "video_encoder_vulkan_h264.h"
 // #include "video_encoder_vulkan_h265.h"
@@ -49,6 +54,8 @@ namespace wivrn
 
 video_encoder::sender::sender() :
         thread([this](std::stop_token t) {
+	        pthread_setname_np(pthread_self(), "video sender");
+	        apply_thread_profile(thread_role::sender);
 	        while (not t.stop_requested())
 	        {
 		        data * d = nullptr;
@@ -61,6 +68,7 @@ video_encoder::sender::sender() :
 		        }
 		        if (d and not d->span.empty())
 		        {
+			        WIVRN_TRACE_SCOPE("sender");
 			        d->encoder->SendData(d->span, true, d->prefer_control);
 			        std::unique_lock lock(mutex);
 			        pending.pop_front();
@@ -140,6 +148,14 @@ std::unique_ptr<video_encoder> video_encoder::create(
 		res = std::make_unique<video_encoder_x264>(wivrn_vk, settings, fps, stream_idx);
 #else
 		throw std::runtime_error("x264 encoder not enabled");
+#endif
+	}
+	if (settings.encoder_name == encoder_x265)
+	{
+#if WIVRN_USE_X265
+		res = std::make_unique<video_encoder_x265>(wivrn_vk, settings, fps, stream_idx);
+#else
+		throw std::runtime_error("x265 encoder not enabled");
 #endif
 	}
 	if (settings.encoder_name == encoder_nvenc)
@@ -184,19 +200,28 @@ std::unique_ptr<video_encoder> video_encoder::create(
 				file += ".av1";
 				break;
 			case raw:
-				file += ".yuv";
+				// frames are made of chunks, see raw_chunk.h
+				file += ".raw";
 				break;
 		}
-		res->video_dump.open(file);
+		try
+		{
+			res->video_dump.emplace(file);
+		}
+		catch (std::exception & e)
+		{
+			U_LOG_W("Cannot dump video: %s", e.what());
+		}
 	}
 	return res;
 }
 
 static const uint64_t idr_throttle = 100;
 
-video_encoder::video_encoder(uint8_t stream_idx, to_headset::video_stream_description::channels_t channels, double bitrate_multiplier, bool async_send) :
+video_encoder::video_encoder(uint8_t stream_idx, to_headset::video_stream_description::channels_t channels, double bitrate_multiplier, uint8_t num_slots, bool async_send) :
         stream_idx(stream_idx),
         channels(channels),
+        num_slots(std::clamp<uint8_t>(num_slots, 1, max_slots)),
         bitrate_multiplier(bitrate_multiplier),
         last_idr_frame(-idr_throttle),
         shared_sender(async_send ? sender::get() : nullptr)
@@ -210,12 +235,13 @@ video_encoder::~video_encoder()
 
 void video_encoder::on_feedback(const from_headset::feedback & feedback)
 {
-	if (not feedback.sent_to_decoder)
+	if (not feedback.sent_to_decoder and not invalidate_references(feedback.frame_index, feedback.frame_index))
 		sync_needed = true;
 }
 
 void video_encoder::reset()
 {
+	idr_needed = true;
 	sync_needed = true;
 }
 
@@ -243,9 +269,10 @@ void video_encoder::post_submit()
 	post_submit(present_slot);
 }
 
-void video_encoder::encode(wivrn_session & cnx,
+bool video_encoder::encode(wivrn_session & cnx,
                            const to_headset::video_stream_data_shard::view_info_t & view_info,
-                           uint64_t frame_index)
+                           uint64_t frame_index,
+                           bool unchanged)
 {
 	encode_slot = (encode_slot + 1) % num_slots;
 	assert(busy[encode_slot].load());
@@ -254,6 +281,16 @@ void video_encoder::encode(wivrn_session & cnx,
 	this->cnx = &cnx;
 	auto target_timestamp = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(view_info.display_time));
 	bool idr = sync_needed.exchange(false);
+	bool refresh = false;
+	if (idr and intra_refresh_period and not idr_needed)
+	{
+		idr = false;
+		// Don't start a new refresh while the headset is still recovering
+		if (refresh_remaining > 0)
+			sync_needed = true;
+		else
+			refresh = true;
+	}
 	// Throttle idr to prevent overloading the decoder
 	if (idr and frame_index < last_idr_frame + idr_throttle)
 	{
@@ -262,14 +299,59 @@ void video_encoder::encode(wivrn_session & cnx,
 		idr = false;
 	}
 	if (idr)
+	{
 		last_idr_frame = frame_index;
-	const char * extra = idr ? ",idr" : ",p";
+		idr_needed = false;
+	}
+	auto type = idr ? flight_recorder::frame_type::idr : refresh ? flight_recorder::frame_type::refresh : flight_recorder::frame_type::p;
 	clock = cnx.get_offset();
 
+	// Image on the headset may still be corrupted while refreshing, don't skip
+	if (unchanged and not idr and not refresh and refresh_remaining == 0 and last_encoded_frame and can_skip_frames())
+	{
+		cnx.dump_time(flight_recorder::event::repeat, frame_index, os_monotonic_get_ns(), stream_idx);
+		WIVRN_TRACE_INSTANT("repeat", os_monotonic_get_ns());
+		auto now = clock.to_headset(os_monotonic_get_ns());
+		try
+		{
+			cnx.send_stream(to_headset::video_stream_repeat{
+			        .stream_item_idx = stream_idx,
+			        .frame_idx = frame_index,
+			        .source_frame_idx = *last_encoded_frame,
+			        .view_info = view_info,
+			        .timing_info = {
+			                .encode_begin = now,
+			                .encode_end = now,
+			                .send_begin = now,
+			                .send_end = now,
+			        },
+			});
+		}
+		catch (...)
+		{
+			// Ignore network errors
+		}
+		busy[encode_slot] = false;
+		busy[encode_slot].notify_all();
+		return true;
+	}
+	last_encoded_frame = frame_index;
+
+	set_foveation(view_info.foveation);
+
+	if (refresh)
+	{
+		start_intra_refresh();
+		// A refresh requested in the middle of a cycle starts when the current one ends
+		refresh_remaining = 2 * intra_refresh_period;
+	}
+	else if (refresh_remaining > 0)
+		--refresh_remaining;
+
 	timing_info = {
 	        .encode_begin = clock.to_headset(os_monotonic_get_ns()),
 	};
-	cnx.dump_time("encode_begin", frame_index, os_monotonic_get_ns(), stream_idx, extra);
+	cnx.dump_time(flight_recorder::event::encode_begin, frame_index, os_monotonic_get_ns(), stream_idx, type);
 
 	// Prepare the video shard template
 	shard.stream_item_idx = stream_idx;
@@ -281,8 +363,9 @@ void video_encoder::encode(wivrn_session & cnx,
 	std::exception_ptr ex;
 	try
 	{
+		WIVRN_TRACE_SCOPE(idr ? "encode (idr)" : "encode", tracing::flow::begin, tracing::frame_id(stream_idx, frame_index));
 		auto data = encode(idr, target_timestamp, encode_slot);
-		cnx.dump_time("encode_end", frame_index, os_monotonic_get_ns(), stream_idx, extra);
+		cnx.dump_time(flight_recorder::event::encode_end, frame_index, os_monotonic_get_ns(), stream_idx, type);
 		if (data)
 		{
 			timing_info.encode_end = clock.to_headset(os_monotonic_get_ns());
@@ -298,11 +381,44 @@ void video_encoder::encode(wivrn_session & cnx,
 	busy[encode_slot].notify_all();
 	if (ex)
 		std::rethrow_exception(ex);
+	return false;
+}
+
+void video_encoder::encode(bool idr, uint64_t frame_index, const std::function<void(std::span<uint8_t> data, bool end_of_frame)> & output)
+{
+	encode_slot = (encode_slot + 1) % num_slots;
+	assert(busy[encode_slot].load());
+	offline_output = &output;
+	shard.frame_idx = frame_index;
+
+	std::exception_ptr ex;
+	try
+	{
+		auto data = encode(idr, std::chrono::steady_clock::now(), encode_slot);
+		if (data)
+			SendData(data->span, true);
+	}
+	catch (...)
+	{
+		ex = std::current_exception();
+	}
+	offline_output = nullptr;
+	busy[encode_slot] = false;
+	busy[encode_slot].notify_all();
+	if (ex)
+		std::rethrow_exception(ex);
 }
 
 void video_encoder::SendData(std::span<uint8_t> data, bool end_of_frame, bool control)
 {
 	std::lock_guard lock(mutex);
+	if (offline_output)
+	{
+		if (video_dump)
+			video_dump->write(data);
+		(*offline_output)(data, end_of_frame);
+		return;
+	}
 	if (end_of_frame)
 	{
 		timing_info.send_end = clock.to_headset(os_monotonic_get_ns());
@@ -310,10 +426,10 @@ void video_encoder::SendData(std::span<uint8_t> data, bool end_of_frame, bool co
 			timing_info.encode_end = timing_info.send_end;
 	}
 	if (video_dump)
-		video_dump.write((char *)data.data(), data.size());
+		video_dump->write(data);
 	if (shard.shard_idx == 0)
 	{
-		cnx->dump_time("send_begin", shard.frame_idx, os_monotonic_get_ns(), stream_idx);
+		cnx->dump_time(flight_recorder::event::send_begin, shard.frame_idx, os_monotonic_get_ns(), stream_idx);
 		timing_info.send_begin = clock.to_headset(os_monotonic_get_ns());
 	}
 
@@ -353,7 +469,11 @@ void video_encoder::SendData(std::span<uint8_t> data, bool end_of_frame, bool co
 		begin = next;
 	}
 	if (end_of_frame)
-		cnx->dump_time("send_end", shard.frame_idx, os_monotonic_get_ns(), stream_idx);
+	{
+		WIVRN_TRACE_SLICE("send", clock.from_headset(timing_info.send_begin), os_monotonic_get_ns(), tracing::flow::step, tracing::frame_id(stream_idx, shard.frame_idx));
+		cnx->dump_time(flight_recorder::event::send_end, shard.frame_idx, os_monotonic_get_ns(), stream_idx);
+		cnx->startup_step("first frame sent", true);
+	}
 }
 
 } // namespace wivrn
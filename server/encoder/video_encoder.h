@@ -20,15 +20,17 @@
 #pragma once
 
 #include "driver/clock_offset.h"
+#include "utils/async_writer.h"
 #include "wivrn_packets.h"
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
-#include <fstream>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
 #include <vulkan/vulkan_raii.hpp>
 
@@ -42,6 +44,7 @@ class wivrn_session;
 inline const char * encoder_nvenc = "nvenc";
 inline const char * encoder_vaapi = "vaapi";
 inline const char * encoder_x264 = "x264";
+inline const char * encoder_x265 = "x265";
 inline const char * encoder_vulkan = "vulkan";
 inline const char * encoder_raw = "raw";
 
@@ -76,12 +79,15 @@ private:
 public:
 	const uint8_t stream_idx;
 	const to_headset::video_stream_description::channels_t channels;
-	static const uint8_t num_slots = 2;
+	// maximum value of the pipeline-depth configuration
+	static const uint8_t max_slots = 3;
+	// number of frames in flight, each slot has its own input buffers
+	const uint8_t num_slots;
 	const double bitrate_multiplier;
 
 private:
 	std::mutex mutex;
-	std::array<std::atomic<bool>, num_slots> busy = {false, false};
+	std::array<std::atomic<bool>, max_slots> busy{};
 	uint8_t present_slot = 0;
 	uint8_t encode_slot = 0;
 
@@ -95,16 +101,33 @@ private:
 	clock_offset clock;
 
 	std::atomic_bool sync_needed = true;
+	// the headset decoder was reset, sync cannot be done with an intra refresh
+	std::atomic_bool idr_needed = true;
 	uint64_t last_idr_frame;
+	// encoded frames until the headset is known to have recovered from the last intra refresh
+	uint64_t refresh_remaining = 0;
+	// Last frame that was actually encoded, source for repeated frames
+	std::optional<uint64_t> last_encoded_frame;
 
-	std::ofstream video_dump;
+	// WIVRN_DUMP_VIDEO output, written from a separate thread so that slow disks do not delay the stream
+	std::optional<utils::async_writer> video_dump;
 
 	std::shared_ptr<sender> shared_sender;
 
+	// set while encoding without a session, receives the data instead of the headset
+	const std::function<void(std::span<uint8_t>, bool)> * offline_output = nullptr;
+
 protected:
 	std::atomic_int pending_bitrate;
 	std::atomic<float> pending_framerate;
 
+	// number of frames in an intra refresh cycle, 0 if sync is done with IDR frames
+	uint64_t intra_refresh_period = 0;
+	// called before encode when sync is done with an intra refresh instead of an IDR
+	virtual void start_intra_refresh() {}
+	// called before encode with the foveation of the frame
+	virtual void set_foveation(const std::array<to_headset::foveation_parameter, 2> &) {}
+
 public:
 	static std::unique_ptr<video_encoder> create(
 	        wivrn_vk_bundle &,
@@ -114,7 +137,7 @@ public:
 	        int input_height,
 	        float fps);
 
-	video_encoder(uint8_t stream_idx, to_headset::video_stream_description::channels_t channels, double bitrate_multiplier, bool async_send);
+	video_encoder(uint8_t stream_idx, to_headset::video_stream_description::channels_t channels, double bitrate_multiplier, uint8_t num_slots, bool async_send);
 	virtual ~video_encoder();
 
 	// return value: true if image should be transitioned to queue and layout for vulkan video encode
@@ -123,13 +146,26 @@ public:
 	void post_submit();
 
 	virtual void on_feedback(const from_headset::feedback &);
+	// called when frames first..last could not be decoded by the headset,
+	// return false if the encoder cannot recover without an IDR
+	virtual bool invalidate_references(uint64_t first, uint64_t last)
+	{
+		return false;
+	}
 	virtual void reset();
 	void set_bitrate(int bitrate_bps);
 	void set_framerate(float framerate);
 
-	void encode(wivrn_session & cnx,
+	// unchanged: image is identical to the previous frame, it may be sent as a repeat instead of encoded
+	// return value: true if the frame was sent as a repeat
+	bool encode(wivrn_session & cnx,
 	            const to_headset::video_stream_data_shard::view_info_t & view_info,
-	            uint64_t frame_index);
+	            uint64_t frame_index,
+	            bool unchanged);
+
+	// Encode the last presented image without a session, for offline tools.
+	// output is called with the encoded data and true for the last call of the frame.
+	void encode(bool idr, uint64_t frame_index, const std::function<void(std::span<uint8_t> data, bool end_of_frame)> & output);
 
 	// called on present to submit command buffers for the image.
 	virtual std::pair<bool, vk::Semaphore> present_image(vk::Image y_cbcr, vk::raii::CommandBuffer & cmd_buf, uint8_t slot, uint64_t frame_index) = 0;
@@ -137,6 +173,11 @@ public:
 	virtual void post_submit(uint8_t slot) {}
 	// called when command buffer finished executing
 	virtual std::optional<data> encode(bool idr, std::chrono::steady_clock::time_point target_timestamp, uint8_t slot) = 0;
+	// false if the command buffer passed in present_image already encodes the frame
+	virtual bool can_skip_frames() const
+	{
+		return true;
+	}
 
 	void SendData(std::span<uint8_t> data, bool end_of_frame, bool control = false);
 };
@@ -85,9 +85,10 @@ video_encoder_nvenc::video_encoder_nvenc(
         encoder_settings & settings,
         float fps,
         uint8_t stream_idx) :
-        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, true),
+        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, settings.pipeline_depth, true),
         vk(vk),
         shared_state(video_encoder_nvenc_shared_state::get()),
+        in(num_slots),
         fps(fps),
         bitrate(settings.bitrate)
 {
@@ -48,7 +48,7 @@ private:
 		vk::raii::DeviceMemory mem = nullptr;
 		NV_ENC_REGISTERED_PTR nvenc_resource;
 	};
-	std::array<in_t, num_slots> in;
+	std::vector<in_t> in;
 
 	float fps;
 	int bitrate;
@@ -19,14 +19,27 @@
 #include "video_encoder_raw.h"
 
 #include "encoder/encoder_settings.h"
+#include "util/u_logging.h"
 #include "utils/wivrn_vk_bundle.h"
 
+#include <algorithm>
+#include <cstring>
+#include <lz4.h>
+#include <thread>
+
+// Statistics are logged with this period
+static const auto report_period = std::chrono::seconds(10);
+
 wivrn::video_encoder_raw::video_encoder_raw(
         wivrn_vk_bundle & vk,
         encoder_settings & settings,
         float fps,
         uint8_t stream_idx) :
-        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, true)
+        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, settings.pipeline_depth, true),
+        buffers(num_slots),
+        slot_frame_index(num_slots),
+        compression(settings.compression),
+        delta(settings.delta and settings.compression != raw_chunk_header::compression_t::none)
 {
 	if (settings.bit_depth != 8)
 		throw std::runtime_error("Raw encoding is only supported for 8 bit");
@@ -41,21 +54,23 @@ wivrn::video_encoder_raw::video_encoder_raw(
 	        },
 	};
 
-	vk::DeviceSize buffer_size = settings.width * settings.height;
+	size_t rows = settings.height;
 	switch (settings.channels)
 	{
 		case to_headset::video_stream_description::channels_t::colour:
-			buffer_size += buffer_size / 2;
+			rows += settings.height / 2;
 			break;
 		case to_headset::video_stream_description::channels_t::alpha:
 			break;
 	}
+	frame_size = rows * settings.width;
+
 	for (auto & slot: buffers)
 	{
 		slot = buffer_allocation(
 		        vk.device,
 		        {
-		                .size = buffer_size,
+		                .size = sizeof(raw_chunk_header) + frame_size,
 		                .usage = vk::BufferUsageFlagBits::eTransferDst,
 		        },
 		        {
@@ -64,12 +79,40 @@ wivrn::video_encoder_raw::video_encoder_raw(
 		        },
 		        "raw stream buffer");
 	}
+
+	if (compression == raw_chunk_header::compression_t::none)
+		return;
+
+	// Chunks are made of whole rows, a few per thread to balance the load
+	pool = std::make_unique<utils::task_pool>("raw_encoder", std::clamp(std::thread::hardware_concurrency() / 2, 1u, 8u));
+	size_t chunk_count = std::min(rows, 2 * pool->size());
+	chunks.resize(chunk_count);
+	for (size_t i = 0; i < chunk_count; ++i)
+	{
+		auto & c = chunks[i];
+		size_t begin = rows * i / chunk_count;
+		size_t end = rows * (i + 1) / chunk_count;
+		c.header = {
+		        .offset = uint32_t(begin * settings.width),
+		        .size = uint32_t((end - begin) * settings.width),
+		};
+		c.out.resize(sizeof(raw_chunk_header) + LZ4_compressBound(c.header.size));
+		if (delta)
+			c.difference.resize(c.header.size);
+	}
+	if (delta)
+		reference.resize(frame_size);
+	chunk_ready = std::make_unique<std::atomic<bool>[]>(chunk_count);
+
+	U_LOG_I("raw stream %d: lz4 compression in %zu chunks%s", stream_idx, chunk_count, delta ? ", delta with previous frame" : "");
 }
 
-std::pair<bool, vk::Semaphore> wivrn::video_encoder_raw::present_image(vk::Image y_cbcr, vk::raii::CommandBuffer & cmd_buf, uint8_t slot, uint64_t)
+std::pair<bool, vk::Semaphore> wivrn::video_encoder_raw::present_image(vk::Image y_cbcr, vk::raii::CommandBuffer & cmd_buf, uint8_t slot, uint64_t frame_index)
 {
+	slot_frame_index[slot] = frame_index;
 	std::array regions{
 	        vk::BufferImageCopy{
+	                .bufferOffset = sizeof(raw_chunk_header),
 	                .imageSubresource = {
 	                        .aspectMask = vk::ImageAspectFlagBits::ePlane0,
 	                        .baseArrayLayer = uint32_t(channels),
@@ -86,7 +129,7 @@ std::pair<bool, vk::Semaphore> wivrn::video_encoder_raw::present_image(vk::Image
 	                },
 	        },
 	        vk::BufferImageCopy{
-	                .bufferOffset = rect.extent.width * rect.extent.height,
+	                .bufferOffset = sizeof(raw_chunk_header) + rect.extent.width * rect.extent.height,
 	                .imageSubresource = {
 	                        .aspectMask = vk::ImageAspectFlagBits::ePlane1,
 	                        .baseArrayLayer = uint32_t(channels),
@@ -112,10 +155,127 @@ std::pair<bool, vk::Semaphore> wivrn::video_encoder_raw::present_image(vk::Image
 	return {false, nullptr};
 }
 
+void wivrn::video_encoder_raw::compress(chunk & c, const uint8_t * image, bool use_delta)
+{
+	auto & header = c.header;
+	const uint8_t * src = image + header.offset;
+	if (use_delta)
+	{
+		const uint8_t * ref = reference.data() + header.offset;
+		for (size_t i = 0; i < header.size; ++i)
+			c.difference[i] = src[i] ^ ref[i];
+		src = c.difference.data();
+	}
+
+	header.flags = use_delta ? raw_chunk_header::delta : 0;
+	header.reference_frame = use_delta ? *reference_frame : 0;
+
+	uint8_t * dst = c.out.data() + sizeof(raw_chunk_header);
+	int size = LZ4_compress_default((const char *)src, (char *)dst, header.size, c.out.size() - sizeof(raw_chunk_header));
+	if (size > 0 and uint32_t(size) < header.size)
+	{
+		header.compression = raw_chunk_header::compression_t::lz4;
+		header.compressed_size = size;
+	}
+	else
+	{
+		// Incompressible data
+		header.compression = raw_chunk_header::compression_t::none;
+		header.compressed_size = header.size;
+		memcpy(dst, src, header.size);
+	}
+	memcpy(c.out.data(), &header, sizeof(header));
+
+	if (delta)
+		memcpy(reference.data() + header.offset, image + header.offset, header.size);
+}
+
+void wivrn::video_encoder_raw::report(std::chrono::nanoseconds duration, size_t size)
+{
+	++stats.frames;
+	stats.in_bytes += frame_size;
+	stats.out_bytes += size;
+	stats.total_time += duration;
+	stats.max_time = std::max(stats.max_time, duration);
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - stats.begin < report_period)
+		return;
+
+	U_LOG_I("raw stream %d: compression ratio %.2f, %.2fms per frame (max %.2fms)",
+	        stream_idx,
+	        double(stats.in_bytes) / std::max<uint64_t>(stats.out_bytes, 1),
+	        std::chrono::duration<double, std::milli>(stats.total_time).count() / stats.frames,
+	        std::chrono::duration<double, std::milli>(stats.max_time).count());
+	stats = {};
+	stats.begin = now;
+}
+
+bool wivrn::video_encoder_raw::invalidate_references(uint64_t first, uint64_t last)
+{
+	// Without delta, frames don't depend on each other
+	if (not delta)
+		return true;
+
+	// Actual invalidation is done in the encoder thread
+	uint64_t current = first_lost_frame.load();
+	while (first < current and not first_lost_frame.compare_exchange_weak(current, first))
+	{
+	}
+	return true;
+}
+
 std::optional<wivrn::video_encoder::data> wivrn::video_encoder_raw::encode(bool idr, std::chrono::steady_clock::time_point pts, uint8_t slot)
 {
-	return wivrn::video_encoder::data{
-	        .encoder = this,
-	        .span = std::span<uint8_t>((uint8_t *)buffers[slot].map(), buffers[slot].info().size),
-	};
+	auto mapped = (uint8_t *)buffers[slot].map();
+	if (compression == raw_chunk_header::compression_t::none)
+	{
+		raw_chunk_header header{
+		        .size = uint32_t(frame_size),
+		        .compressed_size = uint32_t(frame_size),
+		};
+		memcpy(mapped, &header, sizeof(header));
+		return wivrn::video_encoder::data{
+		        .encoder = this,
+		        .span = std::span<uint8_t>(mapped, sizeof(header) + frame_size),
+		};
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	const uint8_t * image = mapped + sizeof(raw_chunk_header);
+	// The headset drops delta frames after a loss, unless a full frame has
+	// been sent since, the next one must not depend on the lost frames
+	if (auto lost = first_lost_frame.exchange(-1); lost != uint64_t(-1) and lost >= last_full_frame)
+		reference_frame.reset();
+	bool use_delta = delta and not idr and reference_frame;
+	if (not use_delta)
+		last_full_frame = slot_frame_index[slot];
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		chunk_ready[i] = false;
+		pool->push([this, i, image, use_delta]() {
+			compress(chunks[i], image, use_delta);
+			chunk_ready[i] = true;
+			chunk_ready[i].notify_all();
+		});
+	}
+
+	// Each chunk is a slice, the headset decompresses it while the next
+	// ones are compressed and sent
+	size_t size = 0;
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		chunk_ready[i].wait(false);
+		auto & c = chunks[i];
+		size_t chunk_size = sizeof(raw_chunk_header) + c.header.compressed_size;
+		SendData({c.out.data(), chunk_size}, i + 1 == chunks.size());
+		size += chunk_size;
+	}
+	pool->wait();
+	if (delta)
+		reference_frame = slot_frame_index[slot];
+
+	report(std::chrono::steady_clock::now() - begin, size);
+
+	return {};
 }
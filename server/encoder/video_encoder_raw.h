@@ -18,24 +18,72 @@
 
 #pragma once
 
+#include "raw_chunk.h"
+#include "utils/task_pool.h"
 #include "video_encoder.h"
 #include "vk/allocation.h"
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
 
 namespace wivrn
 {
 
 class video_encoder_raw : public video_encoder
 {
-	std::array<buffer_allocation, num_slots> buffers;
+	// images are copied after a chunk header, so uncompressed frames are sent without copy
+	std::vector<buffer_allocation> buffers;
+	std::vector<uint64_t> slot_frame_index;
 	vk::Rect2D rect;
+	size_t frame_size;
+
+	raw_chunk_header::compression_t compression;
+	bool delta;
+
+	struct chunk
+	{
+		raw_chunk_header header;
+		// image xor'ed with the reference
+		std::vector<uint8_t> difference;
+		// header followed by compressed data
+		std::vector<uint8_t> out;
+	};
+	std::vector<chunk> chunks;
+	// set when the chunk of the same index is compressed, chunks are sent in
+	// order as soon as they are ready
+	std::unique_ptr<std::atomic<bool>[]> chunk_ready;
+	std::unique_ptr<utils::task_pool> pool;
+
+	// last encoded frame, for delta compression
+	std::vector<uint8_t> reference;
+	std::optional<uint64_t> reference_frame;
+	uint64_t last_full_frame = 0;
+	// set by invalidate_references, the next frame is then sent without delta
+	std::atomic<uint64_t> first_lost_frame = -1;
+
+	struct
+	{
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		uint64_t frames = 0;
+		uint64_t in_bytes = 0;
+		uint64_t out_bytes = 0;
+		std::chrono::nanoseconds total_time{};
+		std::chrono::nanoseconds max_time{};
+	} stats;
+
+	void compress(chunk &, const uint8_t * image, bool use_delta);
+	void report(std::chrono::nanoseconds duration, size_t size);
 
 public:
 	video_encoder_raw(wivrn_vk_bundle & vk, encoder_settings & settings, float fps, uint8_t stream_idx);
 
 	std::pair<bool, vk::Semaphore> present_image(vk::Image y_cbcr, vk::raii::CommandBuffer & cmd_buf, uint8_t slot, uint64_t frame_index) override;
 
+	bool invalidate_references(uint64_t first, uint64_t last) override;
+
 	std::optional<data> encode(bool idr, std::chrono::steady_clock::time_point pts, uint8_t slot) override;
 };
 } // namespace wivrn
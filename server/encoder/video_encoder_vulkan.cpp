@@ -62,9 +62,10 @@ wivrn::video_encoder_vulkan::video_encoder_vulkan(
         float fps,
         uint8_t stream_idx,
         const encoder_settings & settings) :
-        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, true),
+        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, settings.pipeline_depth, true),
         vk(vk),
         encode_caps(patch_capabilities(in_encode_caps)),
+        slot_data(num_slots),
         rect(rect),
         num_dpb_slots(std::min(video_caps.maxDpbSlots, 16u))
 {
@@ -54,7 +54,7 @@ class video_encoder_vulkan : public video_encoder
 		buffer_allocation host_buffer;
 		bool idr = false;
 	};
-	std::array<slot_item, num_slots> slot_data;
+	std::vector<slot_item> slot_data;
 
 	image_allocation dpb_image;
 
@@ -113,5 +113,9 @@ public:
 	std::pair<bool, vk::Semaphore> present_image(vk::Image y_cbcr, vk::raii::CommandBuffer & cmd_buf, uint8_t slot, uint64_t frame_index) override;
 	void post_submit(uint8_t slot) override;
 	void on_feedback(const from_headset::feedback &) override;
+	bool can_skip_frames() const override
+	{
+		return false;
+	}
 };
 } // namespace wivrn
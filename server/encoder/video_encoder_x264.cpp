@@ -24,22 +24,34 @@
 #include "util/u_logging.h"
 #include "utils/wivrn_vk_bundle.h"
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
 namespace wivrn
 {
 
+// log2 of the number of source pixels for each pixel of the foveated image
+static std::vector<float> log_ratios(const std::vector<uint16_t> & param)
+{
+	std::vector<float> res;
+	int middle = param.size() / 2;
+	for (int i = 0; i < int(param.size()); ++i)
+		res.insert(res.end(), param[i], std::log2(1 + std::abs(i - middle)));
+	return res;
+}
+
 void video_encoder_x264::ProcessCb(x264_t * h, x264_nal_t * nal, void * opaque)
 {
 	video_encoder_x264 * self = (video_encoder_x264 *)opaque;
-	std::vector<uint8_t> data(nal->i_payload * 3 / 2 + 5 + 64, 0);
+	auto data = self->get_buffer(nal->i_payload * 3 / 2 + 5 + 64);
 	x264_nal_encode(h, data.data(), nal);
-	data.resize(nal->i_payload);
 	switch (nal->i_type)
 	{
 		case NAL_SPS:
 		case NAL_PPS: {
-			self->SendData(data, false);
+			self->SendData({data.data(), size_t(nal->i_payload)}, false);
+			self->release_buffer(std::move(data));
 			break;
 		}
 		case NAL_SLICE:
@@ -47,43 +59,69 @@ void video_encoder_x264::ProcessCb(x264_t * h, x264_nal_t * nal, void * opaque)
 		case NAL_SLICE_DPB:
 		case NAL_SLICE_DPC:
 		case NAL_SLICE_IDR:
-			self->ProcessNal({nal->i_first_mb, nal->i_last_mb, std::move(data)});
+			self->ProcessNal({nal->i_first_mb, nal->i_last_mb, size_t(nal->i_payload), std::move(data)});
+			break;
+		default:
+			self->release_buffer(std::move(data));
 	}
 }
 
+std::vector<uint8_t> video_encoder_x264::get_buffer(size_t size)
+{
+	std::vector<uint8_t> res;
+	{
+		std::lock_guard lock(buffers_mutex);
+		if (not free_buffers.empty())
+		{
+			res = std::move(free_buffers.back());
+			free_buffers.pop_back();
+		}
+	}
+	if (res.capacity() < size)
+		++buffer_allocations;
+	if (res.size() < size)
+		res.resize(size);
+	return res;
+}
+
+void video_encoder_x264::release_buffer(std::vector<uint8_t> && buffer)
+{
+	std::lock_guard lock(buffers_mutex);
+	free_buffers.push_back(std::move(buffer));
+}
+
 void video_encoder_x264::ProcessNal(pending_nal && nal)
 {
 	std::lock_guard lock(mutex);
 	if (nal.first_mb == next_mb)
 	{
 		next_mb = nal.last_mb + 1;
-		SendData(nal.data, next_mb == num_mb);
+		SendData({nal.data.data(), nal.size}, next_mb == num_mb);
+		release_buffer(std::move(nal.data));
 	}
 	else
 	{
-		InsertInPendingNal(std::move(nal));
-	}
-	while ((not pending_nals.empty()) and pending_nals.front().first_mb == next_mb)
-	{
-		next_mb = pending_nals.front().last_mb + 1;
-		SendData(pending_nals.front().data, next_mb == num_mb);
-		pending_nals.pop_front();
-	}
-}
-
-void video_encoder_x264::InsertInPendingNal(pending_nal && nal)
-{
-	auto it = pending_nals.begin();
-	auto end = pending_nals.end();
-	for (; it != end; ++it)
-	{
-		if (it->first_mb > nal.last_mb)
+		// Slices start on a new macroblock row
+		auto & slot = pending_nals[nal.first_mb / mb_width];
+		if (nal.first_mb % mb_width != 0 or slot.first_mb >= 0)
 		{
-			pending_nals.insert(it, std::move(nal));
-			return;
+			U_LOG_W("unexpected slice layout, first macroblock %d", nal.first_mb);
+			SendData({nal.data.data(), nal.size}, false);
+			release_buffer(std::move(nal.data));
 		}
+		else
+			slot = std::move(nal);
+	}
+	while (next_mb < num_mb)
+	{
+		auto & slot = pending_nals[next_mb / mb_width];
+		if (slot.first_mb != next_mb)
+			break;
+		next_mb = slot.last_mb + 1;
+		SendData({slot.data.data(), slot.size}, next_mb == num_mb);
+		release_buffer(std::move(slot.data));
+		slot.first_mb = -1;
 	}
-	pending_nals.push_back(std::move(nal));
 }
 
 video_encoder_x264::video_encoder_x264(
@@ -91,7 +129,9 @@ video_encoder_x264::video_encoder_x264(
         encoder_settings & settings,
         float fps,
         uint8_t stream_idx) :
-        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, false)
+        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, settings.pipeline_depth, false),
+        in(num_slots),
+        slot_frame_index(num_slots)
 {
 	if (settings.bit_depth != 8)
 		throw std::runtime_error("x264 encoder only supports 8-bit encoding");
@@ -119,12 +159,17 @@ video_encoder_x264::video_encoder_x264(
 	        },
 	};
 
-	num_mb = ((settings.video_width + 15) / 16) * ((settings.video_height + 15) / 16);
+	mb_width = (settings.video_width + 15) / 16;
+	num_mb = mb_width * ((settings.video_height + 15) / 16);
+	pending_nals.resize(num_mb / mb_width);
+	free_buffers.reserve(pending_nals.size() + 2);
 
 	x264_param_default_preset(&param, "ultrafast", "zerolatency");
 	param.nalu_process = &ProcessCb;
 	// param.i_slice_max_size = 1300;
 	param.i_slice_count = 32;
+	if (settings.threads > 0)
+		param.i_threads = settings.threads;
 	param.i_width = settings.video_width;
 	param.i_height = settings.video_height;
 	param.i_log_level = X264_LOG_WARNING;
@@ -133,6 +178,27 @@ video_encoder_x264::video_encoder_x264(
 	param.b_repeat_headers = 1;
 	param.b_aud = 0;
 	param.i_keyint_max = X264_KEYINT_MAX_INFINITE;
+	// keep older frames around, so that lost ones can be invalidated
+	// and the encoder can still predict from frames the headset decoded
+	param.i_dpb_size = encoded_frames.size() / 2;
+
+	foveation_qp = channels == to_headset::video_stream_description::channels_t::colour ? settings.foveation_qp : 0;
+	if (foveation_qp != 0)
+	{
+		// quant_offsets are ignored without adaptive quantization
+		param.rc.i_aq_mode = X264_AQ_VARIANCE;
+	}
+
+	if (settings.intra_refresh > 0)
+	{
+		// Replace IDR frames with a column of intra macroblocks sweeping
+		// over the image, this keeps frame sizes within the VBV.
+		// i_keyint_max stays infinite so that a refresh only starts when
+		// requested with x264_encoder_intra_refresh, x264 then moves the
+		// column by one macroblock per frame.
+		param.b_intra_refresh = 1;
+		intra_refresh_period = std::max<uint64_t>(settings.intra_refresh, (settings.width + 15) / 16);
+	}
 
 	// colour definitions, actually ignored by decoder
 	param.vui.b_fullrange = 1;
@@ -194,8 +260,9 @@ video_encoder_x264::video_encoder_x264(
 	}
 }
 
-std::pair<bool, vk::Semaphore> video_encoder_x264::present_image(vk::Image y_cbcr, vk::raii::CommandBuffer & cmd_buf, uint8_t slot, uint64_t)
+std::pair<bool, vk::Semaphore> video_encoder_x264::present_image(vk::Image y_cbcr, vk::raii::CommandBuffer & cmd_buf, uint8_t slot, uint64_t frame_index)
 {
+	slot_frame_index[slot] = frame_index;
 	cmd_buf.copyImageToBuffer(
 	        y_cbcr,
 	        vk::ImageLayout::eTransferSrcOptimal,
@@ -259,27 +326,168 @@ std::optional<video_encoder::data> video_encoder_x264::encode(bool idr, std::chr
 	if (reconfigure)
 	{
 		x264_encoder_reconfig(enc, &param);
-		idr = true;
+		// With intra refresh, the new rate control applies to the refresh cycle
+		if (not intra_refresh_period)
+			idr = true;
+	}
+	auto frame_index = slot_frame_index[slot];
+	std::optional<uint64_t> recovering;
+	if (auto lost = first_lost_frame.exchange(-1); lost != uint64_t(-1) and not idr)
+	{
+		// Losses reported late for frames that were already invalidated,
+		// the recovery frame does not reference them
+		if (lost >= invalid_begin and lost < invalid_end)
+			U_LOG_D("x264 stream %d: frame %lu already invalidated", stream_idx, lost);
+		else if (invalidate(lost))
+			recovering = lost;
+		else
+			idr = true;
+	}
+	if (idr)
+	{
+		invalid_begin = 0;
+		invalid_end = frame_index;
+	}
+	else if (recovering)
+	{
+		// x264 invalidates all frames from the lost one, unless the
+		// previous recovery frame was lost, which extends the range
+		if (*recovering != invalid_end)
+			invalid_begin = *recovering;
+		invalid_end = frame_index;
 	}
 	int num_nal;
 	x264_nal_t * nal;
 	auto & pic = in[slot].pic;
 	pic.i_type = idr ? X264_TYPE_IDR : X264_TYPE_P;
 	pic.i_pts = pts.time_since_epoch().count();
+	pic.prop.quant_offsets = quant_offsets.empty() ? nullptr : quant_offsets.data();
+	encoded_frames[frame_index % encoded_frames.size()] = {
+	        .frame_index = frame_index,
+	        .pts = pic.i_pts,
+	};
 	next_mb = 0;
-	assert(pending_nals.empty());
 	int size = x264_encoder_encode(enc, &nal, &num_nal, &pic, &pic_out);
 	if (next_mb != num_mb)
 	{
 		U_LOG_W("unexpected macroblock count: %d", next_mb);
+		for (auto & slot: pending_nals)
+		{
+			if (slot.first_mb >= 0)
+				release_buffer(std::move(slot.data));
+			slot.first_mb = -1;
+		}
 	}
+	if (int allocations = buffer_allocations.exchange(0))
+		U_LOG_D("x264 stream %d: %d NAL buffer allocations", stream_idx, allocations);
 	if (size < 0)
 	{
 		U_LOG_W("x264_encoder_encode failed: %d", size);
 	}
+	else if (recovering)
+	{
+		U_LOG_D("x264 stream %d: recovered from loss of frame %lu with %s frame %lu (%d bytes)",
+		        stream_idx,
+		        *recovering,
+		        pic_out.b_keyframe ? "IDR" : "P",
+		        frame_index,
+		        size);
+	}
 	return {};
 }
 
+bool video_encoder_x264::invalidate_references(uint64_t first, uint64_t last)
+{
+	// x264 does not support invalidation with intra refresh
+	if (intra_refresh_period)
+		return false;
+
+	// The last recovery frame does not reference these frames
+	if (first >= invalid_begin and last < invalid_end)
+		return true;
+
+	// Actual invalidation is done in the encoder thread
+	uint64_t current = first_lost_frame.load();
+	while (first < current and not first_lost_frame.compare_exchange_weak(current, first))
+	{
+	}
+	return true;
+}
+
+void video_encoder_x264::start_intra_refresh()
+{
+	x264_encoder_intra_refresh(enc);
+}
+
+void video_encoder_x264::set_foveation(const std::array<to_headset::foveation_parameter, 2> & new_foveation)
+{
+	if (foveation_qp == 0)
+		return;
+
+	if (std::ranges::equal(foveation, new_foveation, [](const auto & a, const auto & b) { return a.x == b.x and a.y == b.y; }))
+		return;
+
+	foveation = new_foveation;
+	quant_offsets.clear();
+
+	std::array<std::vector<float>, 2> x;
+	std::array<std::vector<float>, 2> y;
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		x[eye] = log_ratios(foveation[eye].x);
+		y[eye] = log_ratios(foveation[eye].y);
+		if (x[eye].empty() or y[eye].empty())
+			return;
+	}
+
+	// Both eyes are side by side, sample the ratio at the centre of each macroblock
+	const int mb_width = (param.i_width + 15) / 16;
+	const int mb_height = (param.i_height + 15) / 16;
+	const int eye_width = x[0].size();
+	quant_offsets.resize(mb_width * mb_height);
+	bool foveated = false;
+	for (int mb_y = 0; mb_y < mb_height; ++mb_y)
+	{
+		int py = rect.offset.y + std::min<int>(mb_y * 16 + 8, rect.extent.height - 1);
+		for (int mb_x = 0; mb_x < mb_width; ++mb_x)
+		{
+			int px = rect.offset.x + std::min<int>(mb_x * 16 + 8, rect.extent.width - 1);
+			int eye = std::min(px / eye_width, 1);
+			px = std::min<int>(px - eye * eye_width, x[eye].size() - 1);
+			float log_ratio = x[eye][px] + y[eye][std::min<int>(py, y[eye].size() - 1)];
+			quant_offsets[mb_y * mb_width + mb_x] = foveation_qp * log_ratio;
+			foveated |= log_ratio != 0;
+		}
+	}
+
+	if (not foveated)
+		quant_offsets.clear();
+}
+
+bool video_encoder_x264::invalidate(uint64_t first_lost)
+{
+	const encoded_frame * first_invalid = nullptr;
+	uint64_t oldest = -1;
+	for (const auto & f: encoded_frames)
+	{
+		if (f.frame_index == uint64_t(-1))
+			continue;
+		oldest = std::min(oldest, f.frame_index);
+		if (f.frame_index >= first_lost and (not first_invalid or f.frame_index < first_invalid->frame_index))
+			first_invalid = &f;
+	}
+
+	// Too old, we don't know if the frame was used as reference
+	if (first_lost < oldest)
+		return false;
+
+	// Only repeated frames were lost, nothing to invalidate
+	if (not first_invalid)
+		return true;
+
+	return x264_encoder_invalidate_reference(enc, first_invalid->pts) == 0;
+}
+
 video_encoder_x264::~video_encoder_x264()
 {
 	x264_encoder_close(enc);
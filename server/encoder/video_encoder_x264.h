@@ -23,8 +23,10 @@
 #include "vk/allocation.h"
 #include "x264.h"
 
-#include <list>
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <vector>
 #include <vulkan/vulkan_raii.hpp>
 
 namespace wivrn
@@ -43,22 +45,54 @@ class video_encoder_x264 : public video_encoder
 		buffer_allocation luma;
 		buffer_allocation chroma;
 	};
-	std::array<in_t, num_slots> in;
+	std::vector<in_t> in;
 	uint32_t chroma_width;
 
 	vk::Rect2D rect;
 
 	struct pending_nal
 	{
-		int first_mb;
+		int first_mb = -1; // -1 if unused
 		int last_mb;
+		size_t size;
 		std::vector<uint8_t> data;
 	};
 
 	std::mutex mutex;
 	int next_mb;
-	int num_mb; // Number of macroblocks in a frame
-	std::list<pending_nal> pending_nals;
+	int num_mb;   // Number of macroblocks in a frame
+	int mb_width; // Number of macroblocks in a row
+	// Slices received out of order, indexed by the macroblock row where they start
+	std::vector<pending_nal> pending_nals;
+
+	// NAL buffers are recycled between frames
+	std::mutex buffers_mutex;
+	std::vector<std::vector<uint8_t>> free_buffers;
+	std::atomic_int buffer_allocations = 0;
+
+	// Recently encoded frames, to find the pts of lost frames
+	struct encoded_frame
+	{
+		uint64_t frame_index = -1;
+		int64_t pts;
+	};
+	std::array<encoded_frame, 16> encoded_frames;
+	std::vector<uint64_t> slot_frame_index;
+
+	// First frame that was not decoded by the headset, -1 if none
+	std::atomic<uint64_t> first_lost_frame = -1;
+	// Frames that are no longer used as references since the last IDR or
+	// recovery frame, losses among them are ignored.
+	// Written by the encoder thread, read when losses are reported.
+	std::atomic<uint64_t> invalid_begin = 0;
+	std::atomic<uint64_t> invalid_end = 0;
+
+	// QP offset for each doubling of the source pixel ratio, 0 if disabled
+	float foveation_qp;
+	// foveation used to compute quant_offsets
+	std::array<to_headset::foveation_parameter, 2> foveation;
+	// per macroblock, empty if not used
+	std::vector<float> quant_offsets;
 
 public:
 	video_encoder_x264(wivrn_vk_bundle & vk, encoder_settings & settings, float fps, uint8_t stream_idx);
@@ -67,14 +101,24 @@ public:
 
 	std::optional<data> encode(bool idr, std::chrono::steady_clock::time_point pts, uint8_t slot) override;
 
+	bool invalidate_references(uint64_t first, uint64_t last) override;
+
 	~video_encoder_x264();
 
+protected:
+	void start_intra_refresh() override;
+	void set_foveation(const std::array<to_headset::foveation_parameter, 2> &) override;
+
 private:
 	static void ProcessCb(x264_t * h, x264_nal_t * nal, void * opaque);
 
 	void ProcessNal(pending_nal && nal);
 
-	void InsertInPendingNal(pending_nal && nal);
+	std::vector<uint8_t> get_buffer(size_t size);
+	void release_buffer(std::vector<uint8_t> && buffer);
+
+	// return false if an IDR is required
+	bool invalidate(uint64_t first_lost);
 };
 
 } // namespace wivrn
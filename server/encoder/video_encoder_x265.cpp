@@ -0,0 +1,277 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "video_encoder_x265.h"
+
+#include "encoder_settings.h"
+#include "util/u_logging.h"
+#include "utils/wivrn_vk_bundle.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace wivrn
+{
+
+video_encoder_x265::video_encoder_x265(
+        wivrn_vk_bundle & vk,
+        encoder_settings & settings,
+        float fps,
+        uint8_t stream_idx) :
+        video_encoder(stream_idx, settings.channels, settings.bitrate_multiplier, settings.pipeline_depth, false),
+        in(num_slots)
+{
+	if (settings.bit_depth != 8)
+		throw std::runtime_error("x265 encoder only supports 8-bit encoding");
+
+	if (settings.codec != h265)
+	{
+		U_LOG_W("requested x265 encoder with codec != h265");
+		settings.codec = h265;
+	}
+
+	// encoder requires width and height to be even
+	settings.video_width += settings.video_width % 2;
+	settings.video_height += settings.video_height % 2;
+	chroma_width = settings.video_width / 2;
+	chroma_height = settings.video_height / 2;
+
+	rect = vk::Rect2D{
+	        .offset = {
+	                .x = settings.offset_x,
+	                .y = settings.offset_y,
+	        },
+	        .extent = {
+	                .width = settings.width,
+	                .height = settings.height,
+	        },
+	};
+
+	param = x265_param_alloc();
+	if (not param)
+		throw std::runtime_error("failed to allocate x265 parameters");
+
+	if (x265_param_default_preset(param, "ultrafast", "zerolatency") < 0)
+	{
+		x265_param_free(param);
+		throw std::runtime_error("failed to set x265 preset");
+	}
+
+	param->sourceWidth = settings.video_width;
+	param->sourceHeight = settings.video_height;
+	param->internalCsp = X265_CSP_I420;
+	param->fpsNum = fps * 1'000'000;
+	param->fpsDenom = 1'000'000;
+	param->bRepeatHeaders = 1;
+	param->bAnnexB = 1;
+	param->bEnableAccessUnitDelimiters = 0;
+	param->bEmitInfoSEI = 0;
+	param->keyframeMax = -1; // infinite
+	param->logLevel = X265_LOG_WARNING;
+	// Slices let the decoder work in parallel, x265 only outputs complete frames
+	param->maxSlices = 8;
+	if (settings.threads > 0)
+		x265_param_parse(param, "pools", std::to_string(settings.threads).c_str());
+
+	if (settings.intra_refresh > 0)
+	{
+		// x265 has no API to start a refresh, refresh is always periodic.
+		// intra_refresh_period stays 0 so that losses are recovered with
+		// IDR frames instead of waiting for the next refresh cycle.
+		param->bIntraRefresh = 1;
+		param->keyframeMax = settings.intra_refresh;
+	}
+
+	// colour definitions, actually ignored by decoder
+	param->vui.bEnableVideoSignalTypePresentFlag = 1;
+	param->vui.bEnableColorDescriptionPresentFlag = 1;
+	param->vui.bEnableVideoFullRangeFlag = 1;
+	param->vui.colorPrimaries = 1;           // BT.709
+	param->vui.matrixCoeffs = 1;             // BT.709
+	param->vui.transferCharacteristics = 13; // sRGB
+
+	param->vui.aspectRatioIdc = X265_EXTENDED_SAR;
+	param->vui.sarWidth = settings.width;
+	param->vui.sarHeight = settings.height;
+
+	param->rc.rateControlMode = X265_RC_ABR;
+	param->rc.bitrate = settings.bitrate / 1000; // x265 uses kbit/s
+	param->rc.vbvMaxBitrate = param->rc.bitrate;
+	param->rc.vbvBufferSize = param->rc.bitrate / fps * 1.1;
+
+	if (x265_param_apply_profile(param, "main") < 0)
+	{
+		x265_param_free(param);
+		throw std::runtime_error("failed to set x265 profile");
+	}
+
+	enc = x265_encoder_open(param);
+	if (not enc)
+	{
+		x265_param_free(param);
+		throw std::runtime_error("failed to create x265 encoder");
+	}
+
+	for (auto & i: in)
+	{
+		i.luma = buffer_allocation(
+		        vk.device,
+		        {
+		                .size = vk::DeviceSize(settings.video_width * settings.video_height),
+		                .usage = vk::BufferUsageFlagBits::eTransferDst,
+		        },
+		        {
+		                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+		                .usage = VMA_MEMORY_USAGE_AUTO,
+		        },
+		        "x265 luma buffer");
+		i.chroma = buffer_allocation(
+		        vk.device,
+		        {
+		                .size = vk::DeviceSize(settings.video_width * settings.video_height / 2),
+		                .usage = vk::BufferUsageFlagBits::eTransferDst,
+		        },
+		        {
+		                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+		                .usage = VMA_MEMORY_USAGE_AUTO,
+		        },
+		        "x265 chroma buffer");
+	}
+	cb.resize(chroma_width * chroma_height);
+	cr.resize(chroma_width * chroma_height);
+
+	x265_picture_init(param, &pic);
+	pic.colorSpace = X265_CSP_I420;
+	pic.bitDepth = 8;
+	pic.stride[0] = settings.video_width;
+	pic.stride[1] = chroma_width;
+	pic.stride[2] = chroma_width;
+	pic.planes[1] = cb.data();
+	pic.planes[2] = cr.data();
+}
+
+std::pair<bool, vk::Semaphore> video_encoder_x265::present_image(vk::Image y_cbcr, vk::raii::CommandBuffer & cmd_buf, uint8_t slot, uint64_t)
+{
+	cmd_buf.copyImageToBuffer(
+	        y_cbcr,
+	        vk::ImageLayout::eTransferSrcOptimal,
+	        in[slot].luma,
+	        vk::BufferImageCopy{
+	                .bufferRowLength = chroma_width * 2,
+	                .imageSubresource = {
+	                        .aspectMask = vk::ImageAspectFlagBits::ePlane0,
+	                        .baseArrayLayer = uint32_t(channels),
+	                        .layerCount = 1,
+	                },
+	                .imageOffset = {
+	                        .x = rect.offset.x,
+	                        .y = rect.offset.y,
+	                },
+	                .imageExtent = {
+	                        .width = rect.extent.width,
+	                        .height = rect.extent.height,
+	                        .depth = 1,
+	                }});
+	cmd_buf.copyImageToBuffer(
+	        y_cbcr,
+	        vk::ImageLayout::eTransferSrcOptimal,
+	        in[slot].chroma,
+	        vk::BufferImageCopy{
+	                .bufferRowLength = chroma_width,
+	                .imageSubresource = {
+	                        .aspectMask = vk::ImageAspectFlagBits::ePlane1,
+	                        .baseArrayLayer = uint32_t(channels),
+	                        .layerCount = 1,
+	                },
+	                .imageOffset = {
+	                        .x = rect.offset.x / 2,
+	                        .y = rect.offset.y / 2,
+	                },
+	                .imageExtent = {
+	                        .width = rect.extent.width / 2,
+	                        .height = rect.extent.height / 2,
+	                        .depth = 1,
+	                }});
+	return {false, nullptr};
+}
+
+std::optional<video_encoder::data> video_encoder_x265::encode(bool idr, std::chrono::steady_clock::time_point pts, uint8_t slot)
+{
+	bool reconfigure = false;
+	if (auto framerate = pending_framerate.exchange(0))
+	{
+		reconfigure = true;
+		param->fpsNum = framerate * 1'000'000;
+		param->fpsDenom = 1'000'000;
+	}
+	if (auto bitrate = pending_bitrate.exchange(0))
+	{
+		reconfigure = true;
+		auto fps = param->fpsNum / (float)param->fpsDenom;
+		param->rc.bitrate = bitrate / 1000;
+		param->rc.vbvBufferSize = param->rc.bitrate / fps * 1.1;
+		param->rc.vbvMaxBitrate = param->rc.bitrate;
+	}
+	if (reconfigure)
+	{
+		if (x265_encoder_reconfig(enc, param) < 0)
+			U_LOG_W("x265_encoder_reconfig failed");
+		// With intra refresh, the new rate control applies to the refresh cycle
+		if (not param->bIntraRefresh)
+			idr = true;
+	}
+
+	// Split interleaved chroma
+	auto chroma = (const uint8_t *)in[slot].chroma.map();
+	for (size_t i = 0, n = cb.size(); i < n; ++i)
+	{
+		cb[i] = chroma[2 * i];
+		cr[i] = chroma[2 * i + 1];
+	}
+
+	pic.planes[0] = in[slot].luma.map();
+	pic.sliceType = idr ? X265_TYPE_IDR : X265_TYPE_P;
+	pic.pts = pts.time_since_epoch().count();
+
+	x265_nal * nal;
+	uint32_t num_nal;
+	int frames = x265_encoder_encode(enc, &nal, &num_nal, &pic, nullptr);
+	if (frames < 0)
+	{
+		U_LOG_W("x265_encoder_encode failed: %d", frames);
+		return {};
+	}
+	if (frames == 0)
+	{
+		U_LOG_W("x265 did not output a frame");
+		return {};
+	}
+
+	for (uint32_t i = 0; i < num_nal; ++i)
+		SendData({nal[i].payload, nal[i].sizeBytes}, i + 1 == num_nal);
+
+	return {};
+}
+
+video_encoder_x265::~video_encoder_x265()
+{
+	x265_encoder_close(enc);
+	x265_param_free(param);
+}
+
+} // namespace wivrn
@@ -17,7 +17,9 @@
 #include "exit_codes.h"
 #include "hostname.h"
 #include "ipc_server_cb.h"
+#include "metrics_file.h"
 #include "protocol_version.h"
+#include "standby.h"
 #include "start_application.h"
 #include "utils/overloaded.h"
 #include "version.h"
@@ -59,17 +61,11 @@
 // Insert the on load constructor to init trace marker.
 U_TRACE_TARGET_SETUP(U_TRACE_WHICH_SERVICE)
 
-extern "C"
-{
-	int listen_socket = -1;
-}
-
 using namespace wivrn;
 using namespace std::chrono_literals;
 
 static std::unique_ptr<TCPListener> listener;
 std::optional<wivrn::typed_socket<wivrn::UnixDatagram, from_monado::packets, to_monado::packets>> wivrn_ipc_socket_main_loop;
-std::optional<wivrn::typed_socket<wivrn::UnixDatagram, to_monado::packets, from_monado::packets>> wivrn_ipc_socket_monado;
 
 std::filesystem::path socket_path()
 {
@@ -199,6 +195,11 @@ wivrn::service_publication publication;
 
 guint listener_watch;
 
+// Set while a server started in standby mode has not received a headset yet
+bool standby_waiting;
+// Set if a standby server exited with an error, servers are then only started on connection
+bool standby_failed;
+
 wivrn_connection::encryption_state enc_state = wivrn_connection::encryption_state::enabled;
 guint pairing_timeout;
 std::string pin;
@@ -210,6 +211,11 @@ std::chrono::milliseconds delay_next_try = default_delay_next_try;
 
 WivrnServer * dbus_server;
 
+// Last value reported by the server, to avoid sending it back
+double reported_target_miss_rate = -1;
+
+std::optional<std::filesystem::path> metrics_file;
+
 /* TODO: Document FSM
  */
 std::optional<active_runtime> runtime_setter;
@@ -219,6 +225,7 @@ std::optional<sleep_inhibitor> inhibitor;
 gboolean headset_connected(gint fd, GIOCondition condition, gpointer user_data);
 void stop_listening();
 void on_headset_info_packet(const wivrn::from_headset::headset_info_packet & info);
+void on_statistics(const std::vector<from_monado::statistic> & statistics);
 void expose_known_keys_on_dbus();
 void set_encryption_state(wivrn_connection::encryption_state new_enc_state);
 
@@ -227,7 +234,13 @@ void stop_publishing();
 
 void update_fsm();
 
-void start_server(configuration config)
+bool use_standby()
+{
+	// Pairing needs the PIN from the main loop, it is done by a server started on connection
+	return do_fork and not standby_failed and enc_state != wivrn_connection::encryption_state::pairing and configuration().standby;
+}
+
+void start_server(configuration config, bool standby = false)
 {
 	server_pid = do_fork ? fork() : 0;
 
@@ -253,6 +266,13 @@ void start_server(configuration config)
 
 		setenv("AMD_DEBUG", "lowlatencyenc", false);
 
+		if (standby)
+		{
+			connection = wivrn::standby::wait_connection(enc_state);
+			if (not connection)
+				exit(EXIT_SUCCESS);
+		}
+
 		wivrn::ipc_server_cb server_cb;
 
 		ipc_server_main_info server_info{
@@ -280,12 +300,21 @@ void start_server(configuration config)
 	}
 	else
 	{
-		std::cerr << "Server started, PID " << server_pid << std::endl;
+		if (standby)
+			std::cerr << "Server started in standby mode, PID " << server_pid << std::endl;
+		else
+			std::cerr << "Server started, PID " << server_pid << std::endl;
+		standby_waiting = standby;
 
 		assert(server_watch == 0);
 		assert(server_kill_watch == 0);
 		server_watch = g_child_watch_add(server_pid, [](pid_t, int status, void *) {
 			display_child_status(status, "Server");
+			if (std::exchange(standby_waiting, false) and not(WIFEXITED(status) and WEXITSTATUS(status) == 0) and not quitting_main_loop)
+			{
+				std::cerr << "Standby server failed, the server will be started when a headset connects" << std::endl;
+				standby_failed = true;
+			}
 			g_source_remove(server_watch);
 			if (server_kill_watch)
 				g_source_remove(server_kill_watch);
@@ -296,10 +325,17 @@ void start_server(configuration config)
 			update_fsm(); }, nullptr);
 	}
 
-	if (do_active_runtime)
+	if (do_active_runtime and not standby)
 		runtime_setter.emplace();
 }
 
+void start_standby_server()
+{
+	stop_listening();
+	start_publishing();
+	start_server(configuration(), true);
+}
+
 void kill_server()
 {
 	// Write to the server's stdin to make it quit
@@ -399,9 +435,16 @@ void update_fsm()
 			runtime_setter.reset();
 
 			g_timeout_add(delay_next_try.count(), [](void *) {
-				start_listening();
+				if (use_standby())
+				{
+					if (not server_watch and not connection_thread)
+						start_standby_server();
+				}
+				else
+					start_listening();
 				start_publishing();
 				wivrn_server_set_headset_connected(dbus_server, false);
+				on_statistics({});
 				return G_SOURCE_REMOVE; }, 0);
 		}
 	}
@@ -449,6 +492,28 @@ gboolean headset_connected_success(void *)
 	return G_SOURCE_REMOVE;
 }
 
+// Same as headset_connected_success for a server already started in standby mode
+void standby_server_connected()
+{
+	init_cleanup_functions();
+
+	std::cerr << "Client connected to standby server" << std::endl;
+
+	expose_known_keys_on_dbus();
+
+	if (do_active_runtime)
+		runtime_setter.emplace();
+
+	try
+	{
+		children->start_application(configuration().application);
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << "Failed to start application: " << e.what() << std::endl;
+	}
+}
+
 gboolean headset_connected_failed(void *)
 {
 	assert(connection_thread);
@@ -505,6 +570,19 @@ gboolean headset_connected(gint fd, GIOCondition condition, gpointer user_data)
 	return G_SOURCE_CONTINUE;
 }
 
+void on_statistics(const std::vector<from_monado::statistic> & statistics)
+{
+	GVariantBuilder * builder = g_variant_builder_new(G_VARIANT_TYPE("a{sd}"));
+	for (const auto & [name, value]: statistics)
+		g_variant_builder_add(builder, "{sd}", name.c_str(), value);
+	GVariant * value = g_variant_new("a{sd}", builder);
+	g_variant_builder_unref(builder);
+	wivrn_server_set_statistics(dbus_server, value);
+
+	if (metrics_file)
+		write_metrics_file(*metrics_file, statistics);
+}
+
 gboolean control_received(gint fd, GIOCondition condition, gpointer user_data)
 {
 	auto packet = wivrn_ipc_socket_main_loop->receive();
@@ -513,8 +591,14 @@ gboolean control_received(gint fd, GIOCondition condition, gpointer user_data)
 		std::visit(utils::overloaded{
 		                   [&](const wivrn::from_headset::headset_info_packet & info) {
 			                   on_headset_info_packet(std::get<wivrn::from_headset::headset_info_packet>(*packet));
+			                   // The new session starts with the configured target, restore the one set over D-Bus
+			                   if (auto target = wivrn_server_get_target_miss_rate(dbus_server); target >= 0)
+				                   wivrn_ipc_socket_main_loop->send(to_monado::set_target_miss_rate{target});
+			                   if (std::exchange(standby_waiting, false))
+				                   standby_server_connected();
 			                   inhibitor.emplace();
 			                   wivrn_server_set_headset_connected(dbus_server, true);
+			                   metrics_file = configuration().metrics_file;
 		                   },
 		                   [&](const wivrn::from_headset::start_app & request) {
 			                   const auto & apps = list_applications();
@@ -525,11 +609,13 @@ gboolean control_received(gint fd, GIOCondition condition, gpointer user_data)
 			                   stop_publishing();
 			                   inhibitor.emplace();
 			                   wivrn_server_set_headset_connected(dbus_server, true);
+			                   metrics_file = configuration().metrics_file;
 		                   },
 		                   [&](const from_monado::headset_disconnected &) {
 			                   start_publishing();
 			                   inhibitor.reset();
 			                   wivrn_server_set_headset_connected(dbus_server, false);
+			                   on_statistics({});
 		                   },
 		                   [&](const from_monado::bitrate_changed & value) {
 			                   wivrn_server_set_bitrate(dbus_server, value.bitrate_bps);
@@ -537,6 +623,15 @@ gboolean control_received(gint fd, GIOCondition condition, gpointer user_data)
 		                   [&](const from_monado::server_error & e) {
 			                   wivrn_server_emit_server_error(dbus_server, e.where.c_str(), e.message.c_str());
 		                   },
+		                   [&](const from_monado::latency_control & value) {
+			                   reported_target_miss_rate = value.target_miss_rate;
+			                   wivrn_server_set_target_miss_rate(dbus_server, value.target_miss_rate);
+			                   wivrn_server_set_miss_rate(dbus_server, value.miss_rate);
+			                   wivrn_server_set_latency_margin(dbus_server, value.margin_ns);
+		                   },
+		                   [&](const from_monado::statistics & value) {
+			                   on_statistics(value.values);
+		                   },
 		           },
 		           *packet);
 	}
@@ -554,6 +649,10 @@ void set_encryption_state(wivrn_connection::encryption_state new_enc_state)
 		pin_notification = nullptr;
 	}
 
+	// A standby server cannot pair headsets and keeps the state it was started with
+	if (standby_waiting and server_watch and not server_kill_watch and new_enc_state != enc_state)
+		kill_server();
+
 	switch (new_enc_state)
 	{
 		case wivrn_connection::encryption_state::disabled:
@@ -595,6 +694,9 @@ void set_encryption_state(wivrn_connection::encryption_state new_enc_state)
 
 	enc_state = new_enc_state;
 	wivrn_server_set_pin(dbus_server, pin.c_str());
+
+	if (listener and not connection_thread and not server_watch and use_standby())
+		start_standby_server();
 }
 
 gboolean on_handle_disconnect(WivrnServer * skeleton,
@@ -607,6 +709,16 @@ gboolean on_handle_disconnect(WivrnServer * skeleton,
 	return G_SOURCE_CONTINUE;
 }
 
+gboolean on_handle_dump_flight_recorder(WivrnServer * skeleton,
+                                        GDBusMethodInvocation * invocation,
+                                        gpointer user_data)
+{
+	wivrn_ipc_socket_main_loop->send(to_monado::dump_flight_recorder{});
+
+	g_dbus_method_invocation_return_value(invocation, nullptr);
+	return G_SOURCE_CONTINUE;
+}
+
 gboolean on_handle_quit(WivrnServer * skeleton, GDBusMethodInvocation * invocation, gpointer user_data)
 {
 	quitting_main_loop = true;
@@ -688,6 +800,13 @@ void on_bitrate(WivrnServer * server, const GParamSpec * pspec, gpointer data)
 		wivrn_ipc_socket_main_loop->send(to_monado::set_bitrate{bitrate});
 }
 
+void on_target_miss_rate(WivrnServer * server, const GParamSpec * pspec, gpointer data)
+{
+	auto target = wivrn_server_get_target_miss_rate(server);
+	if (target >= 0 and target != reported_target_miss_rate)
+		wivrn_ipc_socket_main_loop->send(to_monado::set_target_miss_rate{target});
+}
+
 void on_json_configuration(WivrnServer * server, const GParamSpec * pspec, gpointer data)
 {
 	const char * json = wivrn_server_get_json_configuration(server);
@@ -800,6 +919,11 @@ void on_name_acquired(GDBusConnection * connection, const gchar * name, gpointer
 	                 G_CALLBACK(on_handle_disconnect),
 	                 NULL);
 
+	g_signal_connect(dbus_server,
+	                 "handle-dump-flight-recorder",
+	                 G_CALLBACK(on_handle_dump_flight_recorder),
+	                 NULL);
+
 	g_signal_connect(dbus_server,
 	                 "handle-quit",
 	                 G_CALLBACK(on_handle_quit),
@@ -842,11 +966,13 @@ void on_name_acquired(GDBusConnection * connection, const gchar * name, gpointer
 		std::cerr << "Invalid configuration: " << e.what() << std::endl;
 	}
 	wivrn_server_set_json_configuration(dbus_server, config.c_str());
+	wivrn_server_set_target_miss_rate(dbus_server, configuration().target_miss_rate.value_or(0));
 
 	expose_known_keys_on_dbus();
 
 	g_signal_connect(dbus_server, "notify::json-configuration", G_CALLBACK(on_json_configuration), NULL);
 	g_signal_connect(dbus_server, "notify::bitrate", G_CALLBACK(on_bitrate), NULL);
+	g_signal_connect(dbus_server, "notify::target-miss-rate", G_CALLBACK(on_target_miss_rate), NULL);
 
 	g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(dbus_server),
 	                                 connection,
@@ -942,7 +1068,7 @@ int inner_main(int argc, char * argv[], bool show_instructions)
 	// Initialize avahi publisher
 	start_publishing();
 
-	// Initialize listener
+	// Initialize listener, it is replaced by a standby server once the encryption state is known
 	start_listening();
 
 	// Catch SIGINT & SIGTERM
@@ -0,0 +1,61 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "metrics_file.h"
+
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+namespace wivrn
+{
+void write_metrics_file(const std::filesystem::path & path, const std::vector<from_monado::statistic> & statistics)
+{
+	auto tmp = path;
+	tmp += ".tmp";
+
+	std::ofstream file(tmp);
+	file << "# TYPE wivrn_headset_connected gauge\n"
+	     << "wivrn_headset_connected " << (statistics.empty() ? 0 : 1) << "\n";
+
+	std::string_view family;
+	for (const auto & [name, value]: statistics)
+	{
+		std::string_view metric = std::string_view(name).substr(0, name.find('{'));
+		bool counter = metric.ends_with("_total");
+		if (counter)
+			metric.remove_suffix(std::string_view("_total").size());
+
+		// Samples of a metric family are consecutive
+		if (metric != family)
+		{
+			family = metric;
+			file << "# TYPE wivrn_" << family << (counter ? " counter\n" : " gauge\n");
+		}
+		file << "wivrn_" << name << " " << value << "\n";
+	}
+	file << "# EOF\n";
+	file.close();
+
+	std::error_code ec;
+	if (file)
+		std::filesystem::rename(tmp, path, ec);
+	if (not file or ec)
+		std::cerr << "Failed to write metrics to " << path << std::endl;
+}
+} // namespace wivrn
@@ -0,0 +1,33 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_ipc.h"
+
+#include <filesystem>
+#include <vector>
+
+namespace wivrn
+{
+// Write the statistics in the OpenMetrics text format, as read by the
+// textfile collector of the Prometheus node exporter.
+// The file is replaced atomically, without statistics only
+// wivrn_headset_connected is written.
+void write_metrics_file(const std::filesystem::path & path, const std::vector<from_monado::statistic> & statistics);
+} // namespace wivrn
@@ -0,0 +1,131 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "standby.h"
+
+#include "accept_connection.h"
+#include "util/u_logging.h"
+
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace
+{
+// Keeping an instance and a device alive keeps the driver loaded, so that
+// the compositor does not pay for it. The compositor itself and the encoders
+// need the headset info and are only created once it is connected.
+struct prewarmed_vulkan
+{
+	vk::raii::Context ctx;
+	vk::raii::Instance instance = nullptr;
+	vk::raii::Device device = nullptr;
+
+	prewarmed_vulkan()
+	{
+		vk::ApplicationInfo app_info{
+		        .pApplicationName = "WiVRn standby",
+		        .apiVersion = VK_API_VERSION_1_3,
+		};
+		instance = vk::raii::Instance(ctx, vk::InstanceCreateInfo{.pApplicationInfo = &app_info});
+
+		auto physical_devices = instance.enumeratePhysicalDevices();
+		if (physical_devices.empty())
+			throw std::runtime_error("no Vulkan device");
+
+		auto physical_device = physical_devices.front();
+		for (auto & i: physical_devices)
+		{
+			if (i.getProperties().deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
+			{
+				physical_device = i;
+				break;
+			}
+		}
+
+		auto queue_families = physical_device.getQueueFamilyProperties();
+		uint32_t queue_family = 0;
+		for (uint32_t i = 0; i < queue_families.size(); ++i)
+		{
+			if (queue_families[i].queueFlags & vk::QueueFlagBits::eGraphics)
+			{
+				queue_family = i;
+				break;
+			}
+		}
+
+		float priority = 1;
+		vk::DeviceQueueCreateInfo queue_info{
+		        .queueFamilyIndex = queue_family,
+		        .queueCount = 1,
+		        .pQueuePriorities = &priority,
+		};
+		device = vk::raii::Device(physical_device, vk::DeviceCreateInfo{
+		                                                   .queueCreateInfoCount = 1,
+		                                                   .pQueueCreateInfos = &queue_info,
+		                                           });
+
+		U_LOG_I("Standby server: Vulkan initialised on %s", physical_device.getProperties().deviceName.data());
+	}
+};
+
+std::optional<prewarmed_vulkan> vulkan;
+
+float ms_since(std::chrono::steady_clock::time_point t)
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+} // namespace
+
+std::unique_ptr<wivrn::wivrn_connection> wivrn::standby::wait_connection(wivrn_connection::encryption_state state)
+{
+	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		vulkan.emplace();
+	}
+	catch (std::exception & e)
+	{
+		U_LOG_W("Standby server: failed to initialise Vulkan: %s", e.what());
+	}
+	U_LOG_I("Standby server ready in %.1fms", ms_since(start));
+
+	while (true)
+	{
+		auto tcp = accept_connection(0 /*stdin*/);
+		if (not tcp)
+			return nullptr;
+
+		try
+		{
+			auto connection = std::make_unique<wivrn_connection>(std::stop_token{}, state, "", std::move(*tcp));
+			U_LOG_I("Standby server: handshake completed in %.1fms", ms_since(connection->connected_at()));
+			return connection;
+		}
+		catch (std::exception & e)
+		{
+			U_LOG_W("Standby server: client connection failed: %s", e.what());
+		}
+	}
+}
+
+void wivrn::standby::release()
+{
+	vulkan.reset();
+}
@@ -0,0 +1,34 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "driver/wivrn_connection.h"
+
+#include <memory>
+
+namespace wivrn::standby
+{
+// Load the Vulkan driver and create a device, then wait for a headset on the WiVRn port.
+// Only already paired headsets can connect, returns nullptr when asked to quit through stdin.
+// The IPC server, the session and the compositor are started by the caller after it returns.
+std::unique_ptr<wivrn_connection> wait_connection(wivrn_connection::encryption_state state);
+
+// Destroy the Vulkan objects created while waiting, once the compositor owns its own
+void release();
+} // namespace wivrn::standby
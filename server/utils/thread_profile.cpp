@@ -0,0 +1,244 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thread_profile.h"
+
+#include "driver/configuration.h"
+#include "util/u_logging.h"
+
+#include <array>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace wivrn
+{
+
+namespace
+{
+struct profile
+{
+	std::vector<int> cpus; // empty: all CPUs
+	int policy = SCHED_OTHER;
+	int priority = 0; // only for SCHED_FIFO and SCHED_RR
+	int nice = 0;     // only for SCHED_OTHER
+	// policy and nice level come from the configuration, failures are warnings
+	bool configured = false;
+};
+
+const char * role_name(thread_role role)
+{
+	switch (role)
+	{
+		case thread_role::encoder:
+			return "encoder";
+		case thread_role::sender:
+			return "sender";
+		case thread_role::network:
+			return "network";
+		case thread_role::audio:
+			return "audio";
+	}
+	return "unknown";
+}
+
+const char * policy_name(int policy)
+{
+	switch (policy)
+	{
+		case SCHED_OTHER:
+			return "other";
+		case SCHED_FIFO:
+			return "fifo";
+		case SCHED_RR:
+			return "rr";
+		case SCHED_BATCH:
+			return "batch";
+		case SCHED_IDLE:
+			return "idle";
+	}
+	return "unknown";
+}
+
+// Real-time policies are only used when configured: the sender thread copies
+// and encrypts the whole bitstream and could starve the application.
+profile default_profile(thread_role role, unsigned int cores)
+{
+	switch (role)
+	{
+		case thread_role::encoder:
+			return {.nice = cores >= 8 ? -10 : -5};
+		case thread_role::network:
+		case thread_role::audio:
+		case thread_role::sender:
+			return {.nice = -10};
+	}
+	return {};
+}
+
+// Default profiles are best effort, only tell once that they cannot be applied
+void default_profile_failed(const char * what, const char * name, int err)
+{
+	static std::once_flag once;
+	std::call_once(once, [&]() {
+		U_LOG_I("Cannot apply default %s to thread %s: %s, CAP_SYS_NICE may be missing", what, name, strerror(err));
+	});
+}
+
+profile make_profile(thread_role role)
+{
+	profile p = default_profile(role, std::thread::hardware_concurrency());
+
+	auto config = configuration().threads;
+	auto it = config.find(role_name(role));
+	if (it == config.end())
+		return p;
+
+	const auto & item = it->second;
+	if (item.cpus)
+		p.cpus = *item.cpus;
+	if (item.policy or item.priority or item.nice)
+		p.configured = true;
+	if (item.policy)
+	{
+		if (*item.policy == "fifo")
+			p.policy = SCHED_FIFO;
+		else if (*item.policy == "rr")
+			p.policy = SCHED_RR;
+		else if (*item.policy == "other")
+			p.policy = SCHED_OTHER;
+		else
+			U_LOG_W("Invalid scheduling policy %s for %s threads", item.policy->c_str(), role_name(role));
+		if (p.policy != SCHED_OTHER and p.priority == 0)
+			p.priority = 1;
+	}
+	if (item.priority)
+		p.priority = *item.priority;
+	if (item.nice)
+		p.nice = *item.nice;
+
+	return p;
+}
+
+const profile & get_profile(thread_role role)
+{
+	// Configuration is only read once per process
+	static const std::array profiles{
+	        make_profile(thread_role::encoder),
+	        make_profile(thread_role::sender),
+	        make_profile(thread_role::network),
+	        make_profile(thread_role::audio),
+	};
+	return profiles[int(role)];
+}
+
+std::string cpu_list(const cpu_set_t & set)
+{
+	std::string res;
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (not CPU_ISSET(cpu, &set))
+			continue;
+		int last = cpu;
+		while (last + 1 < CPU_SETSIZE and CPU_ISSET(last + 1, &set))
+			++last;
+		if (not res.empty())
+			res += ",";
+		res += std::to_string(cpu);
+		if (last > cpu)
+			res += "-" + std::to_string(last);
+		cpu = last;
+	}
+	return res;
+}
+} // namespace
+
+void apply_thread_profile(thread_role role)
+{
+	const profile & p = get_profile(role);
+	pthread_t self = pthread_self();
+
+	char name[16] = "";
+	pthread_getname_np(self, name, sizeof(name));
+
+	if (not p.cpus.empty())
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu: p.cpus)
+		{
+			if (cpu >= 0 and cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &set);
+		}
+		if (int err = pthread_setaffinity_np(self, sizeof(set), &set))
+			U_LOG_W("Failed to set CPU affinity of thread %s: %s", name, strerror(err));
+	}
+
+	int policy = p.policy;
+	if (policy != SCHED_OTHER)
+	{
+		sched_param param{.sched_priority = p.priority};
+		// Children of real-time threads should not inherit the policy
+		if (int err = pthread_setschedparam(self, policy | SCHED_RESET_ON_FORK, &param))
+		{
+			if (p.configured)
+				U_LOG_W("Failed to set %s scheduling policy for thread %s: %s, CAP_SYS_NICE may be missing",
+				        policy_name(policy),
+				        name,
+				        strerror(err));
+			else
+				default_profile_failed("scheduling policy", name, err);
+			policy = SCHED_OTHER;
+		}
+	}
+	if (policy == SCHED_OTHER and p.nice != 0)
+	{
+		// On Linux, nice values are per thread
+		if (setpriority(PRIO_PROCESS, gettid(), p.nice) < 0)
+		{
+			if (p.configured)
+				U_LOG_W("Failed to set nice level %d for thread %s: %s", p.nice, name, strerror(errno));
+			else
+				default_profile_failed("nice level", name, errno);
+		}
+	}
+
+	// Report what was actually applied
+	int actual_policy;
+	sched_param param{};
+	pthread_getschedparam(self, &actual_policy, &param);
+	actual_policy &= ~SCHED_RESET_ON_FORK;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	pthread_getaffinity_np(self, sizeof(set), &set);
+	U_LOG_I("Thread %s (%s): policy %s, priority %d, nice %d, CPUs %s",
+	        name,
+	        role_name(role),
+	        policy_name(actual_policy),
+	        param.sched_priority,
+	        getpriority(PRIO_PROCESS, gettid()),
+	        cpu_list(set).c_str());
+}
+
+} // namespace wivrn
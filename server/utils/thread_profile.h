@@ -0,0 +1,38 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+namespace wivrn
+{
+
+// Roles of the latency sensitive threads, each one has a scheduling profile
+// that can be set in the "threads" section of the configuration.
+enum class thread_role
+{
+	encoder,
+	sender,
+	network,
+	audio,
+};
+
+// Apply the CPU affinity and scheduling policy of the role to the calling thread,
+// and log what was actually applied.
+void apply_thread_profile(thread_role role);
+
+} // namespace wivrn
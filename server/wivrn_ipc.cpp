@@ -26,6 +26,13 @@
 
 std::unique_ptr<wivrn::wivrn_connection> connection;
 
+extern "C"
+{
+	int listen_socket = -1;
+}
+
+std::optional<wivrn::typed_socket<wivrn::UnixDatagram, to_monado::packets, from_monado::packets>> wivrn_ipc_socket_monado;
+
 struct cleanup_function
 {
 	void (*callback)(uintptr_t);
@@ -25,7 +25,9 @@
 #include <memory>
 #include <optional>
 #include <stdint.h>
+#include <string>
 #include <variant>
+#include <vector>
 
 namespace wivrn
 {
@@ -34,6 +36,9 @@ class wivrn_connection;
 
 extern std::unique_ptr<wivrn::wivrn_connection> connection;
 
+// Socket for OpenXR applications, created by the main loop and used by monado
+extern "C" int listen_socket;
+
 namespace from_monado
 {
 struct headset_connected
@@ -53,13 +58,34 @@ struct server_error
 	std::string message;
 };
 
+struct latency_control
+{
+	double target_miss_rate;
+	double miss_rate;
+	int64_t margin_ns;
+};
+
+struct statistic
+{
+	// OpenMetrics name, possibly with labels: name{label="value"}
+	std::string name;
+	double value;
+};
+
+struct statistics
+{
+	std::vector<statistic> values;
+};
+
 using packets = std::variant<
         wivrn::from_headset::headset_info_packet,
         wivrn::from_headset::start_app,
         headset_connected,
         headset_disconnected,
         bitrate_changed,
-        server_error>;
+        server_error,
+        latency_control,
+        statistics>;
 } // namespace from_monado
 
 namespace to_monado
@@ -72,7 +98,15 @@ struct set_bitrate
 	uint32_t bitrate_bps;
 };
 
-using packets = std::variant<disconnect, set_bitrate>;
+struct set_target_miss_rate
+{
+	double target_miss_rate;
+};
+
+struct dump_flight_recorder
+{};
+
+using packets = std::variant<disconnect, set_bitrate, set_target_miss_rate, dump_flight_recorder>;
 } // namespace to_monado
 
 extern std::optional<wivrn::typed_socket<wivrn::UnixDatagram, to_monado::packets, from_monado::packets>> wivrn_ipc_socket_monado;
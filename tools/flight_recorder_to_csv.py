@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+
+# Convert a dump of the server flight recorder (~/.cache/wivrn/flight_recorder)
+# to the CSV format written with WIVRN_DUMP_TIMINGS, which can then be used
+# with process_timings.py or timings.html
+
+import argparse
+import struct
+import sys
+
+MAGIC = b'WIVRNFR\0'
+VERSION = 1
+
+
+def read_names(f):
+    count, = struct.unpack('<B', f.read(1))
+    names = []
+    for _ in range(count):
+        name = b''
+        while (c := f.read(1)) != b'\0':
+            if not c:
+                raise ValueError('truncated file')
+            name += c
+        names.append(name.decode())
+    return names
+
+
+def convert(f, out):
+    if f.read(8) != MAGIC:
+        raise ValueError('not a flight recorder dump')
+    version, = struct.unpack('<I', f.read(4))
+    if version != VERSION:
+        raise ValueError(f'unsupported version {version}')
+
+    events = read_names(f)
+    frame_types = read_names(f)
+
+    count, = struct.unpack('<Q', f.read(8))
+    record = struct.Struct('<qQBBB')
+    for _ in range(count):
+        data = f.read(record.size)
+        if len(data) < record.size:
+            raise ValueError('truncated file')
+        time, frame, event, stream, frame_type = record.unpack(data)
+        line = f'"{events[event]}",{frame},{time},{stream}'
+        if frame_type:
+            line += ',' + frame_types[frame_type]
+        out.write(line + '\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert a flight recorder dump to CSV')
+    parser.add_argument('dump', help='.wivrnfr file')
+    parser.add_argument('-o', '--output', default='-', help='CSV file (default: standard output)')
+    args = parser.parse_args()
+
+    out = open(args.output, 'w') if args.output != '-' else sys.stdout
+    with open(args.dump, 'rb') as f:
+        try:
+            convert(f, out)
+        except ValueError as e:
+            sys.exit(f'{args.dump}: {e}')
+
+
+if __name__ == '__main__':
+    main()
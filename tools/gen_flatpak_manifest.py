@@ -61,6 +61,8 @@ if __name__ == "__main__":
     monado_commit = open(os.path.join(root, "monado-rev")).read()
     boostpfr_url = cmake.get("boostpfr", "URL")
     boostpfr_sha256 = cmake.get("boostpfr", "URL_HASH").split("=")[-1]
+    lz4_url = cmake.get("lz4", "URL")
+    lz4_sha256 = cmake.get("lz4", "URL_HASH").split("=")[-1]
 
     try:
         git_commit = subprocess.check_output(
@@ -95,6 +97,8 @@ if __name__ == "__main__":
 
     template = template.replace("BOOSTPFR_URL", boostpfr_url)
     template = template.replace("BOOSTPFR_SHA256", boostpfr_sha256)
+    template = template.replace("LZ4_URL", lz4_url)
+    template = template.replace("LZ4_SHA256", lz4_sha256)
     template = template.replace("MONADO_COMMIT", monado_commit)
 
     with open(os.path.join(args.out, "io.github.wivrn.wivrn.yml"), "w") as f:
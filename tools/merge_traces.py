@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+
+# Merge the traces written by the server and the headset when built with
+# WIVRN_FEATURE_TRACING, the headset timestamps are converted to the server
+# clock so that the frames can be followed from the encoder to the display.
+
+import argparse
+import json
+import statistics
+import sys
+
+# Process id of the stream tracks, see common/utils/tracing.cpp
+STREAMS_PID = 1
+
+
+def read(path):
+    with open(path) as f:
+        text = f.read().rstrip()
+    # The closing bracket is missing if the process did not exit cleanly
+    if not text.endswith(']'):
+        text = text.rstrip(',') + ']'
+    return json.loads(text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Merge server and headset traces')
+    parser.add_argument('server', help='trace written by the server')
+    parser.add_argument('headset', help='trace written by the headset or wivrn-headless')
+    parser.add_argument('-o', '--output', default='-', help='merged trace (default: standard output)')
+    parser.add_argument('--keep-reported', action='store_true',
+                        help='keep the headset spans reported to the server, to check the clock offset')
+    args = parser.parse_args()
+
+    server = read(args.server)
+    headset = read(args.headset)
+
+    offsets = [e['args']['offset'] for e in server if e.get('ph') == 'C' and e.get('name') == 'headset_clock_offset']
+    if not offsets:
+        sys.exit(f'{args.server} has no clock offset, the headset was not connected for long enough')
+    # headset time = server time + offset, in ns
+    offset_us = statistics.median(offsets) / 1000
+
+    if not args.keep_reported:
+        server = [e for e in server if e.get('pid') != STREAMS_PID]
+
+    # Keep the headset processes apart from the server ones
+    server_pids = {e['pid'] for e in server if 'pid' in e}
+    pid_shift = max(server_pids, default=0) + 1
+
+    for e in headset:
+        if 'ts' in e:
+            e['ts'] -= offset_us
+        if 'pid' in e:
+            e['pid'] += pid_shift
+
+    out = open(args.output, 'w') if args.output != '-' else sys.stdout
+    json.dump(server + headset, out)
+    out.write('\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -18,9 +18,11 @@
 
 #include <CLI/CLI.hpp>
 #include <chrono>
+#include <cmath>
 #include <format>
 #include <ranges>
 #include <systemd/sd-bus.h>
+#include <thread>
 #include <type_traits>
 
 struct deleter
@@ -286,6 +288,98 @@ void disconnect()
 	call_method(get_user_bus(), "Disconnect", "");
 }
 
+void dump_timings()
+{
+	call_method(get_user_bus(), "DumpFlightRecorder", "");
+	std::cout << "Timings are written in the flight_recorder directory of the WiVRn cache (~/.cache/wivrn)" << std::endl;
+}
+
+std::vector<std::pair<std::string, double>> get_statistics(const sd_bus_ptr & bus)
+{
+	auto msg = get_property(bus,
+	                        "Statistics",
+	                        "a{sd}");
+
+	int ret = sd_bus_message_enter_container(msg.get(), 'a', "{sd}");
+	if (ret < 0)
+		throw std::system_error(-ret, std::system_category(), "Failed to get statistics");
+
+	std::vector<std::pair<std::string, double>> values;
+	while (true)
+	{
+		char * name;
+		double value;
+		int ret = sd_bus_message_read(msg.get(), "{sd}", &name, &value);
+		if (ret == 0)
+			break;
+		if (ret < 0)
+			throw std::system_error(-ret, std::system_category(), "Failed to read statistics");
+
+		values.emplace_back(name, value);
+	}
+
+	return values;
+}
+
+std::string json_string(std::string_view str)
+{
+	std::string result = "\"";
+	for (char c: str)
+	{
+		if (c == '"' or c == '\\')
+			result += '\\';
+		result += c;
+	}
+	return result + "\"";
+}
+
+void print_statistics(const std::vector<std::pair<std::string, double>> & values, bool json)
+{
+	if (json)
+	{
+		std::cout << "{";
+		const char * separator = "";
+		for (const auto & [name, value]: values)
+		{
+			std::cout << separator << json_string(name) << ": ";
+			if (std::isfinite(value))
+				std::cout << std::format("{}", value);
+			else
+				std::cout << "null";
+			separator = ", ";
+		}
+		std::cout << "}" << std::endl;
+	}
+	else if (values.empty())
+	{
+		std::cout << "No headset connected" << std::endl;
+	}
+	else
+	{
+		print_table({"Statistic", "Value"},
+		            values | std::views::transform([](const auto & v) {
+			            return std::tuple(v.first, std::format("{:.6g}", v.second));
+		            }));
+	}
+}
+
+void stats(bool watch, bool json)
+{
+	auto bus = get_user_bus();
+	while (true)
+	{
+		auto values = get_statistics(bus);
+		// Clear the screen, JSON output is one object per line
+		if (watch and not json)
+			std::cout << "\033[H\033[2J";
+		print_statistics(values, json);
+
+		if (not watch)
+			return;
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+}
+
 void set_bitrate(std::string bitrate_str)
 {
 	auto suffix = bitrate_str.back();
@@ -374,6 +468,16 @@ int main(int argc, char ** argv)
 	app.add_subcommand("disconnect", "Disconnect headset")
 	        ->callback(disconnect);
 
+	app.add_subcommand("dump-timings", "Save the frame timings of the last seconds")
+	        ->callback(dump_timings);
+
+	bool watch = false;
+	bool json = false;
+	auto stats_command = app.add_subcommand("stats", "Show the streaming statistics")
+	                             ->callback([&]() { stats(watch, json); });
+	stats_command->add_flag("--watch, -w", watch, "Refresh every second");
+	stats_command->add_flag("--json", json, "Print the statistics as JSON");
+
 	std::string bitrate_str;
 	auto bitrate_command = app.add_subcommand("set-bitrate", "Set encoding bitrate");
 	bitrate_command->add_option("BITRATE", bitrate_str, "Desired total bitrate, e.g. 100M")->required();